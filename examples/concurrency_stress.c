@@ -0,0 +1,662 @@
+/**
+ * @file concurrency_stress.c
+ * @brief Multi-threaded stress run of the real-time engine
+ *
+ * Renders at real-time pace on an audio thread while other threads play
+ * the roles a host gives them:
+ *
+ * - keyboards: random note-on/off and pitch bend at sub-millisecond gaps
+ * - sequencer: three-note chords every 5 ms, released two steps later
+ * - loader: builds new instruments, swaps them into the routing table and
+ *   destroys swapped-out ones while their voices may still be sounding
+ * - ui: drains voice notifications, reads statistics, sends all-notes-off
+ *
+ * The event queue has a single producer, so the control threads share one
+ * lock around every call that queues an event. A host merging several
+ * inputs must do the same. The audio thread never takes it. Instruments
+ * are destroyed under the same lock, once they are out of the routing
+ * table, no player holds a note on them and every note-on sent to them
+ * has been rendered. Their release tails are often still sounding.
+ *
+ * At the end every thread releases the notes it still holds. The engine
+ * renders on for a while, and the run checks that:
+ *
+ * - every accepted note-on reported a voice start (no lost events)
+ * - every started voice reported its end (no stuck voices)
+ * - the output is silent again (no lost note-offs)
+ *
+ * Once the audio thread has stopped, one more instrument is rendered
+ * offline to check that a pitch bend retunes both a sounding note and
+ * the next one.
+ *
+ * It reports blocks that missed their deadline and the worst-case block
+ * time, and exits 1 if an invariant fails. Build with
+ * -DCMAKE_C_FLAGS=-fsanitize=thread to check for data races as well.
+ *
+ * Usage: concurrency_stress [-d seconds] [-b buffer] [-k keyboards]
+ */
+
+#define _GNU_SOURCE
+#include "midi_sampler.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_RATE 48000
+#define MAX_POLYPHONY 64
+#define NUM_SLOTS 4             /* Routing table the control threads play into */
+#define MAX_INSTRUMENTS 256     /* Routed plus swapped out, not yet destroyed */
+#define MAX_HELD 16             /* Notes one control thread holds at most */
+#define MAX_KEYBOARDS 16
+#define ZONE_FRAMES 2048
+#define DRAIN_SECONDS 0.5
+#define SILENCE_LEVEL 1e-6f
+
+/* An instrument the control threads play, and what keeps it alive */
+typedef struct {
+    ms_instrument_t *instrument;
+    uint32_t held;                  /* Notes players hold on it */
+    uint64_t unrouted_frame;        /* Engine frame when it left the routing table */
+} stress_instrument_t;
+
+typedef struct {
+    stress_instrument_t *instrument;
+    uint8_t note;
+} held_note_t;
+
+/* Per control thread: the notes it has started and not yet released */
+typedef struct {
+    held_note_t notes[MAX_HELD];
+    size_t count;
+    uint32_t seed;
+} player_t;
+
+static ms_sampler_t *sampler;
+static size_t buffer_size = 128;
+
+/* Everything below is guarded by producer_lock */
+static pthread_mutex_t producer_lock = PTHREAD_MUTEX_INITIALIZER;
+static stress_instrument_t *slots[NUM_SLOTS];
+static stress_instrument_t *instruments[MAX_INSTRUMENTS];
+static size_t num_instruments;
+static uint64_t notes_on, notes_off, notes_refused, bends, all_offs, swaps, destroys;
+
+static atomic_bool producers_running;
+static atomic_bool loader_running;
+static atomic_bool ui_running;
+static atomic_bool audio_running;
+
+/* Audio thread results, read after it has been joined */
+static uint64_t blocks, late_blocks, worst_block_ns, total_block_ns;
+static uint64_t last_loud_block;
+static bool rt_priority;
+
+/* Notification counts, owned by the ui thread and then by main */
+static uint64_t voices_started, voices_stolen, voices_finished;
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t) {
+    const struct timespec ts = {
+        .tv_sec = (time_t)(t / 1000000000ULL),
+        .tv_nsec = (long)(t % 1000000000ULL)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+static void sleep_us(uint64_t us) {
+    sleep_until_ns(get_time_ns() + us * 1000);
+}
+
+static uint32_t rng(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/* ============================================================================
+ * Instruments
+ * ========================================================================== */
+
+/**
+ * @brief Build an instrument of looped zones, so only a note-off ends a voice
+ */
+static ms_instrument_t *build_instrument(uint32_t *seed) {
+    ms_instrument_t *inst;
+    if (ms_instrument_create(sampler, "stress", &inst) != MS_SUCCESS) {
+        return NULL;
+    }
+
+    const int zones = 1 + (int)(rng(seed) % 4);
+    for (int z = 0; z < zones; z++) {
+        float zone[ZONE_FRAMES];
+        const float cycles = 8.0f + (float)(rng(seed) % 24);
+        for (size_t i = 0; i < ZONE_FRAMES; i++) {
+            zone[i] = 0.2f * sinf(2.0f * (float)M_PI * cycles * (float)i / ZONE_FRAMES);
+        }
+
+        const ms_sample_metadata_t metadata = {
+            .root_note = (uint8_t)(36 + z * 12),
+            .velocity_low = 0,
+            .velocity_high = 127,
+            .loop_enabled = true,
+            .loop_start = 0,
+            .loop_end = ZONE_FRAMES
+        };
+        if (ms_instrument_load_sample_memory(inst, zone, ZONE_FRAMES, 1, &metadata) != MS_SUCCESS) {
+            pthread_mutex_lock(&producer_lock);
+            ms_instrument_destroy(inst);
+            pthread_mutex_unlock(&producer_lock);
+            return NULL;
+        }
+    }
+
+    const ms_envelope_t envelope = {
+        .attack_time = 0.002f,
+        .decay_time = 0.02f,
+        .sustain_level = 0.8f,
+        .release_time = 0.005f + (float)(rng(seed) % 40) / 1000.0f
+    };
+    ms_instrument_set_envelope(inst, &envelope);
+    return inst;
+}
+
+static stress_instrument_t *wrap_instrument(ms_instrument_t *inst) {
+    stress_instrument_t *entry = (stress_instrument_t*)calloc(1, sizeof(stress_instrument_t));
+    if (entry) {
+        entry->instrument = inst;
+    }
+    return entry;
+}
+
+/* ============================================================================
+ * Producer Helpers (call with producer_lock held)
+ * ========================================================================== */
+
+static void play_note(player_t *player, stress_instrument_t *inst, uint8_t note, uint8_t velocity) {
+    if (player->count == MAX_HELD) return;
+
+    if (ms_note_on(inst->instrument, note, velocity, NULL) != MS_SUCCESS) {
+        notes_refused++;    /* Queue full: the note never existed */
+        return;
+    }
+    notes_on++;
+    inst->held++;
+    player->notes[player->count].instrument = inst;
+    player->notes[player->count].note = note;
+    player->count++;
+}
+
+static void release_note(player_t *player, size_t index) {
+    const held_note_t held = player->notes[index];
+
+    /* A note-off must not be lost: wait for the audio thread to make room */
+    while (ms_note_off(held.instrument->instrument, held.note) != MS_SUCCESS) {
+        pthread_mutex_unlock(&producer_lock);
+        sched_yield();
+        pthread_mutex_lock(&producer_lock);
+    }
+    notes_off++;
+    held.instrument->held--;
+    player->notes[index] = player->notes[--player->count];
+}
+
+static void release_all(player_t *player) {
+    pthread_mutex_lock(&producer_lock);
+    while (player->count > 0) {
+        release_note(player, player->count - 1);
+    }
+    pthread_mutex_unlock(&producer_lock);
+}
+
+/* ============================================================================
+ * Threads
+ * ========================================================================== */
+
+static void *audio_thread(void *arg) {
+    (void)arg;
+    float *block = (float*)calloc(buffer_size * 2, sizeof(float));
+    if (!block) return NULL;
+
+    struct sched_param param = { .sched_priority = sched_get_priority_max(SCHED_FIFO) - 10 };
+    rt_priority = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+
+    const uint64_t period = (uint64_t)buffer_size * 1000000000ULL / SAMPLE_RATE;
+    const uint64_t start = get_time_ns();
+
+    for (uint64_t k = 0; atomic_load(&audio_running); k++) {
+        const uint64_t deadline = start + (k + 1) * period;
+
+        const uint64_t t0 = get_time_ns();
+        ms_process(sampler, block, buffer_size);
+        const uint64_t t1 = get_time_ns();
+
+        const uint64_t elapsed = t1 - t0;
+        total_block_ns += elapsed;
+        if (elapsed > worst_block_ns) worst_block_ns = elapsed;
+        if (t1 > deadline) late_blocks++;
+
+        for (size_t i = 0; i < buffer_size * 2; i++) {
+            if (fabsf(block[i]) > SILENCE_LEVEL) {
+                last_loud_block = k;
+                break;
+            }
+        }
+        blocks = k + 1;
+
+        sleep_until_ns(deadline);
+    }
+
+    free(block);
+    return NULL;
+}
+
+static void *keyboard_thread(void *arg) {
+    player_t player = { .count = 0, .seed = (uint32_t)(uintptr_t)arg * 2654435761u | 1 };
+
+    while (atomic_load(&producers_running)) {
+        const uint32_t r = rng(&player.seed);
+
+        pthread_mutex_lock(&producer_lock);
+        stress_instrument_t *inst = slots[r % NUM_SLOTS];
+        if (r % 100 < 55) {
+            play_note(&player, inst, (uint8_t)(24 + (r >> 8) % 80), (uint8_t)(1 + (r >> 16) % 127));
+        } else if (r % 100 < 90) {
+            if (player.count > 0) {
+                release_note(&player, (r >> 8) % player.count);
+            }
+        } else if (ms_pitch_bend(inst->instrument, (int16_t)((r >> 8) % 16384) - 8192) ==
+                   MS_SUCCESS) {
+            bends++;
+        }
+        pthread_mutex_unlock(&producer_lock);
+
+        sleep_us(50 + (r >> 20) % 900);
+    }
+
+    release_all(&player);
+    return NULL;
+}
+
+static void *sequencer_thread(void *arg) {
+    (void)arg;
+    player_t player = { .count = 0, .seed = 0xC0FFEEu };
+    held_note_t steps[2][3] = { { { 0 } } };
+    size_t counts[2] = { 0, 0 };
+    uint64_t next = get_time_ns();
+
+    for (uint64_t step = 0; atomic_load(&producers_running); step++) {
+        pthread_mutex_lock(&producer_lock);
+
+        /* Release the chord from two steps ago */
+        held_note_t *old = steps[step & 1];
+        for (size_t i = 0; i < counts[step & 1]; i++) {
+            for (size_t h = 0; h < player.count; h++) {
+                if (player.notes[h].instrument == old[i].instrument &&
+                    player.notes[h].note == old[i].note) {
+                    release_note(&player, h);
+                    break;
+                }
+            }
+        }
+        counts[step & 1] = 0;
+
+        stress_instrument_t *inst = slots[step % NUM_SLOTS];
+        const uint8_t root = (uint8_t)(48 + rng(&player.seed) % 24);
+        const uint8_t chord[3] = { root, (uint8_t)(root + 4), (uint8_t)(root + 7) };
+        for (size_t i = 0; i < 3; i++) {
+            const size_t before = player.count;
+            play_note(&player, inst, chord[i], 100);
+            if (player.count > before) {
+                old[counts[step & 1]++] = player.notes[player.count - 1];
+            }
+        }
+
+        pthread_mutex_unlock(&producer_lock);
+
+        next += 5000000ULL;
+        sleep_until_ns(next);
+    }
+
+    release_all(&player);
+    return NULL;
+}
+
+static uint64_t engine_frames(void) {
+    ms_stats_t stats;
+    ms_sampler_get_stats(sampler, &stats);
+    return stats.frames_processed;
+}
+
+static bool is_routed(const stress_instrument_t *inst) {
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        if (slots[i] == inst) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Destroy swapped-out instruments nobody can still send a note-on to
+ *        (producer_lock held)
+ *
+ * Note-ons reach an instrument only while it is routed, and two blocks
+ * after it left the table the audio thread has taken all of them. What is
+ * left are release tails, which the destroy cuts.
+ */
+static void retire_instruments(void) {
+    const uint64_t settled = engine_frames();
+
+    for (size_t i = 0; i < num_instruments;) {
+        stress_instrument_t *inst = instruments[i];
+        if (is_routed(inst) || inst->held > 0 ||
+            settled < inst->unrouted_frame + 2 * buffer_size) {
+            i++;
+            continue;
+        }
+
+        ms_instrument_destroy(inst->instrument);
+        free(inst);
+        instruments[i] = instruments[--num_instruments];
+        destroys++;
+    }
+}
+
+static void *loader_thread(void *arg) {
+    (void)arg;
+    uint32_t seed = 0xBADC0DEu;
+
+    while (atomic_load(&loader_running)) {
+        sleep_us(20000 + rng(&seed) % 80000);
+
+        /* Built outside the lock: the audio thread cannot see it yet */
+        ms_instrument_t *built = build_instrument(&seed);
+        if (!built) continue;
+        stress_instrument_t *inst = wrap_instrument(built);
+
+        pthread_mutex_lock(&producer_lock);
+        retire_instruments();
+        if (inst && num_instruments < MAX_INSTRUMENTS) {
+            const size_t slot = rng(&seed) % NUM_SLOTS;
+            stress_instrument_t *old = slots[slot];
+            instruments[num_instruments++] = inst;
+            slots[slot] = inst;
+            if (!is_routed(old)) {
+                old->unrouted_frame = engine_frames();
+            }
+            swaps++;
+            inst = NULL;
+            built = NULL;
+        }
+        if (built) {
+            ms_instrument_destroy(built);   /* Table full; never played */
+        }
+        pthread_mutex_unlock(&producer_lock);
+
+        free(inst);
+    }
+
+    return NULL;
+}
+
+static void count_notifications(void) {
+    ms_voice_event_t events[256];
+    size_t n;
+    while ((n = ms_poll_voice_events(sampler, events, 256)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            switch (events[i].type) {
+                case MS_VOICE_STARTED: voices_started++; break;
+                case MS_VOICE_STOLEN: voices_stolen++; break;
+                case MS_VOICE_FINISHED: voices_finished++; break;
+            }
+        }
+    }
+}
+
+static void *ui_thread(void *arg) {
+    (void)arg;
+    uint32_t seed = 0x5EED5u;
+
+    for (uint64_t tick = 0; atomic_load(&ui_running); tick++) {
+        count_notifications();
+
+        if (tick % 50 == 0) {
+            ms_stats_t stats;
+            ms_sampler_get_stats(sampler, &stats);
+        }
+
+        /* Panic button, now and then, while the others are still playing */
+        if (atomic_load(&producers_running) && rng(&seed) % 700 == 0) {
+            pthread_mutex_lock(&producer_lock);
+            ms_all_notes_off(sampler);
+            all_offs++;
+            pthread_mutex_unlock(&producer_lock);
+        }
+
+        sleep_us(1000);
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Pitch Bend Check (after the audio thread has stopped)
+ * ========================================================================== */
+
+/**
+ * @brief Render offline and count sign changes on the left channel
+ */
+static uint64_t count_crossings(float *block, size_t frames) {
+    uint64_t crossings = 0;
+    float previous = 0.0f;
+
+    for (size_t done = 0; done < frames; done += buffer_size) {
+        ms_process(sampler, block, buffer_size);
+        for (size_t i = 0; i < buffer_size; i++) {
+            const float sample = block[i * 2];
+            if ((previous < 0.0f) != (sample < 0.0f)) crossings++;
+            previous = sample;
+        }
+    }
+    return crossings;
+}
+
+/**
+ * @brief Check that a full bend up raises a held and a new note by the range
+ */
+static bool check_bend(void) {
+    uint32_t seed = 0xBE4Du;
+    ms_instrument_t *inst = build_instrument(&seed);
+    float *block = (float*)calloc(buffer_size * 2, sizeof(float));
+    if (!inst || !block) {
+        printf("FAIL: could not set up the pitch bend check\n");
+        ms_instrument_destroy(inst);
+        free(block);
+        return false;
+    }
+
+    const size_t window = SAMPLE_RATE / 2;
+    const double expected = pow(2.0, 2.0 * 8191.0 / 8192.0 / 12.0);  /* Default 2-semitone range */
+
+    ms_note_on(inst, 60, 100, NULL);
+    count_crossings(block, buffer_size * 8);
+    const uint64_t straight = count_crossings(block, window);
+
+    ms_pitch_bend(inst, 8191);
+    count_crossings(block, buffer_size);
+    const uint64_t held = count_crossings(block, window);
+
+    ms_note_off(inst, 60);
+    count_crossings(block, SAMPLE_RATE / 10);
+    ms_note_on(inst, 60, 100, NULL);
+    count_crossings(block, buffer_size * 8);
+    const uint64_t fresh = count_crossings(block, window);
+
+    ms_all_notes_off(sampler);
+    count_crossings(block, buffer_size);
+
+    const double held_ratio = straight ? (double)held / straight : 0.0;
+    const double fresh_ratio = straight ? (double)fresh / straight : 0.0;
+    printf("Bend:    held note x%.3f, next note x%.3f (expected x%.3f)\n",
+           held_ratio, fresh_ratio, expected);
+
+    const bool ok = fabs(held_ratio - expected) < 0.01 && fabs(fresh_ratio - expected) < 0.01;
+    if (!ok) {
+        printf("FAIL: pitch bend did not retune the voices\n");
+    }
+
+    ms_instrument_destroy(inst);
+    free(block);
+    return ok;
+}
+
+/* ============================================================================
+ * Main
+ * ========================================================================== */
+
+int main(int argc, char **argv) {
+    double duration = 10.0;
+    int keyboards = 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:b:k:")) != -1) {
+        switch (opt) {
+            case 'd': duration = atof(optarg); break;
+            case 'b': buffer_size = (size_t)atol(optarg); break;
+            case 'k': keyboards = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-d seconds] [-b buffer] [-k keyboards]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (duration <= 0 || buffer_size == 0 || keyboards < 0 || keyboards > MAX_KEYBOARDS) {
+        fprintf(stderr, "Usage: %s [-d seconds] [-b buffer] [-k keyboards]\n", argv[0]);
+        return 1;
+    }
+
+    const ms_audio_config_t config = {
+        .sample_rate = SAMPLE_RATE,
+        .channels = 2,
+        .max_polyphony = MAX_POLYPHONY,
+        .buffer_size = buffer_size
+    };
+    if (ms_sampler_create(&config, &sampler) != MS_SUCCESS) {
+        fprintf(stderr, "Failed to create sampler\n");
+        return 1;
+    }
+
+    uint32_t seed = 0x1234567u;
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        ms_instrument_t *inst = build_instrument(&seed);
+        slots[i] = inst ? wrap_instrument(inst) : NULL;
+        if (!slots[i]) {
+            fprintf(stderr, "Failed to build instruments\n");
+            return 1;
+        }
+        instruments[num_instruments++] = slots[i];
+    }
+
+    printf("Concurrency stress, v%s: %.1f s, %zu-frame blocks, %d keyboard thread(s)\n",
+           ms_version(), duration, buffer_size, keyboards);
+
+    atomic_store(&producers_running, true);
+    atomic_store(&loader_running, true);
+    atomic_store(&ui_running, true);
+    atomic_store(&audio_running, true);
+
+    pthread_t audio, sequencer, loader, ui, keyboard[MAX_KEYBOARDS];
+    pthread_create(&audio, NULL, audio_thread, NULL);
+    pthread_create(&ui, NULL, ui_thread, NULL);
+    pthread_create(&loader, NULL, loader_thread, NULL);
+    pthread_create(&sequencer, NULL, sequencer_thread, NULL);
+    for (int i = 0; i < keyboards; i++) {
+        pthread_create(&keyboard[i], NULL, keyboard_thread, (void*)(uintptr_t)(i + 1));
+    }
+
+    sleep_until_ns(get_time_ns() + (uint64_t)(duration * 1e9));
+
+    /* Players release what they hold on the way out */
+    atomic_store(&producers_running, false);
+    for (int i = 0; i < keyboards; i++) {
+        pthread_join(keyboard[i], NULL);
+    }
+    pthread_join(sequencer, NULL);
+    atomic_store(&loader_running, false);
+    pthread_join(loader, NULL);
+
+    /* Let the releases finish, then collect the last notifications */
+    sleep_until_ns(get_time_ns() + (uint64_t)(DRAIN_SECONDS * 1e9));
+    atomic_store(&ui_running, false);
+    pthread_join(ui, NULL);
+    atomic_store(&audio_running, false);
+    pthread_join(audio, NULL);
+    count_notifications();
+
+    ms_stats_t stats;
+    ms_sampler_get_stats(sampler, &stats);
+
+    const double period_us = buffer_size * 1e6 / SAMPLE_RATE;
+    const uint64_t drain_blocks = (uint64_t)(DRAIN_SECONDS * SAMPLE_RATE / buffer_size);
+    const uint64_t live = voices_started - voices_stolen - voices_finished;
+    int failures = 0;
+
+    printf("\nControl: %llu note-ons (%llu refused, queue full), %llu note-offs, %llu bends,\n"
+           "         %llu all-notes-off, %llu instrument swaps, %llu destroyed mid-run\n",
+           (unsigned long long)notes_on, (unsigned long long)notes_refused,
+           (unsigned long long)notes_off, (unsigned long long)bends,
+           (unsigned long long)all_offs, (unsigned long long)swaps,
+           (unsigned long long)destroys);
+    printf("Voices:  %llu started, %llu stolen, %llu finished, %llu notifications dropped\n",
+           (unsigned long long)voices_started, (unsigned long long)voices_stolen,
+           (unsigned long long)voices_finished,
+           (unsigned long long)stats.voice_events_dropped);
+    printf("Audio:   %llu blocks, %llu late, mean %.1f us, worst %.1f us (period %.1f us, %s)\n",
+           (unsigned long long)blocks, (unsigned long long)late_blocks,
+           blocks ? total_block_ns / 1000.0 / blocks : 0.0, worst_block_ns / 1000.0, period_us,
+           rt_priority ? "SCHED_FIFO" : "normal priority");
+
+    if (stats.voice_events_dropped == 0) {
+        if (voices_started != notes_on) {
+            printf("FAIL: %llu accepted note-ons but %llu voice starts\n",
+                   (unsigned long long)notes_on, (unsigned long long)voices_started);
+            failures++;
+        }
+        if (live != 0) {
+            printf("FAIL: %llu voice(s) never finished\n", (unsigned long long)live);
+            failures++;
+        }
+    } else {
+        printf("Note: notifications were dropped, voice accounting skipped\n");
+    }
+    if (blocks < drain_blocks || last_loud_block + drain_blocks / 2 >= blocks) {
+        printf("FAIL: output still sounding %llu block(s) before the end\n",
+               (unsigned long long)(blocks - last_loud_block));
+        failures++;
+    }
+    if (!check_bend()) {
+        failures++;
+    }
+    printf("%s\n", failures ? "FAILED" : "OK: no lost events, no stuck voices");
+
+    for (size_t i = 0; i < num_instruments; i++) {
+        ms_instrument_destroy(instruments[i]->instrument);
+        free(instruments[i]);
+    }
+    ms_sampler_destroy(sampler);
+    return failures ? 1 : 0;
+}
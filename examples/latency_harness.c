@@ -0,0 +1,514 @@
+/**
+ * @file latency_harness.c
+ * @brief End-to-end event-to-audio latency measurement
+ *
+ * Render time says little about how long a note takes to become audible.
+ * This harness measures that directly. A producer thread stamps each
+ * note-on with CLOCK_MONOTONIC and sends it. An audio thread paced like a
+ * sound card renders blocks and looks for the onset of the test
+ * instrument, a click that is full scale from its first frame.
+ *
+ * A block rendered in period k is taken to play during period k + 1, as on
+ * a double-buffered device. The latency of a note is the time from the
+ * send call to its first audible frame. It therefore includes one buffer
+ * of output latency, the wait for the next block boundary and whatever
+ * the queue adds. Notes are sent at random phases against the block
+ * clock, so the result is a distribution, not a single number.
+ *
+ * Scheduled notes are the exception. They are stamped several buffers
+ * ahead, so what matters is how close to the stamped frame they sound,
+ * not how long after the send. Their rows give the first audible frame
+ * relative to the time the stamped frame plays; negative values are
+ * notes that started early because the engine applies events at block
+ * boundaries, and the spread between min and max is the timing jitter.
+ *
+ * Every combination of buffer size, queue mode and background load gets
+ * a row. Background load is that many threads streaming memory on every
+ * core. Queue modes (real-time engine; the core engine has only direct):
+ *
+ *   direct     ms_note_on() from the producer, applied at the next block
+ *   midi       raw bytes through ms_midi_input_feed(), next block
+ *   scheduled  ms_midi_input_feed() stamped SCHEDULE_AHEAD buffers past
+ *              the device clock, held in the queue until its block is due
+ *   pull       ms_note_on() with the library render thread filling a
+ *              4-buffer ring that the audio thread drains
+ *
+ * Build against either engine and compare the output.
+ *
+ * Usage: latency_harness [-n notes] [-b sizes] [-m modes] [-l threads] [-p]
+ *   -n  notes per configuration (default 100)
+ *   -b  comma-separated buffer sizes (default 64,128,256,512)
+ *   -m  comma-separated queue modes (default all the engine has)
+ *   -l  background load threads (default one per CPU, 0 = unloaded only)
+ *   -p  keep the audio thread at normal priority instead of SCHED_FIFO
+ */
+
+#define _GNU_SOURCE
+#include "midi_sampler.h"
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define TEST_NOTE 60
+#define CLICK_FRAMES 32
+#define ONSET_THRESHOLD 0.25f
+#define NOTE_TIMEOUT_NS 500000000ULL
+#define LOAD_BUFFER_BYTES (16u * 1024 * 1024)
+#define MAX_BUFFER_SIZES 16
+#define SCHEDULE_AHEAD 3            /* Buffers between the send and a scheduled note's frame */
+
+typedef enum {
+    MODE_DIRECT,
+    MODE_MIDI,
+    MODE_SCHEDULED,
+    MODE_PULL,
+    MODE_COUNT
+} queue_mode_t;
+
+static const char *mode_names[MODE_COUNT] = { "direct", "midi", "scheduled", "pull" };
+
+#ifdef ENABLE_RT_OPTIMIZATIONS
+static const char *engine_name = "rt";
+#else
+static const char *engine_name = "core";
+#endif
+
+typedef struct {
+    ms_sampler_t *sampler;
+    ms_instrument_t *instrument;
+    queue_mode_t mode;
+    size_t buffer_size;
+    uint64_t period_ns;
+    size_t notes;
+
+    atomic_bool ready;              /* Device clock running */
+    atomic_bool running;
+    uint64_t start_ns;              /* Device time of frame 0 */
+    _Atomic uint64_t inject_ns;     /* Reference time of the pending note, 0 = none */
+
+    /* Written by the audio thread, read after it has been joined */
+    int64_t *latencies;
+    size_t detected;
+    uint32_t late_blocks;
+    uint64_t worst_block_ns;
+    bool rt_priority;
+
+    /* Written by the producer */
+    size_t lost;
+} run_t;
+
+static atomic_bool load_running;
+static bool use_rt_priority = true;
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t) {
+    const struct timespec ts = {
+        .tv_sec = (time_t)(t / 1000000000ULL),
+        .tv_nsec = (long)(t % 1000000000ULL)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+static uint32_t rng(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static int compare_i64(const void *a, const void *b) {
+    const int64_t x = *(const int64_t*)a;
+    const int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* ============================================================================
+ * Threads
+ * ========================================================================== */
+
+static void *load_thread(void *arg) {
+    (void)arg;
+    char *buffer = (char*)malloc(LOAD_BUFFER_BYTES);
+    if (!buffer) return NULL;
+
+    memset(buffer, 1, LOAD_BUFFER_BYTES);
+    const size_t half = LOAD_BUFFER_BYTES / 2;
+    while (atomic_load_explicit(&load_running, memory_order_relaxed)) {
+        memcpy(buffer + half, buffer, half);
+        memcpy(buffer, buffer + half, half);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+/* Render one device period's worth of audio */
+static void render_block(run_t *run, float *block) {
+#ifdef ENABLE_RT_OPTIMIZATIONS
+    if (run->mode == MODE_PULL) {
+        ms_render_read(run->sampler, block, run->buffer_size);
+        return;
+    }
+#endif
+    ms_process(run->sampler, block, run->buffer_size);
+}
+
+static void *audio_thread(void *arg) {
+    run_t *run = (run_t*)arg;
+    float *block = (float*)calloc(run->buffer_size * 2, sizeof(float));
+    if (!block) {
+        atomic_store(&run->ready, true);
+        return NULL;
+    }
+
+    if (use_rt_priority) {
+        struct sched_param param = { .sched_priority = sched_get_priority_max(SCHED_FIFO) - 10 };
+        run->rt_priority = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+
+#ifdef ENABLE_RT_OPTIMIZATIONS
+    if (run->mode == MODE_PULL) {
+        const ms_render_config_t render = {
+            .ring_frames = (uint32_t)run->buffer_size * 4,
+            .block_frames = (uint32_t)run->buffer_size,
+            .priority = 0
+        };
+        if (ms_sampler_start_render(run->sampler, &render) != MS_SUCCESS) {
+            fprintf(stderr, "Cannot start the render thread\n");
+            free(block);
+            atomic_store(&run->ready, true);
+            return NULL;
+        }
+        while (ms_render_available(run->sampler) < run->buffer_size * 2) {
+            sched_yield();
+        }
+    }
+#endif
+
+    run->start_ns = get_time_ns() + run->period_ns;
+    atomic_store(&run->ready, true);
+
+    for (uint64_t k = 0; atomic_load(&run->running); k++) {
+        const uint64_t deadline = run->start_ns + k * run->period_ns;
+        sleep_until_ns(deadline);
+
+        const uint64_t t0 = get_time_ns();
+        render_block(run, block);
+        const uint64_t t1 = get_time_ns();
+
+        if (t1 - t0 > run->worst_block_ns) run->worst_block_ns = t1 - t0;
+        if (t1 > deadline + run->period_ns) run->late_blocks++;
+
+        uint64_t injected = atomic_load_explicit(&run->inject_ns, memory_order_acquire);
+        if (!injected) continue;
+
+        for (size_t i = 0; i < run->buffer_size; i++) {
+            if (fabsf(block[i * 2]) < ONSET_THRESHOLD) continue;
+
+            /* Block k plays during period k + 1 */
+            const uint64_t onset = deadline + run->period_ns +
+                                   (uint64_t)i * 1000000000ULL / SAMPLE_RATE;
+            if (atomic_compare_exchange_strong(&run->inject_ns, &injected, 0)) {
+                /* Only scheduled notes sound early; otherwise it is a late block */
+                const int64_t latency = (int64_t)(onset - injected);
+                run->latencies[run->detected++] =
+                    run->mode == MODE_SCHEDULED || latency > 0 ? latency : 0;
+            }
+            break;
+        }
+    }
+
+#ifdef ENABLE_RT_OPTIMIZATIONS
+    if (run->mode == MODE_PULL) {
+        ms_sampler_stop_render(run->sampler);
+    }
+#endif
+    free(block);
+    return NULL;
+}
+
+#ifdef ENABLE_RT_OPTIMIZATIONS
+/* Engine frame to stamp an event sent at now_ns with, 0 = next block */
+static uint64_t schedule_frame(const run_t *run, uint64_t now_ns) {
+    if (run->mode != MODE_SCHEDULED) return 0;
+
+    /* Device clock now, plus enough buffers that the block is well clear of rendering */
+    const uint64_t elapsed = now_ns > run->start_ns ? now_ns - run->start_ns : 0;
+    return elapsed * SAMPLE_RATE / 1000000000ULL + SCHEDULE_AHEAD * run->buffer_size;
+}
+
+static void send_midi(ms_midi_input_t *input, uint8_t status, uint64_t frame) {
+    const uint8_t bytes[3] = { status, TEST_NOTE, status == 0x90 ? 127 : 0 };
+    ms_midi_input_feed(input, bytes, sizeof(bytes), frame);
+}
+#endif
+
+static void *producer_thread(void *arg) {
+    run_t *run = (run_t*)arg;
+    uint32_t seed = 0x9E3779B9u ^ (uint32_t)run->buffer_size ^ ((uint32_t)run->mode << 16);
+
+#ifdef ENABLE_RT_OPTIMIZATIONS
+    ms_midi_input_t input;
+    ms_midi_input_init(&input, run->sampler);
+    ms_midi_input_set_instrument(&input, -1, run->instrument);
+    const bool use_midi = run->mode == MODE_MIDI || run->mode == MODE_SCHEDULED;
+#endif
+
+    while (!atomic_load(&run->ready)) {
+        sched_yield();
+    }
+
+    for (size_t n = 0; n < run->notes; n++) {
+        /* One to three periods at a random phase against the block clock */
+        const uint64_t gap = run->period_ns + rng(&seed) % (2 * run->period_ns);
+        sleep_until_ns(get_time_ns() + gap);
+
+        const uint64_t sent = get_time_ns();
+        uint64_t reference = sent;
+#ifdef ENABLE_RT_OPTIMIZATIONS
+        const uint64_t frame = schedule_frame(run, sent);
+        if (frame) {
+            /* Frame f is rendered in block f / buffer and plays one period later */
+            reference = run->start_ns + run->period_ns + frame * 1000000000ULL / SAMPLE_RATE;
+        }
+#endif
+        atomic_store_explicit(&run->inject_ns, reference, memory_order_release);
+#ifdef ENABLE_RT_OPTIMIZATIONS
+        if (use_midi) {
+            send_midi(&input, 0x90, frame);
+        } else
+#endif
+        ms_note_on(run->instrument, TEST_NOTE, 127, NULL);
+
+        while (atomic_load_explicit(&run->inject_ns, memory_order_acquire) == reference &&
+               get_time_ns() - sent < NOTE_TIMEOUT_NS) {
+            sleep_until_ns(get_time_ns() + 100000);
+        }
+        uint64_t expected = reference;
+        if (atomic_compare_exchange_strong(&run->inject_ns, &expected, 0)) {
+            run->lost++;
+        }
+
+#ifdef ENABLE_RT_OPTIMIZATIONS
+        if (use_midi) {
+            send_midi(&input, 0x80, schedule_frame(run, get_time_ns()));
+        } else
+#endif
+        ms_note_off(run->instrument, TEST_NOTE);
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Measurement
+ * ========================================================================== */
+
+static ms_error_t create_instrument(ms_sampler_t *sampler, ms_instrument_t **instrument) {
+    ms_error_t err = ms_instrument_create(sampler, "click", instrument);
+    if (err != MS_SUCCESS) return err;
+
+    float click[CLICK_FRAMES * 4] = { 0 };
+    for (size_t i = 0; i < CLICK_FRAMES; i++) {
+        click[i] = 1.0f;
+    }
+
+    const ms_sample_metadata_t metadata = {
+        .root_note = TEST_NOTE,
+        .velocity_low = 0,
+        .velocity_high = 127,
+        .loop_enabled = false
+    };
+    err = ms_instrument_load_sample_memory(*instrument, click, CLICK_FRAMES * 4, 1, &metadata);
+    if (err != MS_SUCCESS) return err;
+
+    const ms_envelope_t envelope = {
+        .attack_time = 0.0f,
+        .decay_time = 0.0f,
+        .sustain_level = 1.0f,
+        .release_time = 0.0f
+    };
+    return ms_instrument_set_envelope(*instrument, &envelope);
+}
+
+static void run_config(queue_mode_t mode, size_t buffer_size, int load_threads, size_t notes) {
+    const ms_audio_config_t config = {
+        .sample_rate = SAMPLE_RATE,
+        .channels = 2,
+        .max_polyphony = 16,
+        .buffer_size = buffer_size
+    };
+
+    run_t run;
+    memset(&run, 0, sizeof(run));
+    run.mode = mode;
+    run.buffer_size = buffer_size;
+    run.period_ns = (uint64_t)buffer_size * 1000000000ULL / SAMPLE_RATE;
+    run.notes = notes;
+    run.latencies = (int64_t*)calloc(notes, sizeof(int64_t));
+    atomic_init(&run.ready, false);
+    atomic_init(&run.running, true);
+    atomic_init(&run.inject_ns, 0);
+
+    if (!run.latencies ||
+        ms_sampler_create(&config, &run.sampler) != MS_SUCCESS ||
+        create_instrument(run.sampler, &run.instrument) != MS_SUCCESS) {
+        fprintf(stderr, "Setup failed for %s/%zu\n", mode_names[mode], buffer_size);
+        if (run.sampler) ms_sampler_destroy(run.sampler);
+        free(run.latencies);
+        return;
+    }
+
+    pthread_t *loaders = (pthread_t*)calloc((size_t)load_threads + 1, sizeof(pthread_t));
+    int started = 0;
+    atomic_store(&load_running, true);
+    for (int i = 0; loaders && i < load_threads; i++) {
+        if (pthread_create(&loaders[i], NULL, load_thread, NULL) == 0) started++;
+    }
+
+    pthread_t audio, producer;
+    pthread_create(&audio, NULL, audio_thread, &run);
+    pthread_create(&producer, NULL, producer_thread, &run);
+    pthread_join(producer, NULL);
+    atomic_store(&run.running, false);
+    pthread_join(audio, NULL);
+
+    atomic_store(&load_running, false);
+    for (int i = 0; i < started; i++) {
+        pthread_join(loaders[i], NULL);
+    }
+    free(loaders);
+
+    const size_t n = run.detected;
+    printf("%-10s %6zu %4d %s %5zu %4zu", mode_names[mode], buffer_size, started,
+           run.rt_priority ? "fifo " : "other", n, run.lost);
+    if (n > 0) {
+        qsort(run.latencies, n, sizeof(int64_t), compare_i64);
+        const double ms = 1e-6;
+        printf(" %7.2f %7.2f %7.2f %7.2f %7.2f %6.2f",
+               run.latencies[0] * ms, run.latencies[n / 2] * ms,
+               run.latencies[n * 9 / 10] * ms, run.latencies[n * 99 / 100] * ms,
+               run.latencies[n - 1] * ms, (double)run.latencies[n / 2] / run.period_ns);
+    } else {
+        printf(" %7s %7s %7s %7s %7s %6s", "-", "-", "-", "-", "-", "-");
+    }
+    printf(" %5u %8.1f\n", run.late_blocks, run.worst_block_ns / 1000.0);
+    fflush(stdout);
+
+    ms_sampler_destroy(run.sampler);
+    free(run.latencies);
+}
+
+/* ============================================================================
+ * Main
+ * ========================================================================== */
+
+static bool mode_supported(queue_mode_t mode) {
+#ifdef ENABLE_RT_OPTIMIZATIONS
+    (void)mode;
+    return true;
+#else
+    return mode == MODE_DIRECT;
+#endif
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n notes] [-b sizes] [-m modes] [-l threads] [-p]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    size_t notes = 100;
+    size_t sizes[MAX_BUFFER_SIZES] = { 64, 128, 256, 512 };
+    size_t num_sizes = 4;
+    bool modes[MODE_COUNT];
+    for (int m = 0; m < MODE_COUNT; m++) {
+        modes[m] = mode_supported((queue_mode_t)m);
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int load_threads = cpus > 0 ? (int)cpus : 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:m:l:p")) != -1) {
+        switch (opt) {
+            case 'n':
+                notes = (size_t)atol(optarg);
+                break;
+            case 'b':
+                num_sizes = 0;
+                for (char *tok = strtok(optarg, ","); tok && num_sizes < MAX_BUFFER_SIZES;
+                     tok = strtok(NULL, ",")) {
+                    sizes[num_sizes++] = (size_t)atol(tok);
+                }
+                break;
+            case 'm':
+                memset(modes, 0, sizeof(modes));
+                for (char *tok = strtok(optarg, ","); tok; tok = strtok(NULL, ",")) {
+                    int m = 0;
+                    while (m < MODE_COUNT && strcmp(tok, mode_names[m]) != 0) m++;
+                    if (m == MODE_COUNT || !mode_supported((queue_mode_t)m)) {
+                        fprintf(stderr, "Mode '%s' not available in the %s engine\n",
+                                tok, engine_name);
+                        return 1;
+                    }
+                    modes[m] = true;
+                }
+                break;
+            case 'l':
+                load_threads = atoi(optarg);
+                break;
+            case 'p':
+                use_rt_priority = false;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    for (size_t i = 0; i < num_sizes; i++) {
+        if (sizes[i] == 0 || (sizes[i] & (sizes[i] - 1)) != 0) {
+            fprintf(stderr, "Buffer sizes must be powers of two\n");
+            return 1;
+        }
+    }
+    if (notes == 0 || load_threads < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("Event-to-audio latency, %s engine v%s, %d Hz\n", engine_name, ms_version(),
+           SAMPLE_RATE);
+    printf("Send call to first audible frame, including one buffer of output latency\n");
+    if (modes[MODE_SCHEDULED]) {
+        printf("Scheduled: first audible frame against the stamped frame, %d buffers ahead\n",
+               SCHEDULE_AHEAD);
+    }
+    printf("\n");
+    printf("%-10s %6s %4s %5s %5s %4s %7s %7s %7s %7s %7s %6s %5s %8s\n",
+           "mode", "buffer", "load", "prio", "notes", "lost", "min ms", "p50", "p90", "p99",
+           "max", "p50/bf", "late", "worst us");
+
+    for (int load = 0; load <= 1; load++) {
+        if (load && load_threads == 0) break;
+        for (int m = 0; m < MODE_COUNT; m++) {
+            if (!modes[m]) continue;
+            for (size_t i = 0; i < num_sizes; i++) {
+                run_config((queue_mode_t)m, sizes[i], load ? load_threads : 0, notes);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file midi_input_bench.c
+ * @brief Throughput benchmark for the live MIDI byte-stream parser
+ *
+ * Feeds a synthetic stream (running status, interleaved MIDI clock and
+ * active sensing, SysEx dumps, pitch bend) through ms_midi_input_feed()
+ * in small chunks, like a raw-MIDI reader would, and drains the event
+ * queue with ms_process() between chunks.
+ *
+ * Usage: midi_input_bench [megabytes]
+ */
+
+#define _GNU_SOURCE
+#include "midi_sampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CHUNK_BYTES 96      /* Stays well below the event queue capacity */
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* Append one message (plus noise) to buf, return bytes written */
+static size_t generate_message(uint8_t *buf, uint8_t *running) {
+    size_t n = 0;
+    uint32_t r = rng();
+
+    if (r % 97 == 0) {
+        /* SysEx dump */
+        buf[n++] = 0xF0;
+        for (int i = 0; i < 24; i++) buf[n++] = (uint8_t)(rng() & 0x7F);
+        buf[n++] = 0xF7;
+        *running = 0;
+        return n;
+    }
+
+    uint8_t status;
+    if (r % 13 == 0) {
+        status = 0xE0 | (r >> 8 & 0x0F);                /* Pitch bend */
+    } else {
+        status = ((r >> 4) & 1 ? 0x90 : 0x80) | (r >> 8 & 0x0F);
+    }
+
+    if (status != *running) {
+        buf[n++] = status;
+        *running = status;
+    }
+    buf[n++] = (uint8_t)(rng() & 0x7F);
+    if (r % 7 == 0) buf[n++] = 0xF8;                    /* Clock mid-message */
+    buf[n++] = (uint8_t)(rng() & 0x7F);
+    if (r % 11 == 0) buf[n++] = 0xFE;                   /* Active sensing */
+
+    return n;
+}
+
+int main(int argc, char **argv) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+    if (megabytes == 0) megabytes = 16;
+    size_t length = megabytes * 1024 * 1024;
+
+    uint8_t *stream = (uint8_t*)malloc(length + 64);
+    if (!stream) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    uint8_t running = 0;
+    size_t filled = 0;
+    while (filled < length) {
+        filled += generate_message(stream + filled, &running);
+    }
+
+    ms_audio_config_t config = {
+        .sample_rate = 48000,
+        .channels = 2,
+        .max_polyphony = 32,
+        .buffer_size = 64
+    };
+
+    ms_sampler_t *sampler = NULL;
+    ms_instrument_t *instrument = NULL;
+    if (ms_sampler_create(&config, &sampler) != MS_SUCCESS ||
+        ms_instrument_create(sampler, "bench", &instrument) != MS_SUCCESS) {
+        fprintf(stderr, "Failed to create sampler\n");
+        return 1;
+    }
+
+    ms_midi_input_t input;
+    ms_midi_input_init(&input, sampler);
+    ms_midi_input_set_instrument(&input, -1, instrument);
+
+    float output[2];
+    uint64_t parse_ns = 0;
+    uint64_t start = get_time_ns();
+
+    for (size_t offset = 0; offset < filled; offset += CHUNK_BYTES) {
+        size_t chunk = filled - offset < CHUNK_BYTES ? filled - offset : CHUNK_BYTES;
+
+        uint64_t t0 = get_time_ns();
+        ms_midi_input_feed(&input, stream + offset, chunk, 0);
+        parse_ns += get_time_ns() - t0;
+
+        ms_process(sampler, output, 1);
+    }
+
+    uint64_t total_ns = get_time_ns() - start;
+
+    printf("Stream:        %.1f MB, %zu-byte chunks\n", filled / 1048576.0, (size_t)CHUNK_BYTES);
+    printf("Events queued: %llu (dropped %llu)\n",
+           (unsigned long long)input.events, (unsigned long long)input.dropped);
+    printf("Parse:         %.1f M events/s, %.1f MB/s\n",
+           input.events * 1e3 / parse_ns, filled * 1e9 / 1048576.0 / parse_ns);
+    printf("Parse + drain: %.1f M events/s\n", input.events * 1e3 / total_ns);
+
+    ms_instrument_destroy(instrument);
+    ms_sampler_destroy(sampler);
+    free(stream);
+    return 0;
+}
@@ -45,6 +45,15 @@ typedef struct ms_sampler_t ms_sampler_t;
 /** Opaque handle to a sample instrument */
 typedef struct ms_instrument_t ms_instrument_t;
 
+/** Opaque handle to an independently playing MIDI sequence (RT builds) */
+typedef struct ms_sequence_t ms_sequence_t;
+
+/** Opaque handle to a voice budget shared by several samplers (RT builds) */
+typedef struct ms_voice_pool_t ms_voice_pool_t;
+
+/** Opaque handle to another process's live statistics (RT builds) */
+typedef struct ms_monitor_t ms_monitor_t;
+
 /* ============================================================================
  * Configuration Structures
  * ========================================================================== */
@@ -169,6 +178,14 @@ ms_error_t ms_instrument_set_envelope(
 /**
  * @brief Destroy an instrument and free its resources
  * 
+ * In RT builds the audio thread first ends the instrument's voices and
+ * returns its voice reservation; the call waits for that at the next
+ * block. If ms_process() makes no progress for about 100 ms, the memory
+ * is freed later instead, by another destroy or by ms_sampler_destroy().
+ * Callable from any thread. Events already sent to it that have not
+ * played yet are discarded. Sequences and the MIDI file player must no
+ * longer route to it, and no other call may be made on it.
+ * 
  * @param instrument Instrument to destroy
  */
 void ms_instrument_destroy(ms_instrument_t *instrument);
@@ -183,7 +200,9 @@ void ms_instrument_destroy(ms_instrument_t *instrument);
  * @param instrument Instrument to play
  * @param note MIDI note number (0-127)
  * @param velocity MIDI velocity (0-127)
- * @param voice_id Output pointer for voice ID (optional, can be NULL)
+ * @param voice_id Output pointer for voice ID (optional, can be NULL). In
+ *                 real-time builds this is a handle for the ms_voice_*()
+ *                 commands, valid from the moment ms_note_on() returns
  * @return MS_SUCCESS on success, error code otherwise
  */
 ms_error_t ms_note_on(
@@ -215,9 +234,13 @@ void ms_all_notes_off(ms_sampler_t *sampler);
 /**
  * @brief Apply pitch bend to an instrument
  * 
+ * In real-time builds the bend is queued like a note and applied at the
+ * start of the next block; call from the same thread as ms_note_on().
+ * 
  * @param instrument Target instrument
  * @param value Pitch bend value (-8192 to +8191, 0 = no bend)
- * @return MS_SUCCESS on success, error code otherwise
+ * @return MS_SUCCESS on success, error code otherwise (real-time builds:
+ *         MS_ERROR_BUFFER_OVERFLOW if the event queue is full)
  */
 ms_error_t ms_pitch_bend(
     ms_instrument_t *instrument,
@@ -283,6 +306,974 @@ void ms_stop_playback(ms_sampler_t *sampler);
  */
 bool ms_is_playing(const ms_sampler_t *sampler);
 
+/* ============================================================================
+ * Real-Time Extensions (ENABLE_RT_OPTIMIZATIONS builds only)
+ * ========================================================================== */
+
+/**
+ * @brief Disk I/O backend used by the streamer
+ */
+typedef enum {
+    MS_STREAM_IO_AUTO = 0,      /**< io_uring when the kernel allows it, else pread */
+    MS_STREAM_IO_URING,         /**< Batched io_uring reads into registered buffers */
+    MS_STREAM_IO_PREAD          /**< One pread() per refill on the streamer thread */
+} ms_stream_io_t;
+
+/**
+ * @brief Disk streaming configuration
+ *
+ * Streamed samples keep only a preload head of each zone in RAM; the rest
+ * is read from disk by a background streamer thread while the voice plays
+ * the preload.
+ */
+typedef struct {
+    float preload_ms;           /**< Streamer latency covered by each zone's preload */
+    uint32_t max_start_offset;  /**< Extra preload frames reserved for sample-start offsets */
+    uint32_t ring_frames;       /**< Per-voice streaming buffer in frames (power of two) */
+    ms_stream_io_t io_backend;  /**< Disk I/O backend */
+    bool direct_io;             /**< Bypass the page cache (O_DIRECT) where supported */
+    float lookahead_ms;         /**< Sequencer lookahead for zone prefetch (0 disables) */
+} ms_stream_config_t;
+
+/**
+ * @brief Self-hosted render thread configuration
+ *
+ * The ring size bounds the latency between rendering and reading.
+ */
+typedef struct {
+    uint32_t ring_frames;       /**< Output ring capacity in frames (power of two) */
+    uint32_t block_frames;      /**< Frames per ms_process() call (0 = buffer_size) */
+    int priority;               /**< SCHED_FIFO priority of the thread (0 = inherit) */
+} ms_render_config_t;
+
+/**
+ * @brief Per-instrument share of the sampler's voices
+ *
+ * Instruments with a higher priority steal from lower ones, never the
+ * other way round; reserved voices are kept free for their instrument and
+ * are never stolen by others.
+ */
+typedef struct {
+    uint16_t max_voices;        /**< Limit; the instrument steals its own oldest voice beyond it (0 = none) */
+    uint16_t reserved_voices;   /**< Voices guaranteed to the instrument */
+    int priority;               /**< Higher wins when voices run out */
+} ms_voice_budget_t;
+
+#define MS_TUNING_NOTES 128
+
+/**
+ * @brief Frequency of every MIDI note
+ */
+typedef struct {
+    double frequency[MS_TUNING_NOTES];  /**< Hz, 0 = key not mapped (silent) */
+} ms_tuning_t;
+
+/**
+ * @brief Limits for pre-rendering an instrument's notes
+ */
+typedef struct {
+    uint32_t max_notes;         /**< Notes to render, highest weight first (0 = 32) */
+    size_t max_bytes;           /**< Memory for rendered audio (0 = 64 MB) */
+    uint32_t threads;           /**< Rendering threads (0 = one per CPU) */
+} ms_note_cache_config_t;
+
+/**
+ * @brief Processing applied to every sample loaded into RAM
+ *
+ * Stages run in this order; all are off in a zeroed config. Loop points
+ * move with the audio, and looped regions are never trimmed.
+ */
+typedef struct {
+    bool downmix;               /**< Average channels to mono (playback uses the first channel) */
+    bool resample;              /**< Convert to the sampler's rate with windowed-sinc filtering */
+    bool trim_silence;          /**< Cut leading frames quieter than trim_db */
+    float trim_db;              /**< Leading silence threshold (dBFS, e.g. -60) */
+    bool trim_tail;             /**< Cut the tail after the last frame louder than tail_db */
+    float tail_db;              /**< Tail threshold (dBFS, e.g. -80) */
+    float tail_fade_ms;         /**< Fade kept after the last loud frame */
+    bool remove_dc;             /**< Subtract each channel's mean */
+    bool normalize;             /**< Scale the peak to normalize_db */
+    float normalize_db;         /**< Target peak (dBFS) */
+    uint32_t threads;           /**< Threads for bulk loads (0 = one per CPU) */
+} ms_preprocess_config_t;
+
+typedef enum {
+    MS_PREPROCESS_DECODE = 0,   /**< Reading and PCM conversion */
+    MS_PREPROCESS_CONVERT,
+    MS_PREPROCESS_RESAMPLE,
+    MS_PREPROCESS_TRIM,
+    MS_PREPROCESS_DC,
+    MS_PREPROCESS_NORMALIZE,
+    MS_PREPROCESS_LAYOUT,       /**< Copy into the playback buffer */
+    MS_PREPROCESS_CACHE,        /**< Sample cache lookups, mapping and writes */
+    MS_PREPROCESS_STAGES
+} ms_preprocess_stage_t;
+
+/**
+ * @brief Cumulative preprocessing work since the sampler was created
+ */
+typedef struct {
+    uint64_t stage_ns[MS_PREPROCESS_STAGES];  /**< Time per stage, summed over threads */
+    uint64_t files;             /**< Files decoded and processed */
+    uint64_t frames_in;         /**< Frames decoded */
+    uint64_t frames_out;        /**< Frames kept after resampling and trimming */
+    uint64_t cache_hits;        /**< Files mapped from the sample cache */
+    uint64_t cache_misses;      /**< Files the sample cache did not have */
+} ms_preprocess_stats_t;
+
+/**
+ * @brief On-disk cache of preprocessed samples
+ */
+typedef struct {
+    const char *directory;      /**< Created if missing (one level) */
+    uint64_t max_bytes;         /**< Size limit, least recently used entries go first (0 = 1 GB) */
+} ms_sample_cache_config_t;
+
+/**
+ * @brief Ceiling for the sample memory of a sampler
+ */
+typedef struct {
+    size_t max_bytes;           /**< Budget for managed zones (0 = none, evicted zones still reload) */
+    uint32_t head_ms;           /**< Audio kept resident per zone (0 = 250 ms) */
+} ms_memory_budget_t;
+
+/**
+ * @brief How an instrument plays overlapping notes
+ */
+typedef enum {
+    MS_VOICE_MODE_POLY = 0,     /**< One voice per note */
+    MS_VOICE_MODE_MONO,         /**< One voice, retriggered by every note */
+    MS_VOICE_MODE_LEGATO        /**< One voice, retriggered only when no other key is held */
+} ms_voice_mode_t;
+
+/**
+ * @brief Overload governor stages, each including the ones before it
+ */
+typedef enum {
+    MS_GOVERNOR_NORMAL = 0,     /**< Full quality */
+    MS_GOVERNOR_REDUCED_QUALITY,/**< Quiet voices use nearest-sample interpolation */
+    MS_GOVERNOR_RETIRE_QUIET,   /**< Voices below retire_db are ended */
+    MS_GOVERNOR_CAP_POLYPHONY   /**< New notes beyond polyphony_cap steal the quietest voice */
+} ms_governor_level_t;
+
+/**
+ * @brief Overload governor configuration
+ *
+ * DSP load is the time ms_process() takes divided by the duration of the
+ * block it renders.
+ */
+typedef struct {
+    float high_load;            /**< Smoothed load that escalates one stage per block */
+    float low_load;             /**< Load below which stages are undone */
+    float hold_ms;              /**< Time the load must stay low before each recovery step */
+    float quiet_db;             /**< Voice level (dBFS) below which quality is reduced */
+    float retire_db;            /**< Voice level (dBFS) below which voices are retired */
+    uint16_t polyphony_cap;     /**< Sounding voices allowed in the last stage */
+} ms_governor_config_t;
+
+/**
+ * @brief Voice lifecycle notification kinds
+ */
+typedef enum {
+    MS_VOICE_STARTED,           /**< A note-on got a voice */
+    MS_VOICE_STOLEN,            /**< A sounding voice was cut to make room */
+    MS_VOICE_FINISHED           /**< A voice ended (release done or sample end) */
+} ms_voice_event_type_t;
+
+/**
+ * @brief Voice lifecycle notification sent from the audio thread
+ */
+typedef struct {
+    ms_voice_event_type_t type;
+    uint32_t voice_id;          /**< Unique per started note */
+    uint8_t note;
+    ms_instrument_t *instrument;
+    uint64_t frame;             /**< Engine frame of the block it happened in */
+} ms_voice_event_t;
+
+/**
+ * @brief Engine statistics snapshot
+ */
+typedef struct {
+    uint64_t frames_processed;       /**< Total frames rendered */
+    uint32_t xruns;                  /**< Buffer underruns */
+
+    /* Disk streaming */
+    uint64_t stream_voice_starts;    /**< Voices started on a streamed zone */
+    uint64_t stream_underruns;       /**< Voices that outran their preload before the streamer caught up */
+    uint64_t stream_underrun_frames; /**< Frames rendered as silence while waiting for the streamer */
+    uint64_t stream_bytes_read;      /**< Bytes read from disk by the streamer */
+    size_t preload_bytes;            /**< RAM held by zone preload caches */
+    size_t preload_hugepage_bytes;   /**< Part of preload_bytes backed by explicit huge pages */
+    ms_stream_io_t stream_io;        /**< Backend actually in use (never AUTO) */
+    uint64_t stream_reads;           /**< Disk read operations completed */
+    uint32_t stream_iops;            /**< Read operations per second over the last second */
+    uint32_t stream_queue_depth;     /**< Reads in flight in the most recent batch */
+    uint32_t stream_max_queue_depth; /**< Largest batch submitted so far */
+    uint64_t prefetches;             /**< Zones read ahead by the sequencer lookahead */
+    uint64_t prefetch_hits;          /**< Streamed voices started from a prefetched zone */
+    uint64_t prefetch_misses;        /**< Streamed voices that had to wait for the disk */
+
+    /* Self-hosted render thread */
+    size_t render_buffered_frames;   /**< Frames rendered but not read yet */
+    uint64_t render_underrun_frames; /**< Frames read as silence because the ring was empty */
+
+    /* Voice notifications */
+    uint64_t voice_events_dropped;   /**< Notifications lost because the host did not poll */
+    uint64_t voice_commands_stale;   /**< ms_voice_*() commands whose voice had already ended */
+
+    /* Overload governor (zero while disabled) */
+    ms_governor_level_t governor_level; /**< Current degradation stage */
+    float dsp_load;                  /**< Smoothed DSP load (1.0 = deadline) */
+    float dsp_peak_load;             /**< Highest single-block load seen */
+    uint64_t governor_escalations;   /**< Times the governor left MS_GOVERNOR_NORMAL */
+    uint64_t governor_retired_voices;/**< Voices ended early for being too quiet */
+    uint64_t governor_capped_notes;  /**< Note-ons that stole a voice because of the cap */
+
+    /* Voice budget */
+    uint64_t notes_rejected;         /**< Note-ons dropped because every voice was protected */
+
+    /* Event drain */
+    uint64_t events_coalesced;       /**< Controller messages superseded within a block */
+
+    /* Note cache */
+    uint64_t notes_cached;           /**< Note-ons played from pre-rendered notes */
+
+    /* Memory budget */
+    size_t resident_bytes;           /**< Managed sample memory currently in RAM */
+    uint64_t zones_evicted;          /**< Zone bodies freed to stay within the budget */
+    uint64_t zones_reloaded;         /**< Evicted zone bodies read back for playing */
+    uint64_t head_underruns;         /**< Voices that reached the end of a head before the reload */
+
+    /* Voice allocation */
+    uint64_t voices_stolen;          /**< Note-ons that took a sounding voice */
+} ms_stats_t;
+
+#define MS_MONITOR_LOAD_BINS 16      /**< 10 % of the block period each, the last one open-ended */
+
+/**
+ * @brief Live statistics read from a published segment
+ *
+ * Updated by the audio thread at the end of every block.
+ */
+typedef struct {
+    uint64_t updates;                /**< Blocks published since the segment was created */
+    uint64_t timestamp_ns;           /**< CLOCK_MONOTONIC time of the last update */
+    int32_t pid;                     /**< Publishing process */
+    uint32_t sample_rate;
+    uint64_t frames_processed;
+    uint32_t xruns;
+    uint32_t active_voices;
+    uint32_t max_polyphony;
+    uint32_t event_queue_depth;      /**< Events waiting when the last block started */
+    uint32_t event_queue_peak;       /**< Largest depth seen */
+    float dsp_load;                  /**< Last block (1.0 = deadline) */
+    float dsp_peak_load;             /**< Highest single-block load seen */
+    uint64_t busy_ns;                /**< Total time spent rendering */
+    uint64_t period_ns;              /**< Total audio time rendered (busy_ns / period_ns = mean load) */
+    uint64_t load_histogram[MS_MONITOR_LOAD_BINS];  /**< Blocks per load bin */
+    uint64_t voices_stolen;
+    uint64_t stream_underruns;
+    uint64_t preload_bytes;          /**< RAM held by streaming preloads */
+    uint64_t resident_bytes;         /**< Managed sample memory in RAM */
+} ms_monitor_snapshot_t;
+
+/**
+ * @brief Enable real-time mode with thread priority and memory locking
+ *
+ * @param sampler Sampler instance
+ * @param priority SCHED_FIFO priority (1-99)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_enable_rt(ms_sampler_t *sampler, int priority);
+
+/**
+ * @brief Get RT performance statistics
+ *
+ * @param sampler Sampler instance
+ * @param frames Output for total frames processed (optional)
+ * @param xruns Output for buffer underrun count (optional)
+ */
+void ms_get_stats(const ms_sampler_t *sampler, uint64_t *frames, uint32_t *xruns);
+
+/**
+ * @brief Get a full engine statistics snapshot
+ *
+ * @param sampler Sampler instance
+ * @param stats Output statistics
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_get_stats(const ms_sampler_t *sampler, ms_stats_t *stats);
+
+/**
+ * @brief Publish live statistics in a shared memory segment
+ *
+ * Creates the POSIX shared memory object name (e.g. "/midi_sampler") and
+ * has the audio thread write a snapshot into it at the end of every
+ * block, under a sequence lock, without any system call. Other processes
+ * read it with ms_monitor_open(), as the ms_monitor tool does. Calling
+ * it again moves the statistics to another name; NULL stops publishing
+ * and removes the object.
+ *
+ * @param sampler Sampler instance
+ * @param name Shared memory object name, or NULL to stop
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_publish_stats(ms_sampler_t *sampler, const char *name);
+
+/**
+ * @brief Attach to statistics published by ms_sampler_publish_stats()
+ *
+ * @param name Shared memory object name
+ * @param monitor Output handle
+ * @return MS_SUCCESS on success, MS_ERROR_FILE_NOT_FOUND if nothing is
+ *         published under that name, error code otherwise
+ */
+ms_error_t ms_monitor_open(const char *name, ms_monitor_t **monitor);
+
+/**
+ * @brief Take a consistent snapshot of published statistics
+ *
+ * Never blocks the publisher; retries while a block is being written.
+ * Gives up if the segment stays mid-write, as it does when the publisher
+ * died while writing; the snapshot is then not valid.
+ *
+ * @param monitor Monitor handle
+ * @param snapshot Output statistics
+ * @return MS_SUCCESS on success, MS_ERROR_UNKNOWN if no consistent copy
+ *         could be taken, error code otherwise
+ */
+ms_error_t ms_monitor_read(const ms_monitor_t *monitor, ms_monitor_snapshot_t *snapshot);
+
+/**
+ * @brief Detach from published statistics
+ *
+ * @param monitor Monitor handle
+ */
+void ms_monitor_close(ms_monitor_t *monitor);
+
+/**
+ * @brief Start the disk streamer and allocate per-voice streaming buffers
+ *
+ * Must be called from the control thread before any streamed sample is
+ * loaded and before audio processing starts.
+ *
+ * Defaults (config == NULL): 100 ms preload, 32768-frame rings, automatic
+ * backend selection, O_DIRECT reads and a 500 ms sequencer lookahead.
+ *
+ * @param sampler Sampler instance
+ * @param config Streaming configuration (NULL for defaults)
+ * @return MS_SUCCESS on success, MS_ERROR_NOT_INITIALIZED if io_uring was
+ *         requested explicitly but is unavailable, error code otherwise
+ */
+ms_error_t ms_sampler_enable_streaming(
+    ms_sampler_t *sampler,
+    const ms_stream_config_t *config
+);
+
+/**
+ * @brief Load a WAV sample for disk streaming
+ *
+ * Only the zone preload (sized from the streaming latency plus the start
+ * offset reserve) is read into pinned memory. Looped samples and samples
+ * shorter than the preload are kept fully resident.
+ *
+ * @param instrument Target instrument
+ * @param filepath Path to WAV file (kept open while the instrument lives)
+ * @param metadata Sample metadata
+ * @return MS_SUCCESS on success, MS_ERROR_NOT_INITIALIZED if streaming is
+ *         not enabled, error code otherwise
+ */
+ms_error_t ms_instrument_load_sample_streamed(
+    ms_instrument_t *instrument,
+    const char *filepath,
+    const ms_sample_metadata_t *metadata
+);
+
+/**
+ * @brief Drain voice lifecycle notifications
+ *
+ * The audio thread reports every voice start, steal and finish through a
+ * lock-free queue (1024 entries); poll it regularly from one control
+ * thread. Notifications that do not fit are dropped and counted.
+ *
+ * @param sampler Sampler instance
+ * @param events Output array
+ * @param max_events Capacity of events
+ * @return Number of notifications written
+ */
+size_t ms_poll_voice_events(
+    ms_sampler_t *sampler,
+    ms_voice_event_t *events,
+    size_t max_events
+);
+
+/* ============================================================================
+ * Voice Handle Commands
+ * ========================================================================== */
+
+/*
+ * These address a single note through the handle ms_note_on() returned.
+ * Handles carry a generation, so a command for a voice that has since
+ * finished or been stolen is ignored (and counted as stale) instead of
+ * reaching whatever note reused the voice. Call from the same thread as
+ * ms_note_on(); the commands are applied at the start of the next block.
+ */
+
+/**
+ * @brief Start the release stage of one voice
+ *
+ * @param sampler Sampler instance
+ * @param voice_id Handle from ms_note_on()
+ * @return MS_SUCCESS, or MS_ERROR_BUFFER_OVERFLOW if the event queue is full
+ */
+ms_error_t ms_voice_release(ms_sampler_t *sampler, uint32_t voice_id);
+
+/**
+ * @brief Silence one voice immediately, skipping its release
+ */
+ms_error_t ms_voice_kill(ms_sampler_t *sampler, uint32_t voice_id);
+
+/**
+ * @brief Transpose one voice, on top of pitch bend
+ *
+ * @param semitones Offset from the note's own pitch (fractional allowed)
+ */
+ms_error_t ms_voice_set_pitch(ms_sampler_t *sampler, uint32_t voice_id, float semitones);
+
+/**
+ * @brief Set the linear gain of one voice (1.0 = unchanged)
+ */
+ms_error_t ms_voice_set_gain(ms_sampler_t *sampler, uint32_t voice_id, float gain);
+
+/**
+ * @brief Set the stereo balance of one voice
+ *
+ * @param pan -1.0 (left) to +1.0 (right); centre leaves both channels at
+ *            the voice gain
+ */
+ms_error_t ms_voice_set_pan(ms_sampler_t *sampler, uint32_t voice_id, float pan);
+
+/**
+ * @brief Set an instrument's voice limit, reservation and priority
+ *
+ * Takes effect in order with queued notes. Defaults are no limit, no
+ * reservation and priority 0, which shares voices evenly: when they run
+ * out, the instrument with the most voices loses its oldest one.
+ *
+ * @param instrument Target instrument
+ * @param budget Limits (max_voices and reserved_voices up to 64)
+ * @return MS_SUCCESS on success, MS_ERROR_BUFFER_OVERFLOW if the event
+ *         queue is full, error code otherwise
+ */
+ms_error_t ms_instrument_set_voice_budget(
+    ms_instrument_t *instrument,
+    const ms_voice_budget_t *budget
+);
+
+/**
+ * @brief Switch an instrument between poly, mono and legato playing
+ *
+ * Mono and legato instruments sound one note at a time, the most recent
+ * key held; releasing it returns to the previous key still held. Legato
+ * moves to overlapping notes on the same voice without restarting the
+ * sample or envelope. Portamento glides the pitch to every new note in
+ * either mode. Takes effect in order with queued notes.
+ *
+ * @param instrument Target instrument
+ * @param mode Voice mode
+ * @param portamento_ms Time to cover 99% of a pitch change (0 = no glide)
+ * @return MS_SUCCESS on success, MS_ERROR_BUFFER_OVERFLOW if the event
+ *         queue is full, error code otherwise
+ */
+ms_error_t ms_instrument_set_voice_mode(
+    ms_instrument_t *instrument,
+    ms_voice_mode_t mode,
+    float portamento_ms
+);
+
+/**
+ * @brief Fill a tuning with 12-tone equal temperament
+ *
+ * @param tuning Output tuning
+ * @param a4_hz Frequency of A4 (0 = 440 Hz)
+ */
+void ms_tuning_equal(ms_tuning_t *tuning, double a4_hz);
+
+/**
+ * @brief Load a Scala scale and optional keyboard mapping
+ *
+ * Without a .kbm file the scale is mapped linearly with degree 0 on
+ * middle C (note 60) and A4 (note 69) at 440 Hz, as Scala does.
+ *
+ * @param tuning Output tuning
+ * @param scl_path Scale file (.scl)
+ * @param kbm_path Keyboard mapping file (.kbm, optional, can be NULL)
+ * @return MS_SUCCESS on success, MS_ERROR_FILE_NOT_FOUND or
+ *         MS_ERROR_INVALID_FORMAT otherwise
+ */
+ms_error_t ms_tuning_load_scala(ms_tuning_t *tuning, const char *scl_path, const char *kbm_path);
+
+/**
+ * @brief Set an instrument's tuning
+ *
+ * The tuning is resolved into the table note-ons read while the audio
+ * thread keeps running; notes already sounding keep their pitch. Call
+ * from the control thread.
+ *
+ * @param instrument Target instrument
+ * @param tuning Note frequencies (NULL = 12-TET, A4 = 440 Hz)
+ * @param master_tune_cents Offset applied to every note
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_instrument_set_tuning(
+    ms_instrument_t *instrument,
+    const ms_tuning_t *tuning,
+    double master_tune_cents
+);
+
+/**
+ * @brief Pre-render an instrument's most played notes
+ *
+ * Renders the resampled zone of each chosen note (every velocity layer)
+ * with high-quality interpolation on a pool of threads. Voices without
+ * per-voice modulation then play the rendered copy at unity speed, which
+ * needs far less CPU than live resampling. A voice that gets pitch
+ * modulation later switches back to live resampling seamlessly. Looped
+ * and streamed zones are not cached. Rebuild after changing the tuning.
+ *
+ * Replaces any previous cache; the call returns once no voice uses the
+ * old one. That needs the engine to be rendering: if ms_process() makes
+ * no progress for about 100 ms, the old cache is kept aside instead and
+ * freed by a later build or clear, or by ms_instrument_destroy(). Call
+ * from a control or background thread.
+ *
+ * @param instrument Target instrument
+ * @param note_weights How often each of the 128 notes is expected (from
+ *                     ms_sequence_note_counts(), say), or NULL to use the
+ *                     note-ons the instrument has played so far
+ * @param config Limits (NULL for defaults)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_instrument_build_note_cache(
+    ms_instrument_t *instrument,
+    const uint32_t *note_weights,
+    const ms_note_cache_config_t *config
+);
+
+/**
+ * @brief Drop an instrument's pre-rendered notes
+ *
+ * Waits for voices on the cache like ms_instrument_build_note_cache().
+ *
+ * @param instrument Target instrument
+ */
+void ms_instrument_clear_note_cache(ms_instrument_t *instrument);
+
+/**
+ * @brief Set the processing applied by ms_instrument_load_sample()
+ *
+ * Affects later loads only. Streamed samples are played as stored.
+ *
+ * @param sampler Sampler instance
+ * @param config Stages to run (NULL turns all of them off)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_set_preprocess(ms_sampler_t *sampler, const ms_preprocess_config_t *config);
+
+/**
+ * @brief Keep preprocessed samples on disk between runs
+ *
+ * ms_instrument_load_sample() and ms_instrument_load_samples() then map a
+ * file's converted, engine-rate data from the cache directory instead of
+ * decoding and preprocessing it again. Entries are keyed by the file's
+ * content and everything that affects the result (sample rate,
+ * preprocessing, loop points); a file is only re-read when its size or
+ * mtime changed. Several samplers and processes may share a directory.
+ *
+ * @param sampler Sampler instance
+ * @param config Cache settings (NULL turns the cache off)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_set_sample_cache(ms_sampler_t *sampler,
+                                       const ms_sample_cache_config_t *config);
+
+/**
+ * @brief Keep sample memory under a ceiling
+ *
+ * Zones loaded from files after this call are managed: their first
+ * head_ms stay in RAM, and the rest of the least recently played zones
+ * no voice is playing is freed when the managed total exceeds max_bytes.
+ * Playing an evicted zone starts from the head at once while a
+ * background thread reloads the rest; the voice stops if it reaches the
+ * end of the head first. The audio thread never waits for a reload. Set
+ * a sample cache to make reloads cheap. Zones loaded from memory or
+ * streamed are not managed.
+ *
+ * Later calls only change max_bytes.
+ *
+ * @param sampler Sampler instance
+ * @param budget Budget settings
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_set_memory_budget(ms_sampler_t *sampler, const ms_memory_budget_t *budget);
+
+/**
+ * @brief Put the sample data of instruments in a sealed shared memory pool
+ *
+ * Copies every resident zone of the instruments into a memfd, then seals
+ * it so nobody can write or resize it. Pass the descriptor to other
+ * processes (over a Unix socket with SCM_RIGHTS, or as /proc/<pid>/fd/<n>)
+ * and attach it there with ms_instrument_attach_shared(): all of them play
+ * from one copy of the PCM. Streamed zones, and zones the memory budget
+ * has evicted, are left out. The pool is independent of the instruments
+ * once created.
+ *
+ * @param instruments Instruments to export; their index in the pool is their position here
+ * @param count Number of instruments
+ * @param fd Output descriptor, owned by the caller
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_shared_pool_create(ms_instrument_t *const *instruments, size_t count, int *fd);
+
+/**
+ * @brief Add the zones of one pool instrument to an instrument
+ *
+ * Maps the pool read-only and points the new zones into it; no sample
+ * data is copied. The mapping lives until the last attached zone is
+ * destroyed, so the descriptor may be closed right after this call.
+ * Pools that are not sealed against writes are refused.
+ *
+ * @param instrument Target instrument
+ * @param fd Descriptor from ms_shared_pool_create(), possibly in another process
+ * @param index Instrument index within the pool
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_instrument_attach_shared(ms_instrument_t *instrument, int fd, uint32_t index);
+
+/**
+ * @brief Load several WAV samples in parallel
+ *
+ * Decodes and preprocesses the files on a pool of threads, then adds them
+ * to the instrument in the given order. Either every file is added or, on
+ * the first error, none is.
+ *
+ * @param instrument Target instrument
+ * @param filepaths Paths to WAV files
+ * @param metadata Metadata for each file
+ * @param count Number of files
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_instrument_load_samples(
+    ms_instrument_t *instrument,
+    const char *const *filepaths,
+    const ms_sample_metadata_t *metadata,
+    size_t count
+);
+
+/**
+ * @brief Get cumulative preprocessing timings
+ *
+ * @param sampler Sampler instance
+ * @param stats Output statistics
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_get_preprocess_stats(const ms_sampler_t *sampler,
+                                           ms_preprocess_stats_t *stats);
+
+/**
+ * @brief Create a voice budget that several samplers can share
+ *
+ * A sampler attached to a pool only starts a voice on a free slot while
+ * the pool has room, otherwise it steals one of its own voices. Samplers
+ * may run on different audio threads.
+ *
+ * @param max_voices Voices allowed to sound across all attached samplers
+ * @param pool Output pool handle
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_voice_pool_create(uint32_t max_voices, ms_voice_pool_t **pool);
+
+/**
+ * @brief Destroy a voice pool after all samplers using it are destroyed
+ */
+void ms_voice_pool_destroy(ms_voice_pool_t *pool);
+
+/**
+ * @brief Attach a sampler to a shared voice pool (NULL to detach)
+ *
+ * Safe while audio is processing. New voices take their slot from the new
+ * pool; voices already sounding return theirs to the pool they took it
+ * from, so a pool must outlive every sampler that has used it.
+ *
+ * @param sampler Sampler instance
+ * @param pool Shared pool
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_set_voice_pool(ms_sampler_t *sampler, ms_voice_pool_t *pool);
+
+/**
+ * @brief Enable, reconfigure or disable the overload governor
+ *
+ * The governor times every ms_process() call. While the smoothed load is
+ * above high_load it steps through the ms_governor_level_t stages, one per
+ * block; once the load has stayed below low_load for hold_ms it undoes
+ * one stage at a time. Call from the control thread.
+ *
+ * Defaults: 0.8 / 0.5 load, 500 ms hold, -40 / -60 dBFS thresholds and a
+ * cap of half of max_polyphony.
+ *
+ * @param sampler Sampler instance
+ * @param config Configuration (NULL for defaults)
+ * @param enable false to switch the governor off and restore full quality
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_set_governor(
+    ms_sampler_t *sampler,
+    const ms_governor_config_t *config,
+    bool enable
+);
+
+/**
+ * @brief Start a library-owned render thread
+ *
+ * The thread calls ms_process() ahead of the consumer and writes into a
+ * lock-free ring that ms_render_read() drains, for hosts without an audio
+ * callback (network streamers, file writers). While it runs, the host
+ * must not call ms_process() itself.
+ *
+ * Defaults (config == NULL): 8192-frame ring, buffer_size blocks and the
+ * priority set by ms_sampler_enable_rt() (MS_RT_PRIORITY if not called).
+ *
+ * @param sampler Sampler instance
+ * @param config Render configuration (NULL for defaults)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sampler_start_render(
+    ms_sampler_t *sampler,
+    const ms_render_config_t *config
+);
+
+/**
+ * @brief Stop the render thread started by ms_sampler_start_render()
+ *
+ * @param sampler Sampler instance
+ */
+void ms_sampler_stop_render(ms_sampler_t *sampler);
+
+/**
+ * @brief Read rendered audio without blocking or locking
+ *
+ * If fewer frames are available than requested, the rest of output is
+ * filled with silence and counted as an xrun. Single reader only.
+ *
+ * @param sampler Sampler instance
+ * @param output Interleaved output buffer (num_frames * channels)
+ * @param num_frames Number of frames wanted
+ * @return Number of rendered frames copied
+ */
+size_t ms_render_read(ms_sampler_t *sampler, float *output, size_t num_frames);
+
+/**
+ * @brief Number of rendered frames ready to read
+ *
+ * @param sampler Sampler instance
+ * @return Frames buffered in the output ring
+ */
+size_t ms_render_available(const ms_sampler_t *sampler);
+
+/**
+ * @brief Load a MIDI file as an independent sequence
+ *
+ * Any number of sequences (up to 64 per sampler) can play at the same
+ * time, each with its own position, tempo map and channel mapping. All
+ * tracks of the file are merged. The sequence is created stopped and with
+ * no channel mapped; it must be destroyed before the sampler.
+ *
+ * @param sampler Sampler instance
+ * @param filepath Path to MIDI file
+ * @param sequence Output sequence handle
+ * @return MS_SUCCESS on success, MS_ERROR_VOICE_LIMIT if all sequence
+ *         slots are taken, error code otherwise
+ */
+ms_error_t ms_sequence_load(
+    ms_sampler_t *sampler,
+    const char *filepath,
+    ms_sequence_t **sequence
+);
+
+/**
+ * @brief Route a MIDI channel of a sequence to an instrument
+ *
+ * Events on unmapped channels are ignored. Can be changed while playing;
+ * notes already sounding get their note-off on the instrument that
+ * played them.
+ *
+ * @param sequence Sequence handle
+ * @param channel MIDI channel (0-15), or -1 for all channels
+ * @param instrument Target instrument, NULL to mute the channel
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sequence_set_instrument(
+    ms_sequence_t *sequence,
+    int channel,
+    ms_instrument_t *instrument
+);
+
+/**
+ * @brief Start (or restart) a sequence from a given position
+ *
+ * Restarting a playing sequence first releases the notes it has sounding.
+ *
+ * @param sequence Sequence handle
+ * @param start_frame Position within the sequence in frames (0 = beginning)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sequence_start(ms_sequence_t *sequence, uint64_t start_frame);
+
+/**
+ * @brief Stop a sequence; sounding notes keep their release
+ *
+ * Notes the sequence left on are released at the start of the next block.
+ *
+ * @param sequence Sequence handle
+ */
+void ms_sequence_stop(ms_sequence_t *sequence);
+
+/**
+ * @brief Check if a sequence is playing
+ *
+ * @param sequence Sequence handle
+ * @return true until the last event has been dispatched or it was stopped
+ */
+bool ms_sequence_is_playing(const ms_sequence_t *sequence);
+
+/**
+ * @brief Get the frame offset of the last event of a sequence
+ *
+ * @param sequence Sequence handle
+ * @return Sequence length in frames
+ */
+uint64_t ms_sequence_length(const ms_sequence_t *sequence);
+
+/**
+ * @brief Count the note-ons a sequence plays on an instrument
+ *
+ * Follows the sequence's current channel mapping. The counts suit
+ * ms_instrument_build_note_cache().
+ *
+ * @param sequence Sequence handle
+ * @param instrument Instrument to count for
+ * @param counts Output, note-ons per MIDI note (128 entries)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_sequence_note_counts(
+    const ms_sequence_t *sequence,
+    const ms_instrument_t *instrument,
+    uint32_t *counts
+);
+
+/**
+ * @brief Stop and free a sequence
+ *
+ * Its sounding notes are released at the start of the next block.
+ *
+ * @param sequence Sequence handle
+ */
+void ms_sequence_destroy(ms_sequence_t *sequence);
+
+/**
+ * @brief Incremental parser state for a live MIDI byte stream
+ *
+ * Embed or declare one per input port and set it up with
+ * ms_midi_input_init(); the parser itself never allocates. Fields are
+ * private except the counters.
+ */
+typedef struct {
+    ms_sampler_t *sampler;
+    ms_instrument_t *channels[16];  /**< Channel routing, NULL = ignored */
+    uint8_t status;                 /**< Running status, 0 if none */
+    uint8_t data[2];
+    uint8_t count;                  /**< Data bytes collected for status */
+    uint8_t needed;                 /**< Data bytes status takes */
+    bool in_sysex;
+    uint8_t mpe_members;            /**< MPE lower-zone member channels, 0 = MPE off */
+    float mpe_bend_range;           /**< Member channel pitch bend range in semitones */
+    uint64_t events;                /**< Events pushed to the sampler */
+    uint64_t dropped;               /**< Events lost to a full event queue or stamped too far ahead */
+} ms_midi_input_t;
+
+/**
+ * @brief Reset a MIDI input parser and bind it to a sampler
+ *
+ * @param input Parser state
+ * @param sampler Target sampler
+ */
+void ms_midi_input_init(ms_midi_input_t *input, ms_sampler_t *sampler);
+
+/**
+ * @brief Route a MIDI channel of an input to an instrument
+ *
+ * @param input Parser state
+ * @param channel MIDI channel (0-15), or -1 for all channels
+ * @param instrument Target instrument, NULL to ignore the channel
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_midi_input_set_instrument(
+    ms_midi_input_t *input,
+    int channel,
+    ms_instrument_t *instrument
+);
+
+/**
+ * @brief Enable MIDI Polyphonic Expression (lower zone) on an input
+ *
+ * Channel 0 stays the master channel. Channels 1..member_channels each
+ * carry one note at a time, and their pitch bend, channel pressure and
+ * CC74 shape only that note: pitch glides by up to bend_range semitones,
+ * pressure raises the level by up to 6 dB and CC74 opens a low-pass
+ * filter (127 = fully open). Changes are smoothed per block. Expression
+ * state is kept per sampler, so feed one MPE input per sampler.
+ *
+ * @param input Parser state
+ * @param member_channels Number of member channels (1-15), 0 to disable
+ * @param bend_range Member pitch bend range in semitones (0 = 48, the MPE default)
+ * @return MS_SUCCESS on success, error code otherwise
+ */
+ms_error_t ms_midi_input_set_mpe(
+    ms_midi_input_t *input,
+    uint8_t member_channels,
+    float bend_range
+);
+
+/**
+ * @brief Parse raw MIDI bytes and queue the resulting events
+ *
+ * Accepts arbitrary chunking (messages may be split across calls),
+ * running status, real-time bytes interleaved anywhere and SysEx, which
+ * is skipped. Note on/off and pitch bend are queued for the audio thread
+ * without locking. Call from the same thread as ms_note_on(), or instead
+ * of it: the event queue has a single producer.
+ *
+ * Stamped events wait on the audio thread until their block without
+ * holding back unstamped events sent after them. Events stamped more than
+ * 10 seconds past the current frame are dropped.
+ *
+ * @param input Parser state
+ * @param bytes Raw MIDI bytes
+ * @param length Number of bytes
+ * @param frame Engine frame the events are due at, on the same clock as
+ *              ms_get_stats().frames_processed; 0 applies them at the
+ *              next block
+ * @return Number of events queued by this call
+ */
+size_t ms_midi_input_feed(
+    ms_midi_input_t *input,
+    const uint8_t *bytes,
+    size_t length,
+    uint64_t frame
+);
+
 /* ============================================================================
  * Utility Functions
  * ========================================================================== */
@@ -3,7 +3,11 @@
  * @brief WAV file loading and sample management
  */
 
+#ifdef ENABLE_RT_OPTIMIZATIONS
+#include "internal/internal_rt.h"
+#else
 #include "internal/internal.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -91,6 +95,49 @@ static ms_error_t read_wav_header(FILE *fp, uint32_t *sample_rate,
     return MS_ERROR_INVALID_FORMAT;
 }
 
+ms_error_t wav_probe_file(const char *filepath, wav_info_t *info) {
+    if (!filepath || !info) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+    
+    uint32_t data_size;
+    ms_error_t err = read_wav_header(fp, &info->sample_rate, &info->channels,
+                                     &info->bits_per_sample, &data_size);
+    if (err == MS_SUCCESS) {
+        long offset = ftell(fp);
+        if (offset < 0 || info->channels == 0 ||
+            (info->bits_per_sample != 8 && info->bits_per_sample != 16)) {
+            err = MS_ERROR_INVALID_FORMAT;
+        } else {
+            info->data_offset = (uint64_t)offset;
+            info->num_frames = data_size / (info->channels * (info->bits_per_sample / 8));
+        }
+    }
+    
+    fclose(fp);
+    return err;
+}
+
+void wav_pcm_to_float(const void *src, uint16_t bits_per_sample,
+                      float *dst, size_t count) {
+    if (bits_per_sample == 16) {
+        const int16_t *in = (const int16_t*)src;
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = in[i] / 32768.0f;
+        }
+    } else {
+        const uint8_t *in = (const uint8_t*)src;
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = (in[i] - 128) / 128.0f;
+        }
+    }
+}
+
 ms_error_t load_wav_file(const char *filepath, ms_sample_data_t *sample) {
     if (!filepath || !sample) {
         return MS_ERROR_INVALID_PARAM;
@@ -29,6 +29,22 @@ typedef struct {
     ms_sample_metadata_t meta;  /**< Sample metadata */
 } ms_sample_data_t;
 
+/* ============================================================================
+ * WAV Probing (sample_loader.c)
+ * ========================================================================== */
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits_per_sample;
+    uint64_t data_offset;       /**< Byte offset of the PCM data chunk */
+    size_t num_frames;          /**< Number of audio frames in the data chunk */
+} wav_info_t;
+
+ms_error_t wav_probe_file(const char *filepath, wav_info_t *info);
+void wav_pcm_to_float(const void *src, uint16_t bits_per_sample,
+                      float *dst, size_t count);
+
 /* ============================================================================
  * Envelope Generator
  * ========================================================================== */
@@ -120,16 +136,30 @@ typedef struct {
 } midi_event_t;
 
 typedef struct {
-    midi_event_t *events;
+    uint32_t tick;
+    uint32_t tempo;                 /**< Microseconds per quarter note */
+} midi_tempo_t;
+
+typedef struct {
+    midi_event_t *events;           /**< All tracks merged, sorted by tick */
     size_t num_events;
     size_t capacity;
     uint32_t ticks_per_beat;
-    uint32_t tempo;
+    uint32_t tempo;                 /**< Initial tempo */
+    midi_tempo_t *tempo_map;        /**< Tempo changes sorted by tick */
+    size_t num_tempos;
 } midi_track_t;
 
 ms_error_t midi_parse_file(const char *filepath, midi_track_t *track);
 void midi_track_destroy(midi_track_t *track);
 
+/**
+ * @brief Convert event ticks to frame offsets through the tempo map
+ *
+ * @param frames Output, one entry per event
+ */
+void midi_track_tick_frames(const midi_track_t *track, double sample_rate, uint64_t *frames);
+
 /* ============================================================================
  * Sampler
  * ========================================================================== */
@@ -15,10 +15,14 @@
 #define MIDI_SAMPLER_INTERNAL_RT_H
 
 #include "midi_sampler.h"
+#include <math.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <sched.h>
 #include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 
 /* ============================================================================
  * Real-time Configuration
@@ -40,18 +44,90 @@
 /* Force inline for hot paths */
 #define FORCE_INLINE __attribute__((always_inline)) inline
 
+/* ============================================================================
+ * Static Tracepoints (USDT)
+ * ========================================================================== */
+
+/*
+ * Probes of provider "midi_sampler" for bpftrace, perf and SystemTap; the
+ * names and arguments are listed in docs/RT_GUIDE.md ("Tracing"). With
+ * <sys/sdt.h> installed each one is a single NOP plus an ELF note that
+ * costs nothing until a tracer attaches; without it, or with
+ * -DENABLE_USDT=OFF, they compile away and their arguments are not
+ * evaluated.
+ */
+#if !defined(MS_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define MS_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef MS_HAVE_USDT
+#define MS_TRACE2(name, a, b) DTRACE_PROBE2(midi_sampler, name, a, b)
+#define MS_TRACE3(name, a, b, c) DTRACE_PROBE3(midi_sampler, name, a, b, c)
+#define MS_TRACE4(name, a, b, c, d) DTRACE_PROBE4(midi_sampler, name, a, b, c, d)
+#define MS_TRACE5(name, a, b, c, d, e) DTRACE_PROBE5(midi_sampler, name, a, b, c, d, e)
+#else
+#define MS_TRACE2(name, a, b) ((void)0)
+#define MS_TRACE3(name, a, b, c) ((void)0)
+#define MS_TRACE4(name, a, b, c, d) ((void)0)
+#define MS_TRACE5(name, a, b, c, d, e) ((void)0)
+#endif
+
+/* ============================================================================
+ * Shared Helpers
+ * ========================================================================== */
+
+/** @brief CLOCK_MONOTONIC in nanoseconds */
+static FORCE_INLINE uint64_t ms_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** @brief Decibels to linear gain */
+static FORCE_INLINE float db_to_linear(float db) {
+    return powf(10.0f, db / 20.0f);
+}
+
 /* ============================================================================
  * Lock-free Ring Buffer for RT Event Passing
  * ========================================================================== */
 
 #define RT_EVENT_QUEUE_SIZE 256
 
+#define RT_EVENT_NOTE_ON 0
+#define RT_EVENT_NOTE_OFF 1
+#define RT_EVENT_PITCH_BEND 2  /* note = LSB, velocity = MSB (7 bits each) */
+#define RT_EVENT_VOICE_RELEASE 3
+#define RT_EVENT_VOICE_KILL 4
+#define RT_EVENT_VOICE_PITCH 5  /* value = semitones */
+#define RT_EVENT_VOICE_GAIN 6   /* value = linear gain */
+#define RT_EVENT_VOICE_PAN 7    /* value = -1 (left) .. +1 (right) */
+#define RT_EVENT_VOICE_BUDGET 8 /* note = max, velocity = reserved, voice_id = priority */
+#define RT_EVENT_ALL_NOTES_OFF 9
+#define RT_EVENT_NOTE_PITCH 10   /* MPE, value = semitones */
+#define RT_EVENT_NOTE_PRESSURE 11 /* MPE, value = 0..1 */
+#define RT_EVENT_NOTE_TIMBRE 12  /* MPE, value = 0..1 */
+#define RT_EVENT_VOICE_MODE 13   /* note = ms_voice_mode_t, value = portamento ms */
+#define RT_EVENT_CACHE_DROP 14   /* Move voices off a retired note cache (drop_queue) */
+#define RT_EVENT_INSTRUMENT_DROP 15  /* End the instrument's voices before it is freed (drop_queue) */
+#define RT_EVENT_NONE 0xFF       /* Empty coalescing slot */
+
+#define RT_COALESCE_SLOTS 64     /* Controller table (power of two) */
+#define RT_COALESCE_PENDING 32   /* Flush when half full */
+#define RT_SCHEDULE_SLOTS 256    /* Events held for a later block */
+
 typedef struct {
     uint8_t note;
     uint8_t velocity;
-    uint8_t event_type;  /* 0=note_on, 1=note_off */
-    uint8_t padding;
+    uint8_t event_type;  /* RT_EVENT_* */
+    uint8_t channel;     /* MPE member channel + 1, 0 = not per-note */
+    uint32_t timestamp;  /* Engine frame (low 32 bits) the event is due at */
     void *instrument;
+    uint32_t voice_id;   /* Handle for note-on and voice commands, else 0 */
+    float value;         /* Voice command argument */
 } rt_event_t;
 
 typedef struct {
@@ -89,17 +165,369 @@ static FORCE_INLINE bool rt_queue_pop(rt_event_queue_t *q, rt_event_t *event) {
     return true;
 }
 
+/* Consumer side: look at the oldest event without removing it */
+static FORCE_INLINE const rt_event_t *rt_queue_peek(rt_event_queue_t *q) {
+    uint32_t read_idx = atomic_load_explicit(&q->read_idx, memory_order_relaxed);
+    uint32_t write_idx = atomic_load_explicit(&q->write_idx, memory_order_acquire);
+    
+    if (UNLIKELY(read_idx == write_idx)) {
+        return NULL;
+    }
+    
+    return &q->events[read_idx];
+}
+
+static FORCE_INLINE void rt_queue_advance(rt_event_queue_t *q) {
+    uint32_t read_idx = atomic_load_explicit(&q->read_idx, memory_order_relaxed);
+    atomic_store_explicit(&q->read_idx, (read_idx + 1) % RT_EVENT_QUEUE_SIZE,
+                         memory_order_release);
+}
+
+/* ============================================================================
+ * Lock-free Return Queue (audio thread -> control thread)
+ * ========================================================================== */
+
+#define RT_NOTIFY_QUEUE_SIZE 1024
+
+typedef struct {
+    CACHE_ALIGNED atomic_uint_fast32_t write_idx;
+    CACHE_ALIGNED atomic_uint_fast32_t read_idx;
+    CACHE_ALIGNED ms_voice_event_t events[RT_NOTIFY_QUEUE_SIZE];
+} rt_notify_queue_t;
+
+static FORCE_INLINE bool rt_notify_push(rt_notify_queue_t *q, const ms_voice_event_t *event) {
+    uint32_t write_idx = atomic_load_explicit(&q->write_idx, memory_order_relaxed);
+    uint32_t next_write = (write_idx + 1) % RT_NOTIFY_QUEUE_SIZE;
+    uint32_t read_idx = atomic_load_explicit(&q->read_idx, memory_order_acquire);
+    
+    if (UNLIKELY(next_write == read_idx)) {
+        return false;  /* Queue full */
+    }
+    
+    q->events[write_idx] = *event;
+    atomic_store_explicit(&q->write_idx, next_write, memory_order_release);
+    return true;
+}
+
+static FORCE_INLINE bool rt_notify_pop(rt_notify_queue_t *q, ms_voice_event_t *event) {
+    uint32_t read_idx = atomic_load_explicit(&q->read_idx, memory_order_relaxed);
+    uint32_t write_idx = atomic_load_explicit(&q->write_idx, memory_order_acquire);
+    
+    if (UNLIKELY(read_idx == write_idx)) {
+        return false;  /* Queue empty */
+    }
+    
+    *event = q->events[read_idx];
+    atomic_store_explicit(&q->read_idx, (read_idx + 1) % RT_NOTIFY_QUEUE_SIZE,
+                         memory_order_release);
+    return true;
+}
+
+/* ============================================================================
+ * Pinned Memory (memory_rt.c)
+ * ========================================================================== */
+
+#define MS_HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+
+/**
+ * Page-locked anonymous mapping. Large blocks are backed by explicit huge
+ * pages when the system has them reserved, otherwise by transparent huge
+ * pages where the kernel allows it.
+ */
+typedef struct {
+    void *ptr;
+    size_t size;                    /**< Requested size in bytes */
+    size_t length;                  /**< Mapped length in bytes */
+    bool hugetlb;                   /**< Backed by explicit huge pages */
+    bool locked;                    /**< mlock() succeeded */
+} rt_pinned_block_t;
+
+ms_error_t rt_pinned_alloc(rt_pinned_block_t *block, size_t size);
+void rt_pinned_free(rt_pinned_block_t *block);
+ms_error_t rt_file_map(rt_pinned_block_t *block, int fd, size_t size);
+
+/* ============================================================================
+ * WAV Probing (sample_loader.c)
+ * ========================================================================== */
+
+typedef struct {
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits_per_sample;
+    uint64_t data_offset;           /**< Byte offset of the PCM data chunk */
+    size_t num_frames;              /**< Number of audio frames in the data chunk */
+} wav_info_t;
+
+ms_error_t wav_probe_file(const char *filepath, wav_info_t *info);
+void wav_pcm_to_float(const void *src, uint16_t bits_per_sample,
+                      float *dst, size_t count);
+
 /* ============================================================================
  * Sample Structure (Cache-aligned)
  * ========================================================================== */
 
+/**
+ * Frames readable before frame 0 and past the last frame of a resident
+ * zone, enough for the widest interpolator's taps
+ */
+#define MS_SAMPLE_GUARD_FRAMES 4
+
 typedef struct {
-    float *data CACHE_ALIGNED;      /**< PCM data (cache-aligned) */
+    float *data CACHE_ALIGNED;      /**< PCM data (cache-aligned, guard-padded unless streamed) */
     size_t num_frames;              /**< Number of audio frames */
     uint16_t channels;              /**< Number of channels */
     ms_sample_metadata_t meta;      /**< Sample metadata */
+    
+    /* Disk streaming: data holds only the first preload_frames */
+    bool streamed;                  /**< Tail is read from disk by the streamer */
+    size_t preload_frames;          /**< Frames resident in data */
+    int stream_fd;                  /**< Open WAV file (streamed only) */
+    uint64_t stream_data_offset;    /**< Byte offset of frame 0 in the file */
+    uint16_t stream_bits;           /**< PCM bits per sample on disk */
+    int stream_io_fd;               /**< O_DIRECT descriptor, or stream_fd */
+    rt_pinned_block_t preload;      /**< Pinned backing of data (ptr NULL if heap) */
+    rt_pinned_block_t mapping;      /**< Sample cache file backing of data (ptr NULL if heap) */
+    struct zone_residency_t *residency;  /**< Memory budget record (NULL if not managed) */
+    struct shared_pool_t *shared;   /**< Shared pool data points into (NULL if private) */
 } ms_sample_data_t;
 
+/** @brief Bytes of a resident zone's PCM, guard frames included */
+static FORCE_INLINE size_t zone_bytes(const ms_sample_data_t *sample) {
+    return (sample->num_frames + 2 * MS_SAMPLE_GUARD_FRAMES) * sample->channels * sizeof(float);
+}
+
+void sample_guard_fill(ms_sample_data_t *sample);
+ms_error_t sample_layout(ms_sample_data_t *sample, const float *pcm, size_t num_frames);
+void sample_data_free(ms_sample_data_t *sample);
+void sinc_resample(const float *src, size_t src_frames, size_t src_stride, double step,
+                   float *dst, size_t dst_frames, size_t dst_stride);
+
+/* ============================================================================
+ * io_uring (uring_rt.c)
+ * ========================================================================== */
+
+typedef struct {
+    int fd;                         /**< Ring descriptor, -1 when not set up */
+    unsigned entries;
+    unsigned pending;               /**< SQEs queued but not yet submitted */
+    bool buffers_registered;
+    
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    void *sqes;
+    void *cqes;
+    
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} rt_uring_t;
+
+ms_error_t rt_uring_init(rt_uring_t *ring, unsigned entries);
+ms_error_t rt_uring_register_buffers(rt_uring_t *ring, const struct iovec *iov, unsigned count);
+bool rt_uring_queue_read(rt_uring_t *ring, int fd, void *buf, size_t length, off_t offset,
+                         int buf_index, uint64_t user_data);
+int rt_uring_submit_and_wait(rt_uring_t *ring, unsigned wait_nr);
+bool rt_uring_pop_completion(rt_uring_t *ring, uint64_t *user_data, int32_t *result);
+void rt_uring_destroy(rt_uring_t *ring);
+
+/* ============================================================================
+ * Disk Streaming (stream_rt.c)
+ * ========================================================================== */
+
+#define MS_STREAM_DEFAULT_PRELOAD_MS 100.0f
+#define MS_STREAM_DEFAULT_RING_FRAMES 32768
+#define MS_STREAM_MAX_CHANNELS 2
+#define MS_STREAM_DEFAULT_LOOKAHEAD_MS 500.0f
+#define MS_STREAM_IO_ALIGN 4096         /**< O_DIRECT offset/length/buffer alignment */
+#define MS_STREAM_MAX_PASSES 8          /**< Refill batches per streamer wake-up */
+
+/**
+ * Per-voice streaming state. The audio thread requests a zone by bumping
+ * request_gen; the streamer thread acknowledges with serviced_gen and then
+ * publishes tail frames through fill_frames. The voice only trusts the
+ * ring while serviced_gen matches the generation it requested.
+ */
+typedef struct CACHE_ALIGNED stream_voice {
+    /* Audio thread */
+    _Atomic(ms_sample_data_t *) request_sample;
+    atomic_uint_fast32_t request_gen;
+    atomic_size_t read_frames;      /**< Tail frames the voice no longer needs */
+    uint32_t gen;
+    bool underrun;                  /**< Already counted as outrunning the preload */
+    
+    /* Streamer thread */
+    CACHE_ALIGNED atomic_uint_fast32_t serviced_gen;
+    atomic_size_t fill_frames;      /**< Tail frames present in the ring */
+    ms_sample_data_t *source;
+    uint32_t source_gen;
+    size_t source_fill;
+    
+    float *ring;                    /**< ring_mask + 1 frames, interleaved */
+    size_t ring_mask;
+    uint8_t *staging;               /**< Registered raw PCM buffer for one refill */
+    
+    /* Counters (audio thread writes, control thread reads) */
+    CACHE_ALIGNED atomic_uint_fast64_t starts;
+    atomic_uint_fast64_t underruns;
+    atomic_uint_fast64_t underrun_frames;
+} stream_voice_t;
+
+/** One refill read, batched per streamer pass */
+typedef struct {
+    stream_voice_t *sv;
+    ms_sample_data_t *sample;
+    size_t frames;                  /**< Frames requested */
+    size_t skip;                    /**< Leading bytes read only for alignment */
+    size_t length;                  /**< Bytes submitted */
+    off_t offset;                   /**< File offset submitted */
+    int fd;
+    int buf_index;
+    ssize_t result;
+} stream_request_t;
+
+/**
+ * Tail head of a zone read ahead of its note-on by the sequencer
+ * lookahead. Slots are owned by the streamer thread.
+ */
+typedef struct {
+    ms_sample_data_t *sample;       /**< Cached zone, NULL if the slot is free */
+    uint64_t expires;               /**< Playback frame after which the slot may be reused */
+    size_t frames;                  /**< Tail frames cached */
+    float *data;
+} stream_prefetch_t;
+
+typedef struct {
+    stream_voice_t *voices;         /**< One per voice slot, NULL until enabled */
+    size_t num_voices;
+    ms_stream_config_t config;
+    size_t preload_frames;          /**< Preload size of streamed zones */
+    size_t chunk_frames;            /**< Largest single refill */
+    rt_pinned_block_t rings;
+    rt_pinned_block_t staging;      /**< Per-voice raw PCM buffers (IO-aligned) */
+    size_t staging_stride;
+    stream_request_t *requests;     /**< One slot per voice */
+    
+    /* Sequencer lookahead */
+    stream_prefetch_t *prefetch;    /**< One slot per voice */
+    rt_pinned_block_t prefetch_block;
+    size_t prefetch_frames;
+    uint8_t *prefetch_raw;          /**< Raw PCM buffer for one slot */
+    uint64_t lookahead_frames;
+    size_t lookahead_cursor;        /**< Next track event to scan */
+    uint32_t lookahead_epoch;
+    
+    pthread_mutex_t io_lock;        /**< Held by the streamer while it touches zones */
+
+    _Atomic(ms_stream_io_t) io;     /**< Resolved backend (streamer may downgrade it) */
+    rt_uring_t uring;
+    unsigned uring_error_passes;    /**< Passes in a row with a failed io_uring read */
+    pthread_t thread;
+    atomic_bool running;
+    
+    atomic_uint_fast64_t bytes_read;
+    atomic_uint_fast64_t reads;
+    atomic_uint_fast32_t iops;
+    atomic_uint_fast32_t queue_depth;
+    atomic_uint_fast32_t max_queue_depth;
+    atomic_uint_fast64_t prefetches;
+    atomic_uint_fast64_t prefetch_hits;
+    atomic_uint_fast64_t prefetch_misses;
+    atomic_size_t preload_bytes;
+    atomic_size_t preload_hugepage_bytes;
+} stream_engine_t;
+
+static FORCE_INLINE void stream_voice_start(stream_voice_t *sv, ms_sample_data_t *sample) {
+    sv->gen++;
+    sv->underrun = false;
+    atomic_store_explicit(&sv->read_frames, 0, memory_order_relaxed);
+    atomic_store_explicit(&sv->request_sample, sample, memory_order_relaxed);
+    atomic_store_explicit(&sv->request_gen, sv->gen, memory_order_release);
+    atomic_fetch_add_explicit(&sv->starts, 1, memory_order_relaxed);
+}
+
+static FORCE_INLINE void stream_voice_stop(stream_voice_t *sv) {
+    if (!atomic_load_explicit(&sv->request_sample, memory_order_relaxed)) {
+        return;
+    }
+    sv->gen++;
+    atomic_store_explicit(&sv->request_sample, NULL, memory_order_relaxed);
+    atomic_store_explicit(&sv->request_gen, sv->gen, memory_order_release);
+}
+
+/* ============================================================================
+ * Memory Budget (residency_rt.c)
+ * ========================================================================== */
+
+#define MS_RESIDENCY_DEFAULT_HEAD_MS 250
+#define MS_RESIDENCY_PERIOD_MS 5
+
+typedef enum {
+    ZONE_RESIDENT = 0,
+    ZONE_EVICTING,                  /**< Residency thread is taking the body away */
+    ZONE_EVICTED,                   /**< Only the head is in memory */
+    ZONE_LOADING                    /**< Residency thread is reading the body back */
+} zone_state_t;
+
+/** What a voice plays of a managed zone */
+enum {
+    ZONE_HOLD_NONE = 0,
+    ZONE_HOLD_BODY,                 /**< data, counted in the zone's voices */
+    ZONE_HOLD_HEAD                  /**< The head only, until the body is back */
+};
+
+/**
+ * A zone under the memory budget. Its first frames stay resident in head
+ * for good; data (the body) is freed when evicted and reloaded from the
+ * source file. The body only goes while no voice holds it: the evicting
+ * thread publishes ZONE_EVICTING, waits for busy to clear and backs off if
+ * voices is not zero, while a note-on sets busy before reading the state.
+ */
+typedef struct zone_residency_t {
+    struct zone_residency_t *prev;  /**< Budget's zone list (under its lock) */
+    struct zone_residency_t *next;
+    ms_sample_data_t *sample;
+    char *path;                     /**< Source file, reloaded with metadata */
+    ms_sample_metadata_t metadata;
+    ms_sample_data_t head;          /**< First frames, guard-padded, never evicted */
+    size_t body_bytes;
+    
+    atomic_uint state;              /**< zone_state_t */
+    atomic_bool busy;               /**< Audio thread is reading the state */
+    atomic_uint voices;             /**< Voices holding the body */
+    atomic_bool wanted;             /**< Played while evicted */
+    atomic_uint_fast64_t last_played;  /**< Budget clock at the last use */
+} zone_residency_t;
+
+typedef struct {
+    pthread_mutex_t lock;           /**< Held by the residency thread while it works */
+    zone_residency_t *zones;
+    size_t max_bytes;               /**< 0 = no ceiling, reload only */
+    uint32_t head_ms;
+    pthread_t thread;
+    atomic_bool running;
+    atomic_uint_fast64_t clock;     /**< Stamps zone uses for least-recently-played order */
+    
+    atomic_size_t resident_bytes;
+    atomic_uint_fast64_t evictions;
+    atomic_uint_fast64_t reloads;
+    atomic_uint_fast64_t head_underruns;  /**< Voices that ran past the head (audio thread) */
+} residency_t;
+
+void residency_register(ms_sampler_t *sampler, ms_sample_data_t *sample, const char *filepath,
+                        const ms_sample_metadata_t *metadata);
+void residency_unregister(ms_sampler_t *sampler, ms_sample_data_t *sample);
+void residency_shutdown(ms_sampler_t *sampler);
+void residency_lock(ms_sampler_t *sampler);
+void residency_unlock(ms_sampler_t *sampler);
+
+/* ============================================================================
+ * Shared Sample Pools (shared_rt.c)
+ * ========================================================================== */
+
+void shared_pool_release(struct shared_pool_t *pool);
+
 /* ============================================================================
  * Envelope Generator (Optimized)
  * ========================================================================== */
@@ -191,6 +619,22 @@ static FORCE_INLINE bool envelope_is_active(const envelope_generator_t *env) {
  * Voice (Cache-aligned for performance)
  * ========================================================================== */
 
+/**
+ * Per-note expression (MPE). Targets arrive through the event queue; the
+ * audio thread moves the current values towards them once per block.
+ */
+typedef struct {
+    float pitch_target;     /* Semitones */
+    float pressure_target;  /* 0..1 */
+    float timbre_target;    /* 0..1, 1 = filter open */
+    float pitch;
+    float pressure;         /* 0..1, applied as gain 1 + pressure */
+    float timbre;
+    float pitch_multiplier; /* 2^(pitch/12), folded into playback_speed */
+    float lowpass_coeff;    /* One-pole low-pass from timbre, 1 = bypass */
+    float lowpass_state;
+} voice_expression_t;
+
 typedef struct CACHE_ALIGNED {
     bool active;
     uint32_t voice_id;
@@ -206,18 +650,59 @@ typedef struct CACHE_ALIGNED {
     float velocity_gain;  /* Pre-calculated */
     
     struct ms_instrument_t *instrument;
+    stream_voice_t *stream;  /* NULL until streaming is enabled */
+    
+    /* Per-voice modulation (voice handle commands) */
+    float pitch_multiplier;
+    float gain;
+    float pan;
+    float gain_left;     /* gain with pan applied */
+    float gain_right;
+    bool coarse;         /* Overload governor: nearest-sample interpolation */
+    
+    /* Instrument's start-order list (voice index + 1, 0 = none) */
+    uint8_t older;
+    uint8_t newer;
+    
+    /* Per-note expression */
+    uint8_t channel;     /* MPE member channel + 1, 0 = none */
+    bool expressive;     /* Expression still moving towards its targets */
+    voice_expression_t expression;
+    
+    /* Portamento: playback_speed ramps by speed_step every frame */
+    double speed_step;
+    float glide_offset;  /* Semitones between the sounding pitch and the note */
+    float glide_frames;  /* Time constant */
+    bool gliding;
+    
+    /* Pre-rendered note being played at unity speed, NULL = live resampling */
+    const struct note_cache_entry_t *cached;
+    
+    /* Memory budget: ZONE_HOLD_* of a managed zone */
+    uint8_t zone_hold;
     
     /* Padding to cache line */
     uint8_t padding[MS_CACHE_LINE_SIZE - 
-                   (sizeof(bool) + sizeof(uint32_t) + 2 * sizeof(uint8_t) +
-                    sizeof(void*) + 2 * sizeof(double) + sizeof(envelope_generator_t) +
-                    2 * sizeof(float) + sizeof(void*)) % MS_CACHE_LINE_SIZE];
+                   (4 * sizeof(bool) + sizeof(uint32_t) + 6 * sizeof(uint8_t) +
+                    sizeof(void*) + 3 * sizeof(double) + sizeof(envelope_generator_t) +
+                    9 * sizeof(float) + 3 * sizeof(void*) +
+                    sizeof(voice_expression_t)) % MS_CACHE_LINE_SIZE];
 } voice_t;
 
 void voice_init(voice_t *voice, uint32_t voice_id, float sample_rate);
 void voice_trigger(voice_t *voice, ms_sample_data_t *sample, uint8_t note, 
-                   uint8_t velocity, const ms_envelope_t *envelope);
+                   uint8_t velocity, const ms_envelope_t *envelope, double frequency,
+                   float bend);
 void voice_release(voice_t *voice);
+void voice_set_pitch(voice_t *voice, float semitones);
+void voice_set_bend(voice_t *voice, float multiplier);
+void voice_set_gain_pan(voice_t *voice, float gain, float pan);
+void voice_expression_start(voice_t *voice, float pitch, float pressure, float timbre);
+bool voice_expression_update(voice_t *voice, float alpha);
+void voice_glide_from(voice_t *voice, float offset, float glide_frames);
+void voice_retarget(voice_t *voice, float interval, float glide_frames);
+void voice_glide_update(voice_t *voice, size_t num_frames);
+void voice_uncache(voice_t *voice);
 void voice_process(voice_t *voice, float *output, size_t num_frames, uint16_t channels);
 bool voice_is_active(const voice_t *voice);
 
@@ -225,6 +710,31 @@ bool voice_is_active(const voice_t *voice);
  * Instrument
  * ========================================================================== */
 
+/* ============================================================================
+ * Note Cache
+ * ========================================================================== */
+
+typedef struct note_cache_entry_t {
+    struct note_cache_t *cache;
+    const ms_sample_data_t *source;
+    struct note_cache_entry_t *next;    /**< Other zones of the same note */
+    float *data;                    /**< First channel of the zone resampled to the note */
+    size_t num_frames;
+    double speed;                   /**< Playback speed the note was rendered for */
+    uint8_t note;
+} note_cache_entry_t;
+
+typedef struct note_cache_t {
+    note_cache_entry_t *notes[128];
+    note_cache_entry_t *entries;
+    size_t num_entries;
+    atomic_uint voices;             /**< Voices playing from this cache */
+    struct note_cache_t *retired_next;  /**< Instrument's retired caches (control thread) */
+} note_cache_t;
+
+#define MS_HELD_NOTES 16
+#define GLIDE_TIME_CONSTANTS 4.6051702f  /* ln(100): portamento time covers 99% */
+
 struct ms_instrument_t {
     char name[64];
     ms_sample_data_t *samples[MS_MAX_SAMPLES_PER_INSTRUMENT];
@@ -232,12 +742,74 @@ struct ms_instrument_t {
     ms_envelope_t envelope;
     float pitch_bend_range;
     int16_t current_pitch_bend;
+    float pitch_bend_multiplier;    /**< Current bend as a speed ratio (audio thread) */
     struct ms_sampler_t *sampler;
+    
+    /* Voice budget: applied and counted on the audio thread */
+    uint8_t max_voices;             /**< 0 = no limit */
+    uint8_t reserved_voices;
+    int32_t priority;
+    uint8_t active_voices;
+    uint8_t oldest_voice;           /**< Head of the start-order list (voice index + 1) */
+    uint8_t newest_voice;
+    uint8_t active_slot;            /**< Index in sampler->active_instruments */
+    
+    /* Mono / legato: audio thread only */
+    uint8_t voice_mode;             /**< ms_voice_mode_t */
+    float glide_frames;             /**< Portamento time constant, 0 = none */
+    uint8_t mono_voice;             /**< Voice index + 1, 0 = none */
+    uint8_t num_held;
+    uint8_t held_notes[MS_HELD_NOTES];  /**< Keys down, most recent last */
+    
+    /* Tuning: the control thread fills the table not in use, then flips the index */
+    ms_tuning_t tuning[2];
+    atomic_uint tuning_index;
+    atomic_bool tuning_busy;        /**< Audio thread is reading a table */
+    
+    /* Pre-rendered notes (cache_rt.c) */
+    _Atomic(note_cache_t *) note_cache;
+    note_cache_t *retired_caches;   /**< Replaced while the engine was not rendering (control_lock) */
+    atomic_bool cache_busy;         /**< Audio thread is attaching a voice to the cache */
+    atomic_uint note_counts[128];   /**< Note-ons played, for picking notes to cache */
+    
+    /* Destruction: freed once the audio thread has let go (RT_EVENT_INSTRUMENT_DROP) */
+    struct ms_instrument_t *retired_next;  /**< Sampler's retired list (under control_lock) */
+    bool drop_queued;
+    atomic_bool dropped;            /**< Set by the audio thread; no voice or list refers to it */
 };
 
 ms_sample_data_t* instrument_find_sample(ms_instrument_t *instrument, 
                                          uint8_t note, uint8_t velocity);
 
+void note_cache_attach(ms_instrument_t *instrument, voice_t *voice);
+void note_cache_drop(ms_sampler_t *sampler, ms_instrument_t *instrument);
+void note_cache_destroy(note_cache_t *cache);
+void note_cache_destroy_all(ms_instrument_t *instrument);
+void zone_acquire(ms_sampler_t *sampler, voice_t *voice);
+void zone_expect(ms_sampler_t *sampler, ms_sample_data_t *sample);
+
+/**
+ * @brief Let go of a managed zone's body (audio thread)
+ */
+static FORCE_INLINE void zone_release(voice_t *voice) {
+    if (voice->zone_hold == ZONE_HOLD_BODY) {
+        atomic_fetch_sub_explicit(&voice->sample->residency->voices, 1, memory_order_release);
+    }
+    voice->zone_hold = ZONE_HOLD_NONE;
+}
+
+
+/**
+ * @brief Frequency of a note in the instrument's tuning (0 = unmapped)
+ */
+static FORCE_INLINE double instrument_note_frequency(ms_instrument_t *instrument, uint8_t note) {
+    atomic_store(&instrument->tuning_busy, true);
+    const unsigned index = atomic_load(&instrument->tuning_index);
+    const double frequency = instrument->tuning[index].frequency[note & 0x7F];
+    atomic_store_explicit(&instrument->tuning_busy, false, memory_order_release);
+    return frequency;
+}
+
 /* ============================================================================
  * MIDI Event
  * ========================================================================== */
@@ -258,16 +830,225 @@ typedef struct {
 } midi_event_t;
 
 typedef struct {
-    midi_event_t *events;
+    uint32_t tick;
+    uint32_t tempo;                 /**< Microseconds per quarter note */
+} midi_tempo_t;
+
+typedef struct {
+    midi_event_t *events;           /**< All tracks merged, sorted by tick */
     size_t num_events;
     size_t capacity;
     uint32_t ticks_per_beat;
-    uint32_t tempo;
+    uint32_t tempo;                 /**< Initial tempo */
+    midi_tempo_t *tempo_map;        /**< Tempo changes sorted by tick */
+    size_t num_tempos;
 } midi_track_t;
 
 ms_error_t midi_parse_file(const char *filepath, midi_track_t *track);
 void midi_track_destroy(midi_track_t *track);
 
+/**
+ * @brief Convert event ticks to frame offsets through the tempo map
+ *
+ * @param frames Output, one entry per event
+ */
+void midi_track_tick_frames(const midi_track_t *track, double sample_rate, uint64_t *frames);
+
+/* ============================================================================
+ * Voice Handles
+ * ========================================================================== */
+
+#define MS_VOICE_HANDLES 256            /**< Power of two, well above MS_MAX_VOICES */
+#define MS_VOICE_HANDLE_FLAG 0x80000000u  /**< Set on handles, clear on audio-assigned IDs */
+
+/**
+ * A handle is MS_VOICE_HANDLE_FLAG | generation << 8 | entry index. The
+ * control thread allocates entries at note-on; the audio thread binds
+ * them to a voice and frees them when the voice ends.
+ */
+typedef struct {
+    atomic_uint_fast32_t handle;    /**< Handle currently issued for this entry */
+    atomic_bool in_use;
+    uint32_t generation;            /**< Control thread */
+    uint8_t voice;                  /**< Audio thread: voice index + 1, 0 = unbound */
+} voice_handle_entry_t;
+
+/* ============================================================================
+ * Self-Hosted Render Thread (render_rt.c)
+ * ========================================================================== */
+
+/**
+ * SPSC ring of rendered audio. The render thread is the only writer of
+ * write_pos, the reader the only writer of read_pos; both count frames
+ * monotonically and are masked on access.
+ */
+typedef struct {
+    float *ring;                    /**< ring_mask + 1 interleaved frames */
+    size_t ring_mask;
+    size_t block_frames;            /**< Frames per ms_process() call */
+    rt_pinned_block_t buffer;       /**< Ring plus one wrap-around scratch block */
+    float *scratch;
+    int priority;
+    
+    CACHE_ALIGNED atomic_size_t write_pos;
+    CACHE_ALIGNED atomic_size_t read_pos;
+    atomic_uint_fast64_t underrun_frames;
+    atomic_bool running;
+} render_ring_t;
+
+/* ============================================================================
+ * Voice Budget (budget_rt.c)
+ * ========================================================================== */
+
+/**
+ * Voice slots shared by several samplers. Each sampler still renders its
+ * own voices[]; the pool only bounds how many may sound across all of them.
+ */
+struct ms_voice_pool_t {
+    CACHE_ALIGNED atomic_uint_fast32_t active;
+    uint32_t max_voices;
+};
+
+/* ============================================================================
+ * Overload Governor (governor_rt.c)
+ * ========================================================================== */
+
+/**
+ * Configuration is written by the control thread while the governor is
+ * disabled and the audio thread is outside it (busy clear); the rest is
+ * audio-thread state, published to the stats API through the atomics.
+ */
+typedef struct {
+    atomic_bool enabled;
+    atomic_bool busy;               /**< Audio thread is inside a governed block */
+    
+    /* Configuration */
+    float high_load;
+    float low_load;
+    uint64_t hold_ns;
+    float quiet_level;              /**< Linear */
+    float retire_level;             /**< Linear */
+    uint16_t polyphony_cap;
+    
+    /* Audio thread */
+    uint8_t level;                  /**< ms_governor_level_t */
+    uint8_t degrade;                /**< level for the current block, 0 if ungoverned */
+    uint64_t block_start_ns;
+    float load;                     /**< Smoothed fraction of the block period */
+    uint64_t calm_ns;               /**< Time spent below low_load at this level */
+    uint32_t settle;                /**< Blocks left before the next escalation */
+    
+    /* Published */
+    atomic_uint_fast32_t shared_level;
+    atomic_uint_fast32_t load_ppm;
+    atomic_uint_fast32_t peak_load_ppm;
+    atomic_uint_fast64_t escalations;
+    atomic_uint_fast64_t retired_voices;
+    atomic_uint_fast64_t capped_notes;
+} governor_t;
+
+/* ============================================================================
+ * Live Statistics Segment (monitor_rt.c)
+ * ========================================================================== */
+
+#define MS_MONITOR_MAGIC "MSSTATS1"
+
+/**
+ * Shared memory layout. The audio thread makes sequence odd, writes
+ * data and makes it even again; readers retry until they see the same
+ * even value before and after copying.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t size;                  /**< sizeof(monitor_segment_t) */
+    atomic_uint sequence;
+    CACHE_ALIGNED ms_monitor_snapshot_t data;
+} monitor_segment_t;
+
+/**
+ * Publishing state. The control thread swaps segment while the audio
+ * thread is outside a block (busy clear); local is audio-thread state.
+ */
+typedef struct {
+    _Atomic(monitor_segment_t *) segment;
+    atomic_bool busy;               /**< Audio thread is inside a monitored block */
+    char *name;                     /**< Control thread: object to unlink */
+    uint64_t block_start_ns;
+    ms_monitor_snapshot_t local;
+} monitor_t;
+
+/**
+ * @brief Audible level of a voice, as used by the governor thresholds
+ */
+static FORCE_INLINE float voice_level(const voice_t *voice) {
+    return voice->envelope.current_level * voice->velocity_gain * voice->gain;
+}
+
+/* ============================================================================
+ * Multi-Sequence Player (sequencer_rt.c)
+ * ========================================================================== */
+
+#define MS_MAX_SEQUENCES 64
+#define MS_MIDI_CHANNELS 16
+
+/**
+ * One independently playing MIDI file. Control fields are written by the
+ * control thread; cursor and origin belong to the audio thread, which
+ * picks up a (re)start when request_gen moves.
+ */
+struct ms_sequence_t {
+    struct ms_sampler_t *sampler;
+    midi_track_t track;
+    uint64_t *event_frames;         /**< Sorted frame offset of each event (binary-searchable) */
+    size_t slot;                    /**< Index in sampler->sequences */
+    
+    /* Control thread */
+    _Atomic(ms_instrument_t *) channels[MS_MIDI_CHANNELS];
+    atomic_uint_fast64_t start_frame;   /**< Sequence position to (re)start from */
+    atomic_uint_fast32_t request_gen;
+    atomic_bool playing;            /**< Cleared by the audio thread at the end */
+    
+    /* Audio thread */
+    uint32_t served_gen;
+    size_t cursor;                  /**< Next event to dispatch */
+    uint64_t origin;                /**< Engine frame at which sequence frame 0 plays */
+    atomic_uint_fast64_t played_origin; /**< origin, published for the streaming thread */
+    atomic_uint_fast32_t played_gen;    /**< served_gen, stored after played_origin */
+    
+    /* Streaming thread (under control_lock) */
+    size_t lookahead_cursor;        /**< Next event to scan for prefetch */
+    uint32_t lookahead_gen;
+};
+
+/**
+ * Notes a sequence slot has sounding and the instrument each note-on went
+ * to (audio thread). Outlives the sequence, so the audio thread can still
+ * release its notes after a stop, restart or destroy.
+ */
+typedef struct {
+    const struct ms_sequence_t *owner;  /**< Sequence that played them (compared only) */
+    uint32_t count;
+    uint64_t bits[MS_MIDI_CHANNELS][2];
+    ms_instrument_t *instrument[MS_MIDI_CHANNELS][128];
+} sequence_held_t;
+
+/** Min-heap entry: a playing sequence keyed by the engine frame of its next event */
+typedef struct {
+    uint64_t due;
+    struct ms_sequence_t *sequence;
+} sequence_heap_entry_t;
+
+/**
+ * MPE member channel state (audio thread). Expression sent before a
+ * note-on applies to that note, so the last values are kept per channel.
+ */
+typedef struct {
+    float pitch;
+    float pressure;
+    float timbre;
+    uint8_t voice;                  /**< Voice index + 1 of the channel's note, 0 = none */
+} channel_expression_t;
+
 /* ============================================================================
  * Sampler (RT-optimized)
  * ========================================================================== */
@@ -282,25 +1063,138 @@ struct ms_sampler_t {
     /* Lock-free event queue for RT safety */
     rt_event_queue_t event_queue CACHE_ALIGNED;
     
-    /* MIDI playback state */
+    /* Voice lifecycle notifications back to the control thread */
+    rt_notify_queue_t notify_queue;
+    atomic_uint_fast64_t notify_dropped;
+    
+    /* Voice handles */
+    voice_handle_entry_t handles[MS_VOICE_HANDLES];
+    uint32_t handle_cursor;         /**< Control thread: next entry to try */
+    atomic_uint_fast64_t stale_commands;
+    
+    /* MIDI playback state (sequencer_rt.c) */
     midi_track_t *current_track;
-    size_t playback_event_index;
-    uint64_t playback_sample_count;
+    uint64_t *event_frames;         /**< Frame timestamp of each track event */
+    ms_instrument_t *playback_instrument;
+    atomic_size_t playback_event_index;
+    atomic_uint_fast64_t playback_sample_count;
+    atomic_uint_fast32_t playback_epoch;  /**< Bumped on every load/start */
     atomic_bool is_playing;
+    atomic_bool playback_busy;      /**< Audio thread is inside the sequencer */
+    
+    /* Concurrent sequences (sequencer_rt.c) */
+    struct ms_sequence_t *sequences[MS_MAX_SEQUENCES];  /**< Slots, control thread owned */
+    sequence_held_t *sequence_held[MS_MAX_SEQUENCES];   /**< Per slot, allocated on first use */
+    atomic_uint_fast32_t sequence_epoch;    /**< Bumped on every start/stop/add/remove */
+    atomic_bool sequences_busy;     /**< Audio thread is inside the sequence merge */
+    sequence_heap_entry_t sequence_heap[MS_MAX_SEQUENCES];
+    size_t sequence_heap_size;
+    uint32_t sequence_heap_epoch;   /**< Epoch the heap was built for */
+    uint64_t sequence_clock;        /**< Engine frame at the start of the block */
     
     /* RT thread info */
-    pthread_t audio_thread;
+    pthread_t audio_thread;         /**< Self-hosted render thread, if started */
+    render_ring_t render;
     int rt_priority;
     bool rt_enabled;
     
+    /* Disk streaming */
+    stream_engine_t streamer;
+    
+    /* Overload governor */
+    governor_t governor;
+    
+    /* Memory budget */
+    residency_t residency;
+    
+    /* Live statistics segment */
+    monitor_t monitor;
+    
+    /* MPE: last expression per member channel and the voice holding it */
+    channel_expression_t channel_expression[MS_MIDI_CHANNELS];
+    float expression_alpha;         /**< Per-block smoothing for the last block size */
+    size_t expression_frames;
+    
+    /* Controller coalescing (audio thread) */
+    rt_event_t coalesce_slots[RT_COALESCE_SLOTS];
+    uint8_t coalesce_order[RT_COALESCE_PENDING];  /**< Occupied slots in arrival order */
+    uint32_t coalesce_count;
+    uint32_t coalesce_skipped;      /**< Superseded since the last flush */
+    atomic_uint_fast64_t events_coalesced;
+    
+    /* Events stamped for a later block, in due order (audio thread) */
+    rt_event_t scheduled[RT_SCHEDULE_SLOTS];
+    uint32_t num_scheduled;
+    
+    /* Note cache */
+    atomic_uint_fast64_t notes_cached;
+    
+    /* Load-time preprocessing (preprocess_rt.c), control threads */
+    ms_preprocess_config_t preprocess;
+    atomic_uint_fast64_t preprocess_ns[MS_PREPROCESS_STAGES];
+    atomic_uint_fast64_t preprocess_files;
+    atomic_uint_fast64_t preprocess_frames_in;
+    atomic_uint_fast64_t preprocess_frames_out;
+    char *sample_cache_dir;         /**< On-disk cache (sample_cache_rt.c), NULL if off */
+    uint64_t sample_cache_max_bytes;
+    atomic_uint_fast64_t sample_cache_hits;
+    atomic_uint_fast64_t sample_cache_misses;
+    
+    /* Voice budget (budget_rt.c), audio thread except where noted */
+    uint32_t active_voices;
+    atomic_uint_fast32_t reserved_outstanding;  /**< Reserved voices not in use yet */
+    struct ms_instrument_t *active_instruments[MS_MAX_VOICES];  /**< Instruments with sounding voices */
+    uint32_t num_active_instruments;
+    _Atomic(struct ms_voice_pool_t *) pool;  /**< Where new voices take a slot (control thread) */
+    struct ms_voice_pool_t *voice_pool[MS_MAX_VOICES];  /**< Pool each voice holds a slot of */
+    atomic_uint_fast64_t notes_rejected;
+    atomic_uint_fast64_t voices_stolen;
+    atomic_bool all_notes_off;      /**< Fallback when the event queue is full */
+    
     /* Statistics (for monitoring, not in hot path) */
     CACHE_ALIGNED atomic_uint_fast64_t frames_processed;
     CACHE_ALIGNED atomic_uint_fast32_t xruns;
     
     /* Mutex only for non-RT operations */
     pthread_mutex_t control_lock;
+    struct ms_instrument_t *retired_instruments;  /**< Destroyed, awaiting the audio thread */
+    
+    /* Drop requests from any control thread, apart from the note producer's queue */
+    rt_event_queue_t drop_queue CACHE_ALIGNED;
+    pthread_mutex_t drop_lock;      /**< Serializes drop_queue producers */
+    atomic_uint_fast64_t stalled_frame;  /**< frames_processed when a wait last gave up, + 1 */
 };
 
+bool sampler_request_drop(ms_sampler_t *sampler, uint8_t type, struct ms_instrument_t *instrument);
+bool sampler_wait_blocks(ms_sampler_t *sampler, bool (*done)(void *ctx), void *ctx);
+
+void sampler_handle_event(ms_sampler_t *sampler, const rt_event_t *event);
+void sampler_flush_controllers(ms_sampler_t *sampler);
+void sequencer_process(ms_sampler_t *sampler, size_t num_frames);
+void sequencer_release(ms_sampler_t *sampler);
+void sequences_process(ms_sampler_t *sampler, size_t num_frames);
+void sequences_forget_instrument(ms_sampler_t *sampler, const ms_instrument_t *instrument);
+void render_thread_shutdown(ms_sampler_t *sampler);
+void governor_init(ms_sampler_t *sampler);
+bool governor_begin(ms_sampler_t *sampler);
+void governor_end(ms_sampler_t *sampler, size_t num_frames);
+bool monitor_begin(ms_sampler_t *sampler);
+void monitor_end(ms_sampler_t *sampler, size_t num_frames);
+void monitor_shutdown(ms_sampler_t *sampler);
+voice_t *governor_cap_voice(ms_sampler_t *sampler);
+voice_t *voice_allocate(ms_sampler_t *sampler, ms_instrument_t *inst);
+void voice_bind(ms_sampler_t *sampler, voice_t *voice, ms_instrument_t *inst);
+void voice_unbind(ms_sampler_t *sampler, voice_t *voice, bool release_pool);
+void voice_budget_apply(ms_sampler_t *sampler, const rt_event_t *event);
+void stream_engine_shutdown(ms_sampler_t *sampler);
+void stream_sample_destroy(ms_sampler_t *sampler, ms_sample_data_t *sample);
+ms_error_t preprocess_load_file(ms_sampler_t *sampler, const char *filepath,
+                                const ms_sample_metadata_t *metadata, ms_sample_data_t **sample);
+bool sample_cache_lookup(ms_sampler_t *sampler, const char *filepath,
+                         const ms_sample_metadata_t *metadata, uint64_t *key,
+                         ms_sample_data_t **sample);
+void sample_cache_store(ms_sampler_t *sampler, uint64_t key, const ms_sample_data_t *sample);
+
 /* ============================================================================
  * RT Thread Management
  * ========================================================================== */
@@ -334,4 +1228,23 @@ static inline ms_error_t ms_lock_memory(void) {
     return MS_SUCCESS;
 }
 
+/* ============================================================================
+ * RT-Safety Checks (ENABLE_RT_CHECKS builds)
+ * ========================================================================== */
+
+/*
+ * ms_process() marks its thread through these hooks. They are weak, so
+ * they stay NULL and cost one branch unless the rt_check shim (or another
+ * implementation) is preloaded or linked in.
+ */
+#ifdef MS_RT_CHECKS
+void ms_rt_check_enter(void) __attribute__((weak));
+void ms_rt_check_leave(void) __attribute__((weak));
+#define RT_CHECK_ENTER() do { if (ms_rt_check_enter) ms_rt_check_enter(); } while (0)
+#define RT_CHECK_LEAVE() do { if (ms_rt_check_leave) ms_rt_check_leave(); } while (0)
+#else
+#define RT_CHECK_ENTER() ((void)0)
+#define RT_CHECK_LEAVE() ((void)0)
+#endif
+
 #endif /* MIDI_SAMPLER_INTERNAL_RT_H */
@@ -3,7 +3,11 @@
  * @brief MIDI file parsing
  */
 
+#ifdef ENABLE_RT_OPTIMIZATIONS
+#include "internal/internal_rt.h"
+#else
 #include "internal/internal.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -53,50 +57,63 @@ static ms_error_t add_midi_event(midi_track_t *track, const midi_event_t *event)
     return MS_SUCCESS;
 }
 
-ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
-    if (!filepath || !track) {
-        return MS_ERROR_INVALID_PARAM;
-    }
+static ms_error_t add_tempo_change(midi_track_t *track, uint32_t tick, uint32_t tempo) {
+    midi_tempo_t *new_map = (midi_tempo_t*)realloc(
+        track->tempo_map,
+        (track->num_tempos + 1) * sizeof(midi_tempo_t)
+    );
     
-    memset(track, 0, sizeof(*track));
-    
-    FILE *fp = fopen(filepath, "rb");
-    if (!fp) {
-        return MS_ERROR_FILE_NOT_FOUND;
+    if (!new_map) {
+        return MS_ERROR_OUT_OF_MEMORY;
     }
     
-    /* Read header chunk */
-    char header_id[4];
-    fread(header_id, 1, 4, fp);
-    
-    if (memcmp(header_id, "MThd", 4) != 0) {
-        fclose(fp);
-        return MS_ERROR_INVALID_FORMAT;
+    /* Tracks are parsed one after another: keep the map sorted by tick */
+    size_t i = track->num_tempos;
+    while (i > 0 && new_map[i - 1].tick > tick) {
+        new_map[i] = new_map[i - 1];
+        i--;
     }
+    new_map[i].tick = tick;
+    new_map[i].tempo = tempo;
     
-    uint32_t header_length = read_be32(fp);
-    uint16_t format = read_be16(fp);
-    uint16_t num_tracks = read_be16(fp);
-    uint16_t division = read_be16(fp);
-    
-    track->ticks_per_beat = division & 0x7FFF;
-    track->tempo = 500000; /* Default: 120 BPM */
-    
-    /* Skip any extra header data */
-    if (header_length > 6) {
-        fseek(fp, header_length - 6, SEEK_CUR);
+    track->tempo_map = new_map;
+    track->num_tempos++;
+    return MS_SUCCESS;
+}
+
+/**
+ * @brief Merge the events of a just-parsed track into the sorted prefix
+ *
+ * Stable: at equal timestamps, events of earlier tracks come first.
+ */
+static ms_error_t merge_track_events(midi_track_t *track, size_t split) {
+    if (split == 0 || split == track->num_events ||
+        track->events[split - 1].timestamp <= track->events[split].timestamp) {
+        return MS_SUCCESS;
     }
     
-    /* Read first track */
-    char track_id[4];
-    fread(track_id, 1, 4, fp);
+    midi_event_t *merged = (midi_event_t*)malloc(track->num_events * sizeof(midi_event_t));
+    if (!merged) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
     
-    if (memcmp(track_id, "MTrk", 4) != 0) {
-        fclose(fp);
-        return MS_ERROR_INVALID_FORMAT;
+    size_t a = 0, b = split, out = 0;
+    while (a < split && b < track->num_events) {
+        if (track->events[b].timestamp < track->events[a].timestamp) {
+            merged[out++] = track->events[b++];
+        } else {
+            merged[out++] = track->events[a++];
+        }
     }
+    while (a < split) merged[out++] = track->events[a++];
+    while (b < track->num_events) merged[out++] = track->events[b++];
     
-    uint32_t track_length = read_be32(fp);
+    memcpy(track->events, merged, track->num_events * sizeof(midi_event_t));
+    free(merged);
+    return MS_SUCCESS;
+}
+
+static ms_error_t parse_track_chunk(FILE *fp, uint32_t track_length, midi_track_t *track) {
     long track_end = ftell(fp) + track_length;
     
     uint32_t current_time = 0;
@@ -107,7 +124,9 @@ ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
         current_time += delta_time;
         
         uint8_t status;
-        fread(&status, 1, 1, fp);
+        if (fread(&status, 1, 1, fp) != 1) {
+            break;
+        }
         
         /* Handle running status */
         if (status < 0x80) {
@@ -134,7 +153,9 @@ ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
                 .data2 = velocity
             };
             
-            add_midi_event(track, &event);
+            if (add_midi_event(track, &event) != MS_SUCCESS) {
+                return MS_ERROR_OUT_OF_MEMORY;
+            }
             
         } else if (event_type == 0xE0) {
             /* Pitch Bend */
@@ -152,7 +173,9 @@ ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
                 .data2 = (bend_value >> 8) & 0xFF
             };
             
-            add_midi_event(track, &event);
+            if (add_midi_event(track, &event) != MS_SUCCESS) {
+                return MS_ERROR_OUT_OF_MEMORY;
+            }
             
         } else if (event_type == 0xB0) {
             /* Control Change */
@@ -181,7 +204,10 @@ ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
                 /* Set Tempo */
                 uint8_t bytes[3];
                 fread(bytes, 1, 3, fp);
-                track->tempo = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+                uint32_t tempo = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+                if (add_tempo_change(track, current_time, tempo) != MS_SUCCESS) {
+                    return MS_ERROR_OUT_OF_MEMORY;
+                }
             } else {
                 /* Skip other meta events */
                 fseek(fp, length, SEEK_CUR);
@@ -193,15 +219,119 @@ ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
         }
     }
     
+    /* Continue with the next chunk even if the last event overran */
+    fseek(fp, track_end, SEEK_SET);
+    return MS_SUCCESS;
+}
+
+ms_error_t midi_parse_file(const char *filepath, midi_track_t *track) {
+    if (!filepath || !track) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    
+    memset(track, 0, sizeof(*track));
+    
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+    
+    /* Read header chunk */
+    char header_id[4];
+    fread(header_id, 1, 4, fp);
+    
+    if (memcmp(header_id, "MThd", 4) != 0) {
+        fclose(fp);
+        return MS_ERROR_INVALID_FORMAT;
+    }
+    
+    uint32_t header_length = read_be32(fp);
+    read_be16(fp);  /* Format: type 0 and 1 both merge into one event list */
+    uint16_t num_tracks = read_be16(fp);
+    uint16_t division = read_be16(fp);
+    
+    track->ticks_per_beat = division & 0x7FFF;
+    
+    /* Skip any extra header data */
+    if (header_length > 6) {
+        fseek(fp, header_length - 6, SEEK_CUR);
+    }
+    
+    /* Read all tracks; unknown chunks are skipped */
+    uint16_t tracks_read = 0;
+    char chunk_id[4];
+    while (tracks_read < num_tracks && fread(chunk_id, 1, 4, fp) == 4) {
+        uint32_t chunk_length = read_be32(fp);
+        
+        if (memcmp(chunk_id, "MTrk", 4) != 0) {
+            fseek(fp, chunk_length, SEEK_CUR);
+            continue;
+        }
+        
+        size_t split = track->num_events;
+        ms_error_t err = parse_track_chunk(fp, chunk_length, track);
+        if (err == MS_SUCCESS) {
+            err = merge_track_events(track, split);
+        }
+        if (err != MS_SUCCESS) {
+            fclose(fp);
+            midi_track_destroy(track);
+            return err;
+        }
+        tracks_read++;
+    }
+    
     fclose(fp);
+    
+    if (tracks_read == 0) {
+        midi_track_destroy(track);
+        return MS_ERROR_INVALID_FORMAT;
+    }
+    
+    /* Initial tempo; later changes stay in the tempo map */
+    track->tempo = 500000; /* Default: 120 BPM */
+    if (track->num_tempos > 0 && track->tempo_map[0].tick == 0) {
+        track->tempo = track->tempo_map[0].tempo;
+    }
+    
     return MS_SUCCESS;
 }
 
+void midi_track_tick_frames(const midi_track_t *track, double sample_rate, uint64_t *frames) {
+    /* frames per tick = tempo [us/beat] / ticks_per_beat * sample_rate / 1e6 */
+    double scale = track->ticks_per_beat > 0 ?
+                   sample_rate / (1000000.0 * track->ticks_per_beat) : 0.0;
+    double frames_per_tick = 500000.0 * scale;
+    double segment_frame = 0.0;
+    uint32_t segment_tick = 0;
+    size_t next_tempo = 0;
+    
+    for (size_t i = 0; i < track->num_events; i++) {
+        uint32_t tick = track->events[i].timestamp;
+        
+        /* Close every tempo segment that starts before this event */
+        while (next_tempo < track->num_tempos && track->tempo_map[next_tempo].tick <= tick) {
+            const midi_tempo_t *change = &track->tempo_map[next_tempo++];
+            segment_frame += (change->tick - segment_tick) * frames_per_tick;
+            segment_tick = change->tick;
+            frames_per_tick = change->tempo * scale;
+        }
+        
+        frames[i] = (uint64_t)(segment_frame + (tick - segment_tick) * frames_per_tick + 0.5);
+    }
+}
+
 void midi_track_destroy(midi_track_t *track) {
-    if (track && track->events) {
+    if (!track) return;
+    
+    if (track->events) {
         free(track->events);
         track->events = NULL;
         track->num_events = 0;
         track->capacity = 0;
     }
+    
+    free(track->tempo_map);
+    track->tempo_map = NULL;
+    track->num_tempos = 0;
 }
@@ -0,0 +1,247 @@
+/**
+ * @file budget_rt.c
+ * @brief Voice budget: per-instrument limits, reservations and priorities
+ *
+ * Every instrument keeps a count of its sounding voices and a start-order
+ * list of them, so limits, reservations and the oldest voice to steal are
+ * all O(1) per instrument. A note-on takes, in order:
+ * 1. The instrument's own oldest voice if it is at its limit
+ * 2. A free voice, unless that would eat into another instrument's
+ *    reservation or the shared pool is exhausted
+ * 3. The oldest voice of the lowest-priority instrument that is above its
+ *    reservation (only instruments of equal or lower priority, unless the
+ *    caller is still below its own reservation)
+ * Otherwise the note is rejected.
+ */
+
+#include "internal/internal_rt.h"
+#include <stdlib.h>
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+ms_error_t ms_instrument_set_voice_budget(ms_instrument_t *instrument,
+                                          const ms_voice_budget_t *budget) {
+    if (!instrument || !instrument->sampler || !budget ||
+        budget->max_voices > MS_MAX_VOICES || budget->reserved_voices > MS_MAX_VOICES ||
+        (budget->max_voices && budget->reserved_voices > budget->max_voices)) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    /* Counters live on the audio thread, so the change travels with the notes */
+    rt_event_t event = {
+        .note = (uint8_t)budget->max_voices,
+        .velocity = (uint8_t)budget->reserved_voices,
+        .event_type = RT_EVENT_VOICE_BUDGET,
+        .timestamp = (uint32_t)atomic_load_explicit(&instrument->sampler->frames_processed,
+                                                    memory_order_relaxed),
+        .instrument = instrument,
+        .voice_id = (uint32_t)budget->priority
+    };
+
+    if (!rt_queue_push(&instrument->sampler->event_queue, &event)) {
+        return MS_ERROR_BUFFER_OVERFLOW;
+    }
+
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_voice_pool_create(uint32_t max_voices, ms_voice_pool_t **pool) {
+    if (!pool || max_voices == 0) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    ms_voice_pool_t *p = (ms_voice_pool_t*)aligned_alloc(MS_CACHE_LINE_SIZE, sizeof(ms_voice_pool_t));
+    if (!p) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    atomic_init(&p->active, 0);
+    p->max_voices = max_voices;
+
+    *pool = p;
+    return MS_SUCCESS;
+}
+
+void ms_voice_pool_destroy(ms_voice_pool_t *pool) {
+    free(pool);
+}
+
+ms_error_t ms_sampler_set_voice_pool(ms_sampler_t *sampler, ms_voice_pool_t *pool) {
+    if (!sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    /* Sounding voices give their slot back to the pool they took it from */
+    atomic_store_explicit(&sampler->pool, pool, memory_order_release);
+    return MS_SUCCESS;
+}
+
+/* ============================================================================
+ * Audio Thread
+ * ========================================================================== */
+
+static FORCE_INLINE uint32_t reserve_outstanding(const ms_instrument_t *inst) {
+    return inst->active_voices < inst->reserved_voices ?
+           (uint32_t)(inst->reserved_voices - inst->active_voices) : 0;
+}
+
+static FORCE_INLINE bool pool_acquire(ms_voice_pool_t *pool) {
+    if (!pool) return true;
+
+    uint_fast32_t active = atomic_load_explicit(&pool->active, memory_order_relaxed);
+    while (active < pool->max_voices) {
+        if (atomic_compare_exchange_weak_explicit(&pool->active, &active, active + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Apply an RT_EVENT_VOICE_BUDGET event
+ */
+void voice_budget_apply(ms_sampler_t *sampler, const rt_event_t *event) {
+    ms_instrument_t *inst = (ms_instrument_t*)event->instrument;
+    const uint32_t before = reserve_outstanding(inst);
+
+    inst->max_voices = event->note;
+    inst->reserved_voices = event->velocity;
+    inst->priority = (int32_t)event->voice_id;
+
+    const uint32_t after = reserve_outstanding(inst);
+    if (after > before) {
+        atomic_fetch_add_explicit(&sampler->reserved_outstanding, after - before,
+                                  memory_order_relaxed);
+    } else if (before > after) {
+        atomic_fetch_sub_explicit(&sampler->reserved_outstanding, before - after,
+                                  memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Account a voice to the instrument that just triggered it
+ */
+void voice_bind(ms_sampler_t *sampler, voice_t *voice, ms_instrument_t *inst) {
+    const uint8_t slot = (uint8_t)(voice - sampler->voices + 1);
+
+    voice->instrument = inst;
+    voice->older = inst->newest_voice;
+    voice->newer = 0;
+    if (inst->newest_voice) {
+        sampler->voices[inst->newest_voice - 1].newer = slot;
+    } else {
+        inst->oldest_voice = slot;
+    }
+    inst->newest_voice = slot;
+
+    if (inst->active_voices < inst->reserved_voices) {
+        atomic_fetch_sub_explicit(&sampler->reserved_outstanding, 1, memory_order_relaxed);
+    }
+    if (inst->active_voices++ == 0) {
+        inst->active_slot = (uint8_t)sampler->num_active_instruments;
+        sampler->active_instruments[sampler->num_active_instruments++] = inst;
+    }
+    sampler->active_voices++;
+}
+
+/**
+ * @brief Remove an ending or stolen voice from its instrument's accounts
+ *
+ * @param release_pool false when the voice is stolen and keeps its slot
+ */
+void voice_unbind(ms_sampler_t *sampler, voice_t *voice, bool release_pool) {
+    ms_instrument_t *inst = voice->instrument;
+
+    if (voice->older) {
+        sampler->voices[voice->older - 1].newer = voice->newer;
+    } else {
+        inst->oldest_voice = voice->newer;
+    }
+    if (voice->newer) {
+        sampler->voices[voice->newer - 1].older = voice->older;
+    } else {
+        inst->newest_voice = voice->older;
+    }
+    voice->older = voice->newer = 0;
+
+    if (--inst->active_voices == 0) {
+        ms_instrument_t *last = sampler->active_instruments[--sampler->num_active_instruments];
+        sampler->active_instruments[inst->active_slot] = last;
+        last->active_slot = inst->active_slot;
+    }
+    if (inst->active_voices < inst->reserved_voices) {
+        atomic_fetch_add_explicit(&sampler->reserved_outstanding, 1, memory_order_relaxed);
+    }
+    sampler->active_voices--;
+
+    ms_voice_pool_t **pool = &sampler->voice_pool[voice - sampler->voices];
+    if (release_pool && *pool) {
+        atomic_fetch_sub_explicit(&(*pool)->active, 1, memory_order_relaxed);
+        *pool = NULL;
+    }
+}
+
+/**
+ * @brief Choose the instrument to steal from for a note on inst
+ */
+static ms_instrument_t *voice_victim(ms_sampler_t *sampler, const ms_instrument_t *inst) {
+    const bool below_reserve = inst->active_voices < inst->reserved_voices;
+    ms_instrument_t *victim = NULL;
+    int surplus = 0;
+
+    for (uint32_t i = 0; i < sampler->num_active_instruments; i++) {
+        ms_instrument_t *candidate = sampler->active_instruments[i];
+        const int over = (int)candidate->active_voices - (int)candidate->reserved_voices;
+
+        if (candidate != inst) {
+            if (over <= 0) continue;  /* Reserved voices are never stolen */
+            if (candidate->priority > inst->priority && !below_reserve) continue;
+        }
+
+        /* Lowest priority first, then the instrument furthest over its reserve */
+        if (!victim || candidate->priority < victim->priority ||
+            (candidate->priority == victim->priority && over > surplus)) {
+            victim = candidate;
+            surplus = over;
+        }
+    }
+
+    return victim;
+}
+
+/**
+ * @brief Find the voice a note-on on inst should use
+ *
+ * @return Free voice (already holding a pool slot), voice to steal (still
+ *         active), or NULL if the note must be rejected
+ */
+voice_t *voice_allocate(ms_sampler_t *sampler, ms_instrument_t *inst) {
+    if (inst->max_voices && inst->active_voices >= inst->max_voices) {
+        return &sampler->voices[inst->oldest_voice - 1];
+    }
+
+    const uint32_t max_voices = sampler->config.max_polyphony < MS_MAX_VOICES ?
+                                sampler->config.max_polyphony : MS_MAX_VOICES;
+    const uint32_t others_reserved =
+        (uint32_t)atomic_load_explicit(&sampler->reserved_outstanding, memory_order_relaxed) -
+        reserve_outstanding(inst);
+
+    ms_voice_pool_t *pool = atomic_load_explicit(&sampler->pool, memory_order_acquire);
+    if (max_voices - sampler->active_voices > others_reserved && pool_acquire(pool)) {
+        for (uint32_t i = 0; i < max_voices; i++) {
+            if (!sampler->voices[i].active) {
+                sampler->voice_pool[i] = pool;
+                return &sampler->voices[i];
+            }
+        }
+    }
+
+    ms_instrument_t *victim = voice_victim(sampler, inst);
+    if (!victim) {
+        return NULL;
+    }
+    return &sampler->voices[victim->oldest_voice - 1];
+}
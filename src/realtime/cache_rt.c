@@ -0,0 +1,356 @@
+/**
+ * @file cache_rt.c
+ * @brief Pre-rendered note cache: memory traded for CPU on static patches
+ *
+ * Without per-voice modulation a note is always the same resampled copy of
+ * its zone. For the notes played most, that copy is rendered once on a
+ * pool of worker threads with windowed-sinc interpolation, and voices play
+ * it at unity speed: one multiply-add per frame instead of interpolation.
+ * A voice that later gets pitch modulation (voice pitch commands, MPE,
+ * portamento) switches back to live resampling at the same position.
+ *
+ * Caches are immutable once published. Replacing one waits until no
+ * note-on is attaching to the old cache and no voice still plays from it.
+ * If the engine stops rendering meanwhile, the old cache is retired
+ * instead and freed by a later swap once its voices are gone.
+ */
+
+#include "internal/internal_rt.h"
+#include <math.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CACHE_DEFAULT_NOTES 32
+#define CACHE_DEFAULT_BYTES (64u * 1024u * 1024u)
+
+typedef struct {
+    note_cache_entry_t *entries;
+    size_t num_entries;
+    atomic_size_t next;             /* Next entry to render */
+} cache_job_t;
+
+/* ============================================================================
+ * Rendering
+ * ========================================================================== */
+
+static double root_frequency(uint8_t note) {
+    return 440.0 * exp2((note - 69) / 12.0);
+}
+
+/**
+ * @brief Render a zone's first channel at the entry's speed
+ */
+static void cache_render_entry(note_cache_entry_t *entry) {
+    const ms_sample_data_t *source = entry->source;
+    sinc_resample(source->data, source->num_frames, source->channels, entry->speed,
+                  entry->data, entry->num_frames, 1);
+}
+
+static void *cache_worker(void *arg) {
+    cache_job_t *job = (cache_job_t*)arg;
+
+    for (;;) {
+        const size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->num_entries) break;
+        cache_render_entry(&job->entries[i]);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Building
+ * ========================================================================== */
+
+/**
+ * @brief Zones a note can play, one per velocity layer
+ */
+static size_t note_zones(ms_instrument_t *inst, uint8_t note, ms_sample_data_t **zones) {
+    size_t count = 0;
+
+    for (int velocity = 1; velocity < 128; velocity++) {
+        ms_sample_data_t *zone = instrument_find_sample(inst, note, (uint8_t)velocity);
+        if (!zone || zone->streamed || zone->meta.loop_enabled || !zone->data) continue;
+
+        bool seen = false;
+        for (size_t i = 0; i < count; i++) {
+            seen |= zones[i] == zone;
+        }
+        if (!seen) {
+            zones[count++] = zone;
+        }
+    }
+    return count;
+}
+
+void note_cache_destroy(note_cache_t *cache) {
+    if (!cache) return;
+
+    for (size_t i = 0; i < cache->num_entries; i++) {
+        free(cache->entries[i].data);
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+/**
+ * @brief Free the instrument's caches, current and retired (no voice may use them)
+ */
+void note_cache_destroy_all(ms_instrument_t *instrument) {
+    note_cache_destroy(atomic_load(&instrument->note_cache));
+
+    while (instrument->retired_caches) {
+        note_cache_t *cache = instrument->retired_caches;
+        instrument->retired_caches = cache->retired_next;
+        note_cache_destroy(cache);
+    }
+}
+
+/**
+ * @brief Pick notes by weight and lay out their entries
+ */
+static note_cache_t *cache_plan(ms_instrument_t *inst, const uint32_t *weights,
+                                uint32_t max_notes, size_t max_bytes) {
+    note_cache_t *cache = (note_cache_t*)calloc(1, sizeof(note_cache_t));
+    if (!cache) return NULL;
+    atomic_init(&cache->voices, 0);
+
+    /* Each note has at most one entry per zone */
+    cache->entries = (note_cache_entry_t*)calloc((size_t)max_notes * MS_MAX_SAMPLES_PER_INSTRUMENT,
+                                                 sizeof(note_cache_entry_t));
+    if (!cache->entries) {
+        free(cache);
+        return NULL;
+    }
+
+    bool taken[128] = { false };
+    size_t bytes = 0;
+    ms_sample_data_t *zones[MS_MAX_SAMPLES_PER_INSTRUMENT];
+    const ms_tuning_t *tuning = &inst->tuning[atomic_load(&inst->tuning_index)];
+
+    for (uint32_t picked = 0; picked < max_notes; picked++) {
+        int note = -1;
+        for (int n = 0; n < 128; n++) {
+            if (!taken[n] && weights[n] > 0 && (note < 0 || weights[n] > weights[note])) {
+                note = n;
+            }
+        }
+        if (note < 0 || tuning->frequency[note] <= 0.0) break;
+        taken[note] = true;
+
+        const size_t num_zones = note_zones(inst, (uint8_t)note, zones);
+        size_t note_bytes = 0;
+        for (size_t z = 0; z < num_zones; z++) {
+            const double speed = tuning->frequency[note] / root_frequency(zones[z]->meta.root_note);
+            note_bytes += (size_t)ceil(zones[z]->num_frames / speed) * sizeof(float);
+        }
+        if (bytes + note_bytes > max_bytes) continue;  /* A smaller note may still fit */
+        bytes += note_bytes;
+
+        for (size_t z = 0; z < num_zones; z++) {
+            note_cache_entry_t *entry = &cache->entries[cache->num_entries++];
+            entry->cache = cache;
+            entry->source = zones[z];
+            entry->note = (uint8_t)note;
+            entry->speed = tuning->frequency[note] / root_frequency(zones[z]->meta.root_note);
+            entry->num_frames = (size_t)ceil(zones[z]->num_frames / entry->speed);
+            entry->next = cache->notes[note];
+            cache->notes[note] = entry;
+        }
+    }
+
+    for (size_t i = 0; i < cache->num_entries; i++) {
+        note_cache_entry_t *entry = &cache->entries[i];
+        size_t size = entry->num_frames * sizeof(float);
+        size = (size + MS_CACHE_LINE_SIZE - 1) & ~(size_t)(MS_CACHE_LINE_SIZE - 1);
+        entry->data = (float*)aligned_alloc(MS_CACHE_LINE_SIZE, size ? size : MS_CACHE_LINE_SIZE);
+        if (!entry->data) {
+            note_cache_destroy(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+typedef struct {
+    ms_instrument_t *instrument;
+    note_cache_t *old;
+    bool requested;                 /* Drop queued for the audio thread */
+} cache_release_t;
+
+/**
+ * @brief Free retired caches that no voice plays from any more (control_lock held)
+ */
+static void cache_reap(ms_instrument_t *inst) {
+    note_cache_t **link = &inst->retired_caches;
+
+    while (*link) {
+        note_cache_t *cache = *link;
+        if (atomic_load_explicit(&cache->voices, memory_order_acquire) == 0) {
+            *link = cache->retired_next;
+            note_cache_destroy(cache);
+        } else {
+            link = &cache->retired_next;
+        }
+    }
+}
+
+/**
+ * @brief Whether no voice plays from the old cache, asking for a drop until one is queued
+ */
+static bool cache_released(void *ctx) {
+    cache_release_t *release = (cache_release_t*)ctx;
+
+    if (atomic_load_explicit(&release->old->voices, memory_order_acquire) == 0) {
+        return true;
+    }
+    if (!release->requested) {
+        release->requested = sampler_request_drop(release->instrument->sampler,
+                                                  RT_EVENT_CACHE_DROP, release->instrument);
+    }
+    return false;
+}
+
+/**
+ * @brief Publish a cache (or NULL) and free the one it replaces
+ *
+ * Voices on the old cache are moved off it by the audio thread. If the
+ * engine stops rendering meanwhile (sampler_wait_blocks), the old cache is
+ * retired rather than waited for: the queued drop (or the voices ending)
+ * empties it once rendering resumes.
+ */
+static void cache_swap(ms_instrument_t *inst, note_cache_t *cache) {
+    ms_sampler_t *sampler = inst->sampler;
+    note_cache_t *old = atomic_exchange(&inst->note_cache, cache);
+
+    pthread_mutex_lock(&sampler->control_lock);
+    cache_reap(inst);
+    pthread_mutex_unlock(&sampler->control_lock);
+    if (!old) return;
+
+    /* No note-on may still be attaching to the old cache... */
+    while (atomic_load(&inst->cache_busy)) {
+        sched_yield();
+    }
+
+    /* ...and voices on it go back to live resampling */
+    cache_release_t release = { .instrument = inst, .old = old, .requested = false };
+    if (!sampler_wait_blocks(sampler, cache_released, &release)) {
+        pthread_mutex_lock(&sampler->control_lock);
+        old->retired_next = inst->retired_caches;
+        inst->retired_caches = old;
+        pthread_mutex_unlock(&sampler->control_lock);
+        return;
+    }
+
+    note_cache_destroy(old);
+}
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+ms_error_t ms_instrument_build_note_cache(ms_instrument_t *instrument, const uint32_t *note_weights,
+                                         const ms_note_cache_config_t *config) {
+    if (!instrument || !instrument->sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    ms_note_cache_config_t cfg = {
+        .max_notes = CACHE_DEFAULT_NOTES,
+        .max_bytes = CACHE_DEFAULT_BYTES,
+        .threads = 0
+    };
+    if (config) {
+        cfg = *config;
+    }
+    if (cfg.max_notes == 0) cfg.max_notes = CACHE_DEFAULT_NOTES;
+    if (cfg.max_notes > 128) cfg.max_notes = 128;
+    if (cfg.max_bytes == 0) cfg.max_bytes = CACHE_DEFAULT_BYTES;
+    if (cfg.threads == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cfg.threads = cpus > 1 ? (uint32_t)cpus : 1;
+    }
+
+    /* Without weights, cache what has been played */
+    uint32_t weights[128];
+    for (int n = 0; n < 128; n++) {
+        weights[n] = note_weights ? note_weights[n] :
+                     atomic_load_explicit(&instrument->note_counts[n], memory_order_relaxed);
+    }
+
+    /* Zones under a memory budget must keep their bodies while they are read */
+    residency_lock(instrument->sampler);
+    note_cache_t *cache = cache_plan(instrument, weights, cfg.max_notes, cfg.max_bytes);
+    if (!cache) {
+        residency_unlock(instrument->sampler);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    cache_job_t job = { .entries = cache->entries, .num_entries = cache->num_entries };
+    atomic_init(&job.next, 0);
+
+    /* The calling thread renders too, so a failed thread start only costs time */
+    pthread_t workers[64];
+    uint32_t started = 0;
+    for (uint32_t i = 1; i < cfg.threads && i < 64 && i < cache->num_entries; i++) {
+        if (pthread_create(&workers[started], NULL, cache_worker, &job) == 0) {
+            started++;
+        }
+    }
+    cache_worker(&job);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    residency_unlock(instrument->sampler);
+
+    cache_swap(instrument, cache);
+    return MS_SUCCESS;
+}
+
+void ms_instrument_clear_note_cache(ms_instrument_t *instrument) {
+    if (!instrument) return;
+    cache_swap(instrument, NULL);
+}
+
+/* ============================================================================
+ * Audio Thread
+ * ========================================================================== */
+
+/**
+ * @brief Play a just-triggered voice from the cache if its note is there
+ */
+void note_cache_attach(ms_instrument_t *instrument, voice_t *voice) {
+    atomic_store(&instrument->cache_busy, true);
+
+    note_cache_t *cache = atomic_load(&instrument->note_cache);
+    if (cache) {
+        for (note_cache_entry_t *entry = cache->notes[voice->note]; entry; entry = entry->next) {
+            if (entry->source == voice->sample &&
+                fabs(voice->playback_speed - entry->speed) <= entry->speed * 1e-9) {
+                atomic_fetch_add_explicit(&cache->voices, 1, memory_order_relaxed);
+                voice->cached = entry;
+                break;
+            }
+        }
+    }
+
+    atomic_store_explicit(&instrument->cache_busy, false, memory_order_release);
+}
+
+/**
+ * @brief Apply an RT_EVENT_CACHE_DROP event
+ */
+void note_cache_drop(ms_sampler_t *sampler, ms_instrument_t *instrument) {
+    const note_cache_t *current = atomic_load_explicit(&instrument->note_cache,
+                                                       memory_order_acquire);
+
+    for (size_t i = 0; i < sampler->config.max_polyphony && i < MS_MAX_VOICES; i++) {
+        voice_t *voice = &sampler->voices[i];
+        if (voice->cached && voice->instrument == instrument && voice->cached->cache != current) {
+            voice_uncache(voice);
+        }
+    }
+}
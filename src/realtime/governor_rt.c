@@ -0,0 +1,192 @@
+/**
+ * @file governor_rt.c
+ * @brief Overload governor driven by measured DSP load
+ *
+ * Times every ms_process() call against the duration of the block it
+ * renders. When the smoothed load crosses high_load the governor moves one
+ * stage further (cheaper interpolation for quiet voices, retiring nearly
+ * silent voices, capping polyphony) and waits a few blocks for the effect
+ * to show before the next step. Stages are undone one at a time after the
+ * load has stayed below low_load for hold_ns.
+ */
+
+#include "internal/internal_rt.h"
+#include <math.h>
+#include <sched.h>
+#include <time.h>
+
+#define GOVERNOR_SMOOTHING 0.25f    /* Weight of the newest block in the load average */
+#define GOVERNOR_SETTLE_BLOCKS 4    /* Blocks to wait after escalating */
+#define GOVERNOR_PPM 1000000.0f
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+void governor_init(ms_sampler_t *sampler) {
+    governor_t *gov = &sampler->governor;
+
+    atomic_init(&gov->enabled, false);
+    atomic_init(&gov->busy, false);
+    atomic_init(&gov->shared_level, MS_GOVERNOR_NORMAL);
+    atomic_init(&gov->load_ppm, 0);
+    atomic_init(&gov->peak_load_ppm, 0);
+    atomic_init(&gov->escalations, 0);
+    atomic_init(&gov->retired_voices, 0);
+    atomic_init(&gov->capped_notes, 0);
+}
+
+ms_error_t ms_sampler_set_governor(ms_sampler_t *sampler, const ms_governor_config_t *config,
+                                   bool enable) {
+    if (!sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    ms_governor_config_t cfg = {
+        .high_load = 0.8f,
+        .low_load = 0.5f,
+        .hold_ms = 500.0f,
+        .quiet_db = -40.0f,
+        .retire_db = -60.0f,
+        .polyphony_cap = 0
+    };
+    if (config) {
+        cfg = *config;
+    }
+    if (cfg.polyphony_cap == 0) {
+        cfg.polyphony_cap = sampler->config.max_polyphony > 1 ? sampler->config.max_polyphony / 2 : 1;
+    }
+
+    if (cfg.low_load < 0.0f || cfg.high_load <= cfg.low_load || cfg.hold_ms < 0.0f ||
+        cfg.retire_db > cfg.quiet_db) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    governor_t *gov = &sampler->governor;
+
+    /* Wait until the audio thread is outside the governor */
+    atomic_store(&gov->enabled, false);
+    while (atomic_load(&gov->busy)) {
+        sched_yield();
+    }
+
+    gov->level = MS_GOVERNOR_NORMAL;
+    gov->load = 0.0f;
+    gov->calm_ns = 0;
+    gov->settle = 0;
+    atomic_store_explicit(&gov->shared_level, MS_GOVERNOR_NORMAL, memory_order_relaxed);
+    atomic_store_explicit(&gov->load_ppm, 0, memory_order_relaxed);
+
+    if (!enable) {
+        return MS_SUCCESS;
+    }
+
+    gov->high_load = cfg.high_load;
+    gov->low_load = cfg.low_load;
+    gov->hold_ns = (uint64_t)(cfg.hold_ms * 1000000.0f);
+    gov->quiet_level = db_to_linear(cfg.quiet_db);
+    gov->retire_level = db_to_linear(cfg.retire_db);
+    gov->polyphony_cap = cfg.polyphony_cap;
+
+    atomic_store_explicit(&gov->enabled, true, memory_order_release);
+    return MS_SUCCESS;
+}
+
+/* ============================================================================
+ * Audio Thread
+ * ========================================================================== */
+
+/**
+ * @brief Enter a block; returns true if the governor is timing it
+ */
+bool governor_begin(ms_sampler_t *sampler) {
+    governor_t *gov = &sampler->governor;
+
+    gov->degrade = MS_GOVERNOR_NORMAL;
+    atomic_store(&gov->busy, true);
+    if (LIKELY(!atomic_load(&gov->enabled))) {
+        atomic_store_explicit(&gov->busy, false, memory_order_release);
+        return false;
+    }
+
+    gov->degrade = gov->level;
+    gov->block_start_ns = ms_now_ns();
+    return true;
+}
+
+/**
+ * @brief Leave a governed block: account its load and pick the next stage
+ */
+void governor_end(ms_sampler_t *sampler, size_t num_frames) {
+    governor_t *gov = &sampler->governor;
+    const uint64_t elapsed = ms_now_ns() - gov->block_start_ns;
+    const uint64_t period = (uint64_t)(num_frames * 1e9 / sampler->config.sample_rate);
+
+    if (LIKELY(period > 0)) {
+        const float load = (float)elapsed / (float)period;
+        gov->load += (load - gov->load) * GOVERNOR_SMOOTHING;
+
+        const uint32_t load_ppm = (uint32_t)(load * GOVERNOR_PPM);
+        if (load_ppm > atomic_load_explicit(&gov->peak_load_ppm, memory_order_relaxed)) {
+            atomic_store_explicit(&gov->peak_load_ppm, load_ppm, memory_order_relaxed);
+        }
+        atomic_store_explicit(&gov->load_ppm, (uint32_t)(gov->load * GOVERNOR_PPM),
+                              memory_order_relaxed);
+
+        if (gov->settle > 0) {
+            gov->settle--;
+        } else if (gov->load > gov->high_load) {
+            gov->calm_ns = 0;
+            if (gov->level < MS_GOVERNOR_CAP_POLYPHONY) {
+                if (gov->level == MS_GOVERNOR_NORMAL) {
+                    atomic_fetch_add_explicit(&gov->escalations, 1, memory_order_relaxed);
+                }
+                gov->level++;
+                gov->settle = GOVERNOR_SETTLE_BLOCKS;
+            }
+        } else if (gov->load < gov->low_load && gov->level > MS_GOVERNOR_NORMAL) {
+            gov->calm_ns += period;
+            if (gov->calm_ns >= gov->hold_ns) {
+                gov->level--;
+                gov->calm_ns = 0;
+            }
+        } else {
+            gov->calm_ns = 0;  /* Between thresholds: hold the current stage */
+        }
+
+        atomic_store_explicit(&gov->shared_level, gov->level, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&gov->busy, false, memory_order_release);
+}
+
+/**
+ * @brief Pick the voice a note-on must steal because of the polyphony cap
+ *
+ * @return Quietest sounding voice if the cap is reached, NULL otherwise
+ */
+voice_t *governor_cap_voice(ms_sampler_t *sampler) {
+    governor_t *gov = &sampler->governor;
+    voice_t *quietest = NULL;
+    float quietest_level = 2.0f;
+    size_t active = 0;
+
+    for (size_t i = 0; i < sampler->config.max_polyphony && i < MS_MAX_VOICES; i++) {
+        voice_t *voice = &sampler->voices[i];
+        if (!voice->active) continue;
+
+        active++;
+        const float level = voice_level(voice);
+        if (level < quietest_level) {
+            quietest_level = level;
+            quietest = voice;
+        }
+    }
+
+    if (active < gov->polyphony_cap) {
+        return NULL;
+    }
+
+    atomic_fetch_add_explicit(&gov->capped_notes, 1, memory_order_relaxed);
+    return quietest;
+}
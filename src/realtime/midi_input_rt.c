@@ -0,0 +1,206 @@
+/**
+ * @file midi_input_rt.c
+ * @brief Allocation-free parser for live MIDI byte streams
+ *
+ * Turns raw bytes from ALSA raw-MIDI, a serial port or a socket straight
+ * into lock-free queue events. The parser is a small state machine over
+ * single bytes, so messages may be split anywhere between calls:
+ * - Real-time bytes (0xF8-0xFF) are dropped wherever they appear, without
+ *   touching running status or a message in progress
+ * - SysEx is skipped up to 0xF7 (or any other status byte)
+ * - System common messages cancel running status, as the spec requires
+ *
+ * In MPE mode (lower zone) the member channels carry one note each; their
+ * pitch bend, channel pressure and CC74 become per-note expression events.
+ */
+
+#include "internal/internal_rt.h"
+#include <string.h>
+
+#define SCHEDULE_HORIZON_SECONDS 10  /* Furthest ahead a stamped event may be due */
+
+/** Data bytes taken by each channel message (indexed by status >> 4) */
+static const uint8_t channel_data_bytes[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 1, 1, 2, 0      /* 8x 9x Ax Bx Cx Dx Ex */
+};
+
+/** Data bytes taken by system common messages 0xF1-0xF6 */
+static uint8_t system_common_data_bytes(uint8_t status) {
+    switch (status) {
+        case 0xF1: return 1;    /* MTC quarter frame */
+        case 0xF2: return 2;    /* Song position */
+        case 0xF3: return 1;    /* Song select */
+        default: return 0;      /* Tune request, undefined */
+    }
+}
+
+void ms_midi_input_init(ms_midi_input_t *input, ms_sampler_t *sampler) {
+    if (!input) return;
+
+    memset(input, 0, sizeof(*input));
+    input->sampler = sampler;
+}
+
+ms_error_t ms_midi_input_set_mpe(ms_midi_input_t *input, uint8_t member_channels,
+                                  float bend_range) {
+    if (!input || member_channels >= MS_MIDI_CHANNELS || bend_range < 0.0f) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    
+    input->mpe_members = member_channels;
+    input->mpe_bend_range = bend_range > 0.0f ? bend_range : 48.0f;
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_midi_input_set_instrument(ms_midi_input_t *input, int channel,
+                                        ms_instrument_t *instrument) {
+    if (!input || channel < -1 || channel >= MS_MIDI_CHANNELS) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    if (channel < 0) {
+        for (int ch = 0; ch < MS_MIDI_CHANNELS; ch++) {
+            input->channels[ch] = instrument;
+        }
+    } else {
+        input->channels[channel] = instrument;
+    }
+
+    return MS_SUCCESS;
+}
+
+/**
+ * @brief Queue a complete channel message
+ *
+ * @param accept false to count the event as dropped instead of queueing it
+ * @return true if an event was queued
+ */
+static FORCE_INLINE bool midi_input_emit(ms_midi_input_t *input, uint32_t timestamp,
+                                         bool accept) {
+    const uint8_t channel = input->status & 0x0F;
+    ms_instrument_t *inst = input->channels[channel];
+    if (!inst) return false;
+
+    /* Lower zone: channel 0 is the master, 1..mpe_members carry single notes */
+    const bool member = channel >= 1 && channel <= input->mpe_members;
+
+    rt_event_t event = {
+        .timestamp = timestamp,
+        .channel = member ? (uint8_t)(channel + 1) : 0,
+        .instrument = inst
+    };
+
+    switch (input->status & 0xF0) {
+        case 0x90:
+            event.note = input->data[0];
+            event.velocity = input->data[1];
+            event.event_type = input->data[1] ? RT_EVENT_NOTE_ON : RT_EVENT_NOTE_OFF;
+            break;
+        case 0x80:
+            event.note = input->data[0];
+            event.event_type = RT_EVENT_NOTE_OFF;
+            break;
+        case 0xE0:
+            if (member) {
+                const int bend = ((input->data[1] << 7) | input->data[0]) - 8192;
+                event.value = bend * (1.0f / 8192.0f) * input->mpe_bend_range;
+                event.event_type = RT_EVENT_NOTE_PITCH;
+                break;
+            }
+            event.note = input->data[0];        /* LSB */
+            event.velocity = input->data[1];    /* MSB */
+            event.event_type = RT_EVENT_PITCH_BEND;
+            break;
+        case 0xD0:
+            if (!member) return false;
+            event.value = input->data[0] * (1.0f / 127.0f);
+            event.event_type = RT_EVENT_NOTE_PRESSURE;
+            break;
+        case 0xB0:
+            if (!member || input->data[0] != 74) return false;
+            event.value = input->data[1] * (1.0f / 127.0f);
+            event.event_type = RT_EVENT_NOTE_TIMBRE;
+            break;
+        default:
+            return false;  /* Other aftertouch, CC, program change: not used yet */
+    }
+
+    if (UNLIKELY(!accept || !rt_queue_push(&input->sampler->event_queue, &event))) {
+        input->dropped++;
+        return false;
+    }
+
+    input->events++;
+    return true;
+}
+
+size_t ms_midi_input_feed(ms_midi_input_t *input, const uint8_t *bytes, size_t length,
+                          uint64_t frame) {
+    if (UNLIKELY(!input || !input->sampler || !bytes)) {
+        return 0;
+    }
+
+    /* Timestamps are compared modulo 2^32, so keep them well short of that */
+    const uint64_t now = atomic_load_explicit(&input->sampler->frames_processed,
+                                              memory_order_relaxed);
+    const uint64_t horizon = (uint64_t)SCHEDULE_HORIZON_SECONDS *
+                             input->sampler->config.sample_rate;
+    if (frame == 0) {
+        frame = now;
+    }
+    const bool accept = frame <= now || frame - now <= horizon;
+    const uint32_t timestamp = (uint32_t)frame;
+
+    size_t queued = 0;
+    for (size_t i = 0; i < length; i++) {
+        const uint8_t byte = bytes[i];
+
+        if (byte & 0x80) {
+            if (byte >= 0xF8) {
+                continue;  /* Real-time: clock, start/stop, active sensing, ... */
+            }
+
+            input->in_sysex = (byte == 0xF0);
+            input->count = 0;
+
+            if (byte >= 0xF0) {
+                /* SysEx and system common cancel running status */
+                input->status = 0;
+                input->needed = 0;
+
+                uint8_t needed = system_common_data_bytes(byte);
+                if (needed > 0) {
+                    input->status = byte;
+                    input->needed = needed;
+                }
+            } else {
+                input->status = byte;
+                input->needed = channel_data_bytes[byte >> 4];
+            }
+            continue;
+        }
+
+        /* Data byte */
+        if (input->in_sysex || input->status == 0) {
+            continue;
+        }
+
+        input->data[input->count++] = byte;
+        if (input->count < input->needed) {
+            continue;
+        }
+
+        input->count = 0;
+        if (input->status >= 0xF0) {
+            input->status = 0;  /* System common has no running status */
+            continue;
+        }
+
+        if (midi_input_emit(input, timestamp, accept)) {
+            queued++;
+        }
+    }
+
+    return queued;
+}
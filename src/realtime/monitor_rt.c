@@ -0,0 +1,258 @@
+/**
+ * @file monitor_rt.c
+ * @brief Live statistics in shared memory for external monitors
+ *
+ * The audio thread keeps a snapshot of its own counters, adds the block
+ * it just rendered and copies the result into a POSIX shared memory
+ * object under a sequence lock. The object is locked in memory when it
+ * is created, so publishing costs a clock read, a few loads and a
+ * ~300-byte copy per block: no system call and no wait. Readers in other
+ * processes poll it as often as they like and retry a copy that raced a
+ * write.
+ */
+
+#include "internal/internal_rt.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MONITOR_READ_RETRIES 10000  /* A block is written in microseconds */
+
+struct ms_monitor_t {
+    const monitor_segment_t *segment;
+};
+
+/* ============================================================================
+ * Audio Thread
+ * ========================================================================== */
+
+/**
+ * @brief Enter a monitored block (false, and nothing to do, when not publishing)
+ */
+bool monitor_begin(ms_sampler_t *sampler) {
+    monitor_t *monitor = &sampler->monitor;
+
+    atomic_store(&monitor->busy, true);
+    if (LIKELY(!atomic_load(&monitor->segment))) {
+        atomic_store_explicit(&monitor->busy, false, memory_order_release);
+        return false;
+    }
+
+    monitor->block_start_ns = ms_now_ns();
+
+    const rt_event_queue_t *queue = &sampler->event_queue;
+    const uint32_t depth = (atomic_load_explicit(&queue->write_idx, memory_order_relaxed) -
+                            atomic_load_explicit(&queue->read_idx, memory_order_relaxed) +
+                            RT_EVENT_QUEUE_SIZE) % RT_EVENT_QUEUE_SIZE;
+    monitor->local.event_queue_depth = depth;
+    if (depth > monitor->local.event_queue_peak) {
+        monitor->local.event_queue_peak = depth;
+    }
+    return true;
+}
+
+/**
+ * @brief Leave a monitored block: account it and publish the snapshot
+ */
+void monitor_end(ms_sampler_t *sampler, size_t num_frames) {
+    monitor_t *monitor = &sampler->monitor;
+    ms_monitor_snapshot_t *local = &monitor->local;
+    const uint64_t now = ms_now_ns();
+    const uint64_t period = (uint64_t)(num_frames * 1e9 / sampler->config.sample_rate);
+
+    if (LIKELY(period > 0)) {
+        const uint64_t elapsed = now - monitor->block_start_ns;
+        const float load = (float)elapsed / (float)period;
+        local->busy_ns += elapsed;
+        local->period_ns += period;
+        size_t bin = (size_t)(load * 10.0f);
+        if (bin >= MS_MONITOR_LOAD_BINS) {
+            bin = MS_MONITOR_LOAD_BINS - 1;
+        }
+        local->load_histogram[bin]++;
+        local->dsp_load = load;
+        if (load > local->dsp_peak_load) {
+            local->dsp_peak_load = load;
+        }
+    }
+
+    local->updates++;
+    local->timestamp_ns = now;
+    local->frames_processed = atomic_load_explicit(&sampler->frames_processed,
+                                                   memory_order_relaxed) + num_frames;
+    local->xruns = atomic_load_explicit(&sampler->xruns, memory_order_relaxed);
+    local->active_voices = sampler->active_voices;
+    local->voices_stolen = atomic_load_explicit(&sampler->voices_stolen, memory_order_relaxed);
+
+    const stream_engine_t *engine = &sampler->streamer;
+    uint64_t underruns = 0;
+    for (size_t i = 0; i < engine->num_voices && engine->voices; i++) {
+        underruns += atomic_load_explicit(&engine->voices[i].underruns, memory_order_relaxed);
+    }
+    local->stream_underruns = underruns;
+    local->preload_bytes = atomic_load_explicit(&engine->preload_bytes, memory_order_relaxed);
+    local->resident_bytes = atomic_load_explicit(&sampler->residency.resident_bytes,
+                                                 memory_order_relaxed);
+
+    /* Odd sequence while the copy is in flight */
+    monitor_segment_t *segment = atomic_load_explicit(&monitor->segment, memory_order_relaxed);
+    const unsigned sequence = atomic_load_explicit(&segment->sequence, memory_order_relaxed);
+    atomic_store_explicit(&segment->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&segment->data, local, sizeof(*local));
+    atomic_store_explicit(&segment->sequence, sequence + 2, memory_order_release);
+
+    atomic_store_explicit(&monitor->busy, false, memory_order_release);
+}
+
+/* ============================================================================
+ * Control Thread
+ * ========================================================================== */
+
+/**
+ * @brief Stop publishing and remove the object (no-op if not publishing)
+ */
+void monitor_shutdown(ms_sampler_t *sampler) {
+    monitor_t *monitor = &sampler->monitor;
+    monitor_segment_t *segment = atomic_exchange(&monitor->segment, NULL);
+    if (!segment) return;
+
+    while (atomic_load(&monitor->busy)) {
+        sched_yield();
+    }
+
+    munmap(segment, sizeof(monitor_segment_t));
+    shm_unlink(monitor->name);
+    free(monitor->name);
+    monitor->name = NULL;
+}
+
+ms_error_t ms_sampler_publish_stats(ms_sampler_t *sampler, const char *name) {
+    if (!sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    monitor_shutdown(sampler);
+    if (!name) {
+        return MS_SUCCESS;
+    }
+
+    char *copy = strdup(name);
+    if (!copy) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    const int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        free(copy);
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    monitor_segment_t *segment = MAP_FAILED;
+    if (ftruncate(fd, sizeof(monitor_segment_t)) == 0) {
+        segment = (monitor_segment_t*)mmap(NULL, sizeof(monitor_segment_t),
+                                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           fd, 0);
+    }
+    close(fd);
+    if (segment == MAP_FAILED) {
+        shm_unlink(name);
+        free(copy);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* The audio thread must not fault on it; best effort like the voice memory */
+    mlock(segment, sizeof(monitor_segment_t));
+
+    monitor_t *monitor = &sampler->monitor;
+    memset(&monitor->local, 0, sizeof(monitor->local));
+    monitor->local.pid = (int32_t)getpid();
+    monitor->local.sample_rate = sampler->config.sample_rate;
+    monitor->local.max_polyphony = sampler->config.max_polyphony;
+    monitor->name = copy;
+
+    memset(segment, 0, sizeof(*segment));
+    segment->size = sizeof(monitor_segment_t);
+    atomic_init(&segment->sequence, 0);
+    segment->data = monitor->local;
+    atomic_thread_fence(memory_order_release);
+    memcpy(segment->magic, MS_MONITOR_MAGIC, 8);
+
+    atomic_store_explicit(&monitor->segment, segment, memory_order_release);
+    return MS_SUCCESS;
+}
+
+/* ============================================================================
+ * Readers (other processes)
+ * ========================================================================== */
+
+ms_error_t ms_monitor_open(const char *name, ms_monitor_t **monitor) {
+    if (!name || !monitor) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    struct stat st;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(monitor_segment_t)) {
+        mapping = mmap(NULL, sizeof(monitor_segment_t), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return MS_ERROR_INVALID_FORMAT;
+    }
+
+    const monitor_segment_t *segment = (const monitor_segment_t*)mapping;
+    if (memcmp(segment->magic, MS_MONITOR_MAGIC, 8) != 0 ||
+        segment->size != sizeof(monitor_segment_t)) {
+        munmap(mapping, sizeof(monitor_segment_t));
+        return MS_ERROR_INVALID_FORMAT;
+    }
+
+    ms_monitor_t *m = (ms_monitor_t*)malloc(sizeof(ms_monitor_t));
+    if (!m) {
+        munmap(mapping, sizeof(monitor_segment_t));
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    m->segment = segment;
+    *monitor = m;
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_monitor_read(const ms_monitor_t *monitor, ms_monitor_snapshot_t *snapshot) {
+    if (!monitor || !snapshot) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    /* A publisher that died mid-write leaves the sequence odd for good */
+    monitor_segment_t *segment = (monitor_segment_t*)monitor->segment;
+    for (unsigned attempt = 0; attempt < MONITOR_READ_RETRIES; attempt++) {
+        const unsigned before = atomic_load_explicit(&segment->sequence, memory_order_acquire);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(snapshot, &segment->data, sizeof(*snapshot));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&segment->sequence, memory_order_relaxed) == before) {
+            return MS_SUCCESS;
+        }
+    }
+
+    return MS_ERROR_UNKNOWN;
+}
+
+void ms_monitor_close(ms_monitor_t *monitor) {
+    if (!monitor) return;
+
+    munmap((void*)monitor->segment, sizeof(monitor_segment_t));
+    free(monitor);
+}
@@ -0,0 +1,469 @@
+/**
+ * @file preprocess_rt.c
+ * @brief Load-time sample preprocessing and parallel bulk loading
+ *
+ * Every file loaded into RAM goes through the same chain of stages:
+ * decode, channel conversion, resampling to the engine rate, silence
+ * trimming, DC removal, peak normalization and the guard-padded playback
+ * layout. Stages the sampler's configuration leaves off cost nothing.
+ * Bulk loads run whole files through the chain on a pool of threads; the
+ * time spent in each stage is accumulated per sampler. With a sample cache
+ * set, the chain only runs for files not processed before.
+ */
+
+#include "internal/internal_rt.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PREPROCESS_MAX_THREADS 64
+#define PREPROCESS_PI 3.14159265358979323846
+#define SINC_HALF_TAPS 16           /* Per side at unity step, widened when downsampling */
+
+typedef struct {
+    ms_sample_data_t *sample;
+    float *pcm;                     /* Interleaved, channels * num_frames */
+    size_t num_frames;
+    uint16_t channels;
+    uint32_t sample_rate;
+} pcm_buffer_t;
+
+/* ============================================================================
+ * Resampling
+ * ========================================================================== */
+
+/**
+ * @brief Blackman-windowed sinc resampling of one channel
+ *
+ * Output frame j is taken at source position j * step. The cutoff follows
+ * the step when downsampling so the result does not alias.
+ */
+void sinc_resample(const float *src, size_t src_frames, size_t src_stride, double step,
+                   float *dst, size_t dst_frames, size_t dst_stride) {
+    const double cutoff = step > 1.0 ? 1.0 / step : 1.0;
+    const long half = (long)ceil(SINC_HALF_TAPS / cutoff);
+    const long num_source = (long)src_frames;
+
+    for (size_t j = 0; j < dst_frames; j++) {
+        const double position = j * step;
+        const long center = (long)position;
+        const double frac = position - center;
+        double acc = 0.0;
+        double weight_sum = 0.0;
+
+        for (long k = -half + 1; k <= half; k++) {
+            const double x = k - frac;
+            const double t = (x + half) / (2.0 * half);
+            const double window = 0.42 - 0.5 * cos(2.0 * PREPROCESS_PI * t) +
+                                  0.08 * cos(4.0 * PREPROCESS_PI * t);
+            const double arg = PREPROCESS_PI * x * cutoff;
+            const double weight = (fabs(arg) < 1e-9 ? 1.0 : sin(arg) / arg) * window;
+
+            const long index = center + k;
+            if (index >= 0 && index < num_source) {
+                acc += weight * src[index * src_stride];
+            }
+            weight_sum += weight;
+        }
+
+        dst[j * dst_stride] = (float)(weight_sum != 0.0 ? acc / weight_sum : 0.0);
+    }
+}
+
+/* ============================================================================
+ * Stages
+ * ========================================================================== */
+
+static ms_error_t stage_decode(const char *filepath, pcm_buffer_t *buf) {
+    wav_info_t info;
+    ms_error_t err = wav_probe_file(filepath, &info);
+    if (err != MS_SUCCESS) {
+        return err;
+    }
+
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    const size_t count = info.num_frames * info.channels;
+    const size_t bytes = count * (info.bits_per_sample / 8);
+    void *raw = malloc(bytes ? bytes : 1);
+    buf->pcm = (float*)malloc((count ? count : 1) * sizeof(float));
+    if (!raw || !buf->pcm) {
+        free(raw);
+        fclose(fp);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    if (fseek(fp, (long)info.data_offset, SEEK_SET) != 0 || fread(raw, 1, bytes, fp) != bytes) {
+        err = MS_ERROR_INVALID_FORMAT;
+    } else {
+        wav_pcm_to_float(raw, info.bits_per_sample, buf->pcm, count);
+    }
+
+    free(raw);
+    fclose(fp);
+    buf->num_frames = info.num_frames;
+    buf->channels = info.channels;
+    buf->sample_rate = info.sample_rate;
+    return err;
+}
+
+/**
+ * @brief Downmix to mono (the voice kernel plays the first channel only)
+ */
+static void stage_convert(pcm_buffer_t *buf) {
+    const size_t channels = buf->channels;
+    if (channels <= 1) return;
+
+    for (size_t i = 0; i < buf->num_frames; i++) {
+        float sum = 0.0f;
+        for (size_t c = 0; c < channels; c++) {
+            sum += buf->pcm[i * channels + c];
+        }
+        buf->pcm[i] = sum / (float)channels;
+    }
+    buf->channels = 1;
+}
+
+static ms_error_t stage_resample(pcm_buffer_t *buf, uint32_t target_rate) {
+    if (buf->sample_rate == 0 || buf->sample_rate == target_rate || buf->num_frames == 0) {
+        return MS_SUCCESS;
+    }
+
+    const double step = (double)buf->sample_rate / target_rate;
+    const size_t frames = (size_t)ceil(buf->num_frames / step);
+    float *out = (float*)malloc(frames * buf->channels * sizeof(float));
+    if (!out) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (size_t c = 0; c < buf->channels; c++) {
+        sinc_resample(buf->pcm + c, buf->num_frames, buf->channels, step,
+                      out + c, frames, buf->channels);
+    }
+
+    ms_sample_metadata_t *meta = &buf->sample->meta;
+    meta->loop_start = (uint32_t)llround(meta->loop_start / step);
+    meta->loop_end = (uint32_t)llround(meta->loop_end / step);
+
+    free(buf->pcm);
+    buf->pcm = out;
+    buf->num_frames = frames;
+    buf->sample_rate = target_rate;
+    return MS_SUCCESS;
+}
+
+static void stage_remove_dc(pcm_buffer_t *buf) {
+    const size_t channels = buf->channels;
+    if (buf->num_frames == 0) return;
+
+    for (size_t c = 0; c < channels; c++) {
+        double sum = 0.0;
+        for (size_t i = 0; i < buf->num_frames; i++) {
+            sum += buf->pcm[i * channels + c];
+        }
+        const float mean = (float)(sum / buf->num_frames);
+        for (size_t i = 0; i < buf->num_frames; i++) {
+            buf->pcm[i * channels + c] -= mean;
+        }
+    }
+}
+
+static bool frame_louder(const pcm_buffer_t *buf, size_t frame, float threshold) {
+    for (size_t c = 0; c < buf->channels; c++) {
+        if (fabsf(buf->pcm[frame * buf->channels + c]) > threshold) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Cut leading silence and the near-silent tail
+ *
+ * Loops are kept whole: the lead is never cut past loop_start and the
+ * tail never before loop_end. A cut tail gets a short linear fade, which
+ * never reaches into the loop; a tail cut right at loop_end is not faded.
+ */
+static void stage_trim(pcm_buffer_t *buf, const ms_preprocess_config_t *cfg) {
+    ms_sample_metadata_t *meta = &buf->sample->meta;
+    const bool looped = meta->loop_enabled && meta->loop_end > meta->loop_start;
+    size_t start = 0;
+    size_t end = buf->num_frames;
+
+    if (cfg->trim_silence) {
+        const float threshold = db_to_linear(cfg->trim_db);
+        while (start < end && !frame_louder(buf, start, threshold)) start++;
+        if (looped && start > meta->loop_start) start = meta->loop_start;
+    }
+
+    if (cfg->trim_tail) {
+        const float threshold = db_to_linear(cfg->tail_db);
+        size_t last = end;
+        while (last > start && !frame_louder(buf, last - 1, threshold)) last--;
+
+        const size_t fade = (size_t)(cfg->tail_fade_ms * 0.001f * buf->sample_rate);
+        size_t cut = last + fade < end ? last + fade : end;
+        size_t fade_start = last;
+        if (looped && cut < meta->loop_end) cut = meta->loop_end;
+        if (looped && fade_start < meta->loop_end) fade_start = meta->loop_end;
+
+        if (cut < end) {
+            for (size_t i = fade_start; i < cut; i++) {
+                const float g = (float)(cut - i) / (float)(cut - fade_start + 1);
+                for (size_t c = 0; c < buf->channels; c++) {
+                    buf->pcm[i * buf->channels + c] *= g;
+                }
+            }
+            end = cut;
+        }
+    }
+
+    if (start > 0) {
+        memmove(buf->pcm, buf->pcm + start * buf->channels,
+                (end - start) * buf->channels * sizeof(float));
+        meta->loop_start = meta->loop_start > start ? (uint32_t)(meta->loop_start - start) : 0;
+        meta->loop_end = meta->loop_end > start ? (uint32_t)(meta->loop_end - start) : 0;
+    }
+    buf->num_frames = end - start;
+}
+
+static void stage_normalize(pcm_buffer_t *buf, float target_db) {
+    const size_t count = buf->num_frames * buf->channels;
+    float peak = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const float a = fabsf(buf->pcm[i]);
+        if (a > peak) peak = a;
+    }
+    if (peak <= 0.0f) return;
+
+    const float gain = db_to_linear(target_db) / peak;
+    for (size_t i = 0; i < count; i++) {
+        buf->pcm[i] *= gain;
+    }
+}
+
+/* ============================================================================
+ * Pipeline
+ * ========================================================================== */
+
+static FORCE_INLINE void stage_done(ms_sampler_t *sampler, ms_preprocess_stage_t stage,
+                                    uint64_t *t) {
+    const uint64_t now = ms_now_ns();
+    atomic_fetch_add_explicit(&sampler->preprocess_ns[stage], now - *t, memory_order_relaxed);
+    *t = now;
+}
+
+static ms_error_t preprocess_load(ms_sampler_t *sampler, const char *filepath,
+                                  const ms_sample_metadata_t *metadata, ms_sample_data_t **sample) {
+    const ms_preprocess_config_t *cfg = &sampler->preprocess;
+    uint64_t t = ms_now_ns();
+
+    uint64_t key = 0;
+    const bool cached = sampler->sample_cache_dir != NULL;
+    if (cached) {
+        const bool hit = sample_cache_lookup(sampler, filepath, metadata, &key, sample);
+        stage_done(sampler, MS_PREPROCESS_CACHE, &t);
+        if (hit) {
+            return MS_SUCCESS;
+        }
+    }
+
+    ms_sample_data_t *s = (ms_sample_data_t*)aligned_alloc(MS_CACHE_LINE_SIZE,
+                                                           sizeof(ms_sample_data_t));
+    if (!s) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    memset(s, 0, sizeof(*s));
+    s->meta = *metadata;
+
+    pcm_buffer_t buf = { .sample = s };
+    ms_error_t err = stage_decode(filepath, &buf);
+    stage_done(sampler, MS_PREPROCESS_DECODE, &t);
+    const size_t frames_in = buf.num_frames;
+
+    if (err == MS_SUCCESS && cfg->downmix) {
+        stage_convert(&buf);
+        stage_done(sampler, MS_PREPROCESS_CONVERT, &t);
+    }
+    if (err == MS_SUCCESS && cfg->resample) {
+        err = stage_resample(&buf, (uint32_t)sampler->config.sample_rate);
+        stage_done(sampler, MS_PREPROCESS_RESAMPLE, &t);
+    }
+    if (err == MS_SUCCESS && (cfg->trim_silence || cfg->trim_tail)) {
+        stage_trim(&buf, cfg);
+        stage_done(sampler, MS_PREPROCESS_TRIM, &t);
+    }
+    if (err == MS_SUCCESS && cfg->remove_dc) {
+        stage_remove_dc(&buf);
+        stage_done(sampler, MS_PREPROCESS_DC, &t);
+    }
+    if (err == MS_SUCCESS && cfg->normalize) {
+        stage_normalize(&buf, cfg->normalize_db);
+        stage_done(sampler, MS_PREPROCESS_NORMALIZE, &t);
+    }
+    if (err == MS_SUCCESS) {
+        s->channels = buf.channels;
+        err = sample_layout(s, buf.pcm, buf.num_frames);
+        stage_done(sampler, MS_PREPROCESS_LAYOUT, &t);
+    }
+
+    free(buf.pcm);
+    if (err != MS_SUCCESS) {
+        free(s);
+        return err;
+    }
+
+    if (cached) {
+        sample_cache_store(sampler, key, s);
+        stage_done(sampler, MS_PREPROCESS_CACHE, &t);
+    }
+
+    atomic_fetch_add_explicit(&sampler->preprocess_files, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sampler->preprocess_frames_in, frames_in, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sampler->preprocess_frames_out, s->num_frames,
+                              memory_order_relaxed);
+    *sample = s;
+    return MS_SUCCESS;
+}
+
+/**
+ * @brief Load one file through the sampler's preprocessing chain
+ *
+ * @param sample Output zone, allocated here (data in the playback layout)
+ */
+ms_error_t preprocess_load_file(ms_sampler_t *sampler, const char *filepath,
+                                const ms_sample_metadata_t *metadata, ms_sample_data_t **sample) {
+    MS_TRACE2(load_start, sampler, filepath);
+    const ms_error_t err = preprocess_load(sampler, filepath, metadata, sample);
+    MS_TRACE4(load_end, sampler, filepath, err, err == MS_SUCCESS ? (*sample)->num_frames : 0);
+    return err;
+}
+
+typedef struct {
+    ms_sampler_t *sampler;
+    const char *const *filepaths;
+    const ms_sample_metadata_t *metadata;
+    ms_sample_data_t **samples;
+    ms_error_t *errors;
+    size_t count;
+    atomic_size_t next;
+} bulk_job_t;
+
+static void *bulk_worker(void *arg) {
+    bulk_job_t *job = (bulk_job_t*)arg;
+
+    for (;;) {
+        const size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) break;
+        job->errors[i] = preprocess_load_file(job->sampler, job->filepaths[i], &job->metadata[i],
+                                              &job->samples[i]);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+ms_error_t ms_sampler_set_preprocess(ms_sampler_t *sampler, const ms_preprocess_config_t *config) {
+    if (!sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    if (!config) {
+        memset(&sampler->preprocess, 0, sizeof(sampler->preprocess));
+        return MS_SUCCESS;
+    }
+    if (config->tail_fade_ms < 0.0f) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    sampler->preprocess = *config;
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_instrument_load_samples(ms_instrument_t *instrument, const char *const *filepaths,
+                                      const ms_sample_metadata_t *metadata, size_t count) {
+    if (!instrument || !instrument->sampler || (count && (!filepaths || !metadata))) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    if (instrument->num_samples + count > MS_MAX_SAMPLES_PER_INSTRUMENT) {
+        return MS_ERROR_BUFFER_OVERFLOW;
+    }
+    if (count == 0) {
+        return MS_SUCCESS;
+    }
+
+    ms_sample_data_t *samples[MS_MAX_SAMPLES_PER_INSTRUMENT] = { NULL };
+    ms_error_t errors[MS_MAX_SAMPLES_PER_INSTRUMENT];
+    bulk_job_t job = {
+        .sampler = instrument->sampler,
+        .filepaths = filepaths,
+        .metadata = metadata,
+        .samples = samples,
+        .errors = errors,
+        .count = count
+    };
+    atomic_init(&job.next, 0);
+
+    uint32_t threads = instrument->sampler->preprocess.threads;
+    if (threads == 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 1 ? (uint32_t)cpus : 1;
+    }
+
+    /* The calling thread works too, so a failed thread start only costs time */
+    pthread_t workers[PREPROCESS_MAX_THREADS];
+    uint32_t started = 0;
+    for (uint32_t i = 1; i < threads && i < PREPROCESS_MAX_THREADS && i < count; i++) {
+        if (pthread_create(&workers[started], NULL, bulk_worker, &job) == 0) {
+            started++;
+        }
+    }
+    bulk_worker(&job);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    /* All or nothing, in the given order */
+    ms_error_t err = MS_SUCCESS;
+    for (size_t i = 0; i < count && err == MS_SUCCESS; i++) {
+        err = errors[i];
+    }
+    if (err != MS_SUCCESS) {
+        for (size_t i = 0; i < count; i++) {
+            if (errors[i] == MS_SUCCESS) {
+                sample_data_free(samples[i]);
+                free(samples[i]);
+            }
+        }
+        return err;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        residency_register(instrument->sampler, samples[i], filepaths[i], &metadata[i]);
+        instrument->samples[instrument->num_samples++] = samples[i];
+    }
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_sampler_get_preprocess_stats(const ms_sampler_t *sampler,
+                                           ms_preprocess_stats_t *stats) {
+    if (!sampler || !stats) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < MS_PREPROCESS_STAGES; i++) {
+        stats->stage_ns[i] = atomic_load_explicit(&sampler->preprocess_ns[i], memory_order_relaxed);
+    }
+    stats->files = atomic_load_explicit(&sampler->preprocess_files, memory_order_relaxed);
+    stats->frames_in = atomic_load_explicit(&sampler->preprocess_frames_in, memory_order_relaxed);
+    stats->frames_out = atomic_load_explicit(&sampler->preprocess_frames_out, memory_order_relaxed);
+    stats->cache_hits = atomic_load_explicit(&sampler->sample_cache_hits, memory_order_relaxed);
+    stats->cache_misses = atomic_load_explicit(&sampler->sample_cache_misses, memory_order_relaxed);
+    return MS_SUCCESS;
+}
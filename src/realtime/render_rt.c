@@ -0,0 +1,183 @@
+/**
+ * @file render_rt.c
+ * @brief Library-owned render thread feeding a lock-free output ring
+ *
+ * For hosts that pull audio instead of being called back: a SCHED_FIFO
+ * thread keeps the ring topped up with ms_process() blocks and the host
+ * copies finished audio out whenever it likes. Neither side ever locks;
+ * the render thread sleeps for half a block whenever the ring is full.
+ */
+
+#include "internal/internal_rt.h"
+#include <string.h>
+#include <time.h>
+
+#define MS_RENDER_DEFAULT_RING_FRAMES 8192
+
+/* ============================================================================
+ * Render Thread
+ * ========================================================================== */
+
+static void *render_thread_main(void *arg) {
+    ms_sampler_t *sampler = (ms_sampler_t*)arg;
+    render_ring_t *render = &sampler->render;
+    const size_t channels = sampler->config.channels;
+    const size_t ring_frames = render->ring_mask + 1;
+    const size_t block = render->block_frames;
+
+    if (render->priority > 0) {
+        ms_set_realtime_priority(render->priority);  /* Best effort */
+    }
+
+    long period_ns = (long)(block * 1000000000.0 / sampler->config.sample_rate / 2.0);
+    if (period_ns < 50000L) period_ns = 50000L;
+    struct timespec idle = {
+        .tv_sec = period_ns / 1000000000L,
+        .tv_nsec = period_ns % 1000000000L
+    };
+
+    while (atomic_load_explicit(&render->running, memory_order_acquire)) {
+        size_t write = atomic_load_explicit(&render->write_pos, memory_order_relaxed);
+        size_t read = atomic_load_explicit(&render->read_pos, memory_order_acquire);
+
+        if (ring_frames - (write - read) < block) {
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        size_t pos = write & render->ring_mask;
+        if (LIKELY(pos + block <= ring_frames)) {
+            ms_process(sampler, render->ring + pos * channels, block);
+        } else {
+            /* Block straddles the end of the ring */
+            size_t first = ring_frames - pos;
+            ms_process(sampler, render->scratch, block);
+            memcpy(render->ring + pos * channels, render->scratch,
+                   first * channels * sizeof(float));
+            memcpy(render->ring, render->scratch + first * channels,
+                   (block - first) * channels * sizeof(float));
+        }
+
+        atomic_store_explicit(&render->write_pos, write + block, memory_order_release);
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+ms_error_t ms_sampler_start_render(ms_sampler_t *sampler, const ms_render_config_t *config) {
+    if (!sampler || sampler->config.channels == 0) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    render_ring_t *render = &sampler->render;
+    if (atomic_load(&render->running)) {
+        return MS_ERROR_INVALID_PARAM;  /* Already running */
+    }
+
+    ms_render_config_t cfg = {
+        .ring_frames = MS_RENDER_DEFAULT_RING_FRAMES,
+        .block_frames = 0,
+        .priority = sampler->rt_priority
+    };
+    if (config) {
+        cfg = *config;
+    }
+    if (cfg.block_frames == 0) {
+        cfg.block_frames = sampler->config.buffer_size ? sampler->config.buffer_size : 256;
+    }
+
+    if (cfg.ring_frames == 0 || (cfg.ring_frames & (cfg.ring_frames - 1)) != 0 ||
+        cfg.block_frames > cfg.ring_frames) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    const size_t channels = sampler->config.channels;
+    ms_error_t err = rt_pinned_alloc(&render->buffer, ((size_t)cfg.ring_frames + cfg.block_frames) *
+                                                      channels * sizeof(float));
+    if (err != MS_SUCCESS) {
+        return err;
+    }
+
+    render->ring = (float*)render->buffer.ptr;
+    render->scratch = render->ring + (size_t)cfg.ring_frames * channels;
+    render->ring_mask = cfg.ring_frames - 1;
+    render->block_frames = cfg.block_frames;
+    render->priority = cfg.priority;
+    atomic_store(&render->write_pos, 0);
+    atomic_store(&render->read_pos, 0);
+    atomic_store(&render->underrun_frames, 0);
+    atomic_store(&render->running, true);
+
+    if (pthread_create(&sampler->audio_thread, NULL, render_thread_main, sampler) != 0) {
+        atomic_store(&render->running, false);
+        rt_pinned_free(&render->buffer);
+        render->ring = NULL;
+        return MS_ERROR_UNKNOWN;
+    }
+
+    return MS_SUCCESS;
+}
+
+void render_thread_shutdown(ms_sampler_t *sampler) {
+    render_ring_t *render = &sampler->render;
+    if (!render->ring) return;
+
+    atomic_store(&render->running, false);
+    pthread_join(sampler->audio_thread, NULL);
+
+    rt_pinned_free(&render->buffer);
+    render->ring = NULL;
+    render->scratch = NULL;
+}
+
+void ms_sampler_stop_render(ms_sampler_t *sampler) {
+    if (!sampler) return;
+    render_thread_shutdown(sampler);
+}
+
+/* ============================================================================
+ * Reader
+ * ========================================================================== */
+
+size_t ms_render_read(ms_sampler_t *sampler, float *output, size_t num_frames) {
+    if (UNLIKELY(!sampler || !output || !sampler->render.ring)) {
+        return 0;
+    }
+
+    render_ring_t *render = &sampler->render;
+    const size_t channels = sampler->config.channels;
+    const size_t ring_frames = render->ring_mask + 1;
+
+    size_t read = atomic_load_explicit(&render->read_pos, memory_order_relaxed);
+    size_t write = atomic_load_explicit(&render->write_pos, memory_order_acquire);
+    size_t count = write - read;
+    if (count > num_frames) count = num_frames;
+
+    size_t pos = read & render->ring_mask;
+    size_t first = ring_frames - pos < count ? ring_frames - pos : count;
+    memcpy(output, render->ring + pos * channels, first * channels * sizeof(float));
+    memcpy(output + first * channels, render->ring, (count - first) * channels * sizeof(float));
+
+    atomic_store_explicit(&render->read_pos, read + count, memory_order_release);
+
+    if (UNLIKELY(count < num_frames)) {
+        memset(output + count * channels, 0, (num_frames - count) * channels * sizeof(float));
+        atomic_fetch_add_explicit(&sampler->xruns, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&render->underrun_frames, num_frames - count,
+                                  memory_order_relaxed);
+    }
+
+    return count;
+}
+
+size_t ms_render_available(const ms_sampler_t *sampler) {
+    if (!sampler || !sampler->render.ring) return 0;
+
+    size_t write = atomic_load_explicit(&sampler->render.write_pos, memory_order_acquire);
+    size_t read = atomic_load_explicit(&sampler->render.read_pos, memory_order_relaxed);
+    return write - read;
+}
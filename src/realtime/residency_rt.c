@@ -0,0 +1,324 @@
+/**
+ * @file residency_rt.c
+ * @brief Memory budget: least recently played zones leave RAM under pressure
+ *
+ * Zones loaded from files while a budget is set are managed here. Each one
+ * keeps its first head_ms of audio resident for good, so a note-on always
+ * starts instantly. When the managed zones outgrow the budget, the bodies
+ * of the least recently played zones that no voice holds are freed. A
+ * note-on on an evicted zone plays the head and flags the zone; the
+ * residency thread reads the body back (through the sample cache, if one
+ * is set) and the voice moves over to it at the next block. A voice that
+ * reaches the end of the head first stops and is counted.
+ *
+ * The audio thread never waits: it only reads the zone state, bumps
+ * counters and raises a flag. All allocation, file IO and freeing happen
+ * on the residency thread or the control thread.
+ */
+
+#include "internal/internal_rt.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Next stamp for last_played; every use gets a distinct one
+ */
+static uint64_t residency_tick(residency_t *residency) {
+    return atomic_fetch_add_explicit(&residency->clock, 1, memory_order_relaxed) + 1;
+}
+
+/* ============================================================================
+ * Residency Thread
+ * ========================================================================== */
+
+/**
+ * @brief Free a zone's body unless a voice holds it
+ */
+static bool zone_evict(residency_t *residency, zone_residency_t *zone) {
+    atomic_store(&zone->state, ZONE_EVICTING);
+
+    /* A note-on that read the state before the store has counted itself by now */
+    while (atomic_load(&zone->busy)) {
+        sched_yield();
+    }
+    if (atomic_load(&zone->voices) > 0) {
+        atomic_store(&zone->state, ZONE_RESIDENT);
+        return false;
+    }
+
+    sample_data_free(zone->sample);
+    atomic_store_explicit(&zone->state, ZONE_EVICTED, memory_order_release);
+
+    atomic_fetch_sub_explicit(&residency->resident_bytes, zone->body_bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&residency->evictions, 1, memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Read an evicted zone's body back from its source
+ */
+static void zone_reload(ms_sampler_t *sampler, zone_residency_t *zone) {
+    ms_sample_data_t *sample = zone->sample;
+    atomic_store(&zone->state, ZONE_LOADING);
+    atomic_store_explicit(&zone->wanted, false, memory_order_relaxed);
+
+    ms_sample_data_t *loaded;
+    if (preprocess_load_file(sampler, zone->path, &zone->metadata, &loaded) != MS_SUCCESS) {
+        atomic_store(&zone->state, ZONE_EVICTED);
+        return;
+    }
+
+    /* A source that changed on disk no longer matches the zone; keep the head */
+    if (loaded->num_frames != sample->num_frames || loaded->channels != sample->channels) {
+        sample_data_free(loaded);
+        free(loaded);
+        atomic_store(&zone->state, ZONE_EVICTED);
+        return;
+    }
+
+    sample->data = loaded->data;
+    sample->mapping = loaded->mapping;
+    free(loaded);
+
+    /* The voice waiting for it has not moved over yet; do not evict it first */
+    atomic_store_explicit(&zone->last_played, residency_tick(&sampler->residency),
+                          memory_order_relaxed);
+    atomic_store_explicit(&zone->state, ZONE_RESIDENT, memory_order_release);
+
+    atomic_fetch_add_explicit(&sampler->residency.resident_bytes, zone->body_bytes,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&sampler->residency.reloads, 1, memory_order_relaxed);
+}
+
+static void residency_pass(ms_sampler_t *sampler) {
+    residency_t *residency = &sampler->residency;
+
+    /* Zones that are being played come back first... */
+    for (zone_residency_t *zone = residency->zones; zone; zone = zone->next) {
+        if (atomic_load_explicit(&zone->wanted, memory_order_relaxed) &&
+            atomic_load(&zone->state) == ZONE_EVICTED) {
+            zone_reload(sampler, zone);
+        }
+    }
+
+    if (residency->max_bytes == 0) return;
+
+    /* ...then the least recently played bodies go until the rest fits */
+    while (atomic_load_explicit(&residency->resident_bytes, memory_order_relaxed) >
+           residency->max_bytes) {
+        zone_residency_t *victim = NULL;
+        uint64_t oldest = UINT64_MAX;
+        for (zone_residency_t *zone = residency->zones; zone; zone = zone->next) {
+            const uint64_t played = atomic_load_explicit(&zone->last_played, memory_order_relaxed);
+            if (atomic_load(&zone->state) == ZONE_RESIDENT &&
+                atomic_load_explicit(&zone->voices, memory_order_relaxed) == 0 &&
+                played < oldest) {
+                victim = zone;
+                oldest = played;
+            }
+        }
+        if (!victim || !zone_evict(residency, victim)) break;
+    }
+}
+
+static void *residency_thread_main(void *arg) {
+    ms_sampler_t *sampler = (ms_sampler_t*)arg;
+    residency_t *residency = &sampler->residency;
+    const struct timespec period = { .tv_sec = 0, .tv_nsec = MS_RESIDENCY_PERIOD_MS * 1000000L };
+
+    while (atomic_load_explicit(&residency->running, memory_order_acquire)) {
+        pthread_mutex_lock(&residency->lock);
+        residency_pass(sampler);
+        pthread_mutex_unlock(&residency->lock);
+
+        nanosleep(&period, NULL);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief A scheduled note-on will hit this zone: keep or bring its body back
+ *
+ * Called by the stream lookahead ahead of the note. A resident body counts
+ * as played so it is not the next to go; an evicted one is reloaded by the
+ * next pass, before the note needs it.
+ */
+void zone_expect(ms_sampler_t *sampler, ms_sample_data_t *sample) {
+    zone_residency_t *zone = sample->residency;
+
+    atomic_store_explicit(&zone->last_played, residency_tick(&sampler->residency),
+                          memory_order_relaxed);
+    if (atomic_load(&zone->state) != ZONE_RESIDENT) {
+        atomic_store_explicit(&zone->wanted, true, memory_order_relaxed);
+    }
+}
+
+/* ============================================================================
+ * Control Thread
+ * ========================================================================== */
+
+/**
+ * @brief Put a freshly loaded zone under the budget (best effort)
+ *
+ * Zones no longer than their head, or whose record cannot be allocated,
+ * simply stay resident.
+ */
+void residency_register(ms_sampler_t *sampler, ms_sample_data_t *sample, const char *filepath,
+                        const ms_sample_metadata_t *metadata) {
+    residency_t *residency = &sampler->residency;
+    if (!atomic_load(&residency->running) || !sample->data) return;
+
+    const size_t head_frames = (size_t)((uint64_t)residency->head_ms *
+                                        (uint32_t)sampler->config.sample_rate / 1000);
+    if (sample->num_frames <= head_frames) return;
+
+    zone_residency_t *zone = (zone_residency_t*)calloc(1, sizeof(zone_residency_t));
+    if (!zone) return;
+
+    zone->path = strdup(filepath);
+    zone->head.channels = sample->channels;
+    if (!zone->path || sample_layout(&zone->head, sample->data, head_frames) != MS_SUCCESS) {
+        free(zone->path);
+        free(zone);
+        return;
+    }
+
+    zone->sample = sample;
+    zone->metadata = *metadata;
+    zone->body_bytes = zone_bytes(sample);
+    atomic_init(&zone->state, ZONE_RESIDENT);
+    atomic_init(&zone->busy, false);
+    atomic_init(&zone->voices, 0);
+    atomic_init(&zone->wanted, false);
+    atomic_init(&zone->last_played, 0);
+
+    pthread_mutex_lock(&residency->lock);
+    zone->next = residency->zones;
+    if (residency->zones) {
+        residency->zones->prev = zone;
+    }
+    residency->zones = zone;
+    sample->residency = zone;
+    atomic_fetch_add_explicit(&residency->resident_bytes, zone->body_bytes + zone_bytes(&zone->head),
+                              memory_order_relaxed);
+    pthread_mutex_unlock(&residency->lock);
+}
+
+/**
+ * @brief Take a zone that is being destroyed off the budget
+ */
+void residency_unregister(ms_sampler_t *sampler, ms_sample_data_t *sample) {
+    residency_t *residency = &sampler->residency;
+    zone_residency_t *zone = sample->residency;
+
+    pthread_mutex_lock(&residency->lock);
+    if (zone->prev) {
+        zone->prev->next = zone->next;
+    } else {
+        residency->zones = zone->next;
+    }
+    if (zone->next) {
+        zone->next->prev = zone->prev;
+    }
+
+    size_t bytes = zone_bytes(&zone->head);
+    if (atomic_load(&zone->state) != ZONE_EVICTED) {
+        bytes += zone->body_bytes;
+    }
+    atomic_fetch_sub_explicit(&residency->resident_bytes, bytes, memory_order_relaxed);
+    pthread_mutex_unlock(&residency->lock);
+
+    sample->residency = NULL;
+    sample_data_free(&zone->head);
+    free(zone->path);
+    free(zone);
+}
+
+/**
+ * @brief Keep the residency thread away from zone data (no-op without a budget)
+ */
+void residency_lock(ms_sampler_t *sampler) {
+    if (atomic_load(&sampler->residency.running)) {
+        pthread_mutex_lock(&sampler->residency.lock);
+    }
+}
+
+void residency_unlock(ms_sampler_t *sampler) {
+    if (atomic_load(&sampler->residency.running)) {
+        pthread_mutex_unlock(&sampler->residency.lock);
+    }
+}
+
+void residency_shutdown(ms_sampler_t *sampler) {
+    residency_t *residency = &sampler->residency;
+    if (!atomic_load(&residency->running)) return;
+
+    atomic_store(&residency->running, false);
+    pthread_join(residency->thread, NULL);
+    pthread_mutex_destroy(&residency->lock);
+}
+
+ms_error_t ms_sampler_set_memory_budget(ms_sampler_t *sampler, const ms_memory_budget_t *budget) {
+    if (!sampler || !budget) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    residency_t *residency = &sampler->residency;
+    if (atomic_load(&residency->running)) {
+        pthread_mutex_lock(&residency->lock);
+        residency->max_bytes = budget->max_bytes;
+        pthread_mutex_unlock(&residency->lock);
+        return MS_SUCCESS;
+    }
+
+    residency->max_bytes = budget->max_bytes;
+    residency->head_ms = budget->head_ms ? budget->head_ms : MS_RESIDENCY_DEFAULT_HEAD_MS;
+    residency->zones = NULL;
+    atomic_init(&residency->resident_bytes, 0);
+    atomic_init(&residency->evictions, 0);
+    atomic_init(&residency->reloads, 0);
+    atomic_init(&residency->head_underruns, 0);
+    atomic_init(&residency->clock, 0);
+    if (pthread_mutex_init(&residency->lock, NULL) != 0) {
+        return MS_ERROR_UNKNOWN;
+    }
+
+    atomic_store(&residency->running, true);
+    if (pthread_create(&residency->thread, NULL, residency_thread_main, sampler) != 0) {
+        atomic_store(&residency->running, false);
+        pthread_mutex_destroy(&residency->lock);
+        return MS_ERROR_UNKNOWN;
+    }
+
+    return MS_SUCCESS;
+}
+
+/* ============================================================================
+ * Audio Thread
+ * ========================================================================== */
+
+/**
+ * @brief Let a voice play a managed zone: the body if resident, else the head
+ *
+ * Called at note-on and, for voices on the head, at every block until the
+ * body is back.
+ */
+void zone_acquire(ms_sampler_t *sampler, voice_t *voice) {
+    zone_residency_t *zone = voice->sample->residency;
+
+    atomic_store(&zone->busy, true);
+    if (atomic_load(&zone->state) == ZONE_RESIDENT) {
+        atomic_fetch_add_explicit(&zone->voices, 1, memory_order_relaxed);
+        voice->zone_hold = ZONE_HOLD_BODY;
+    } else {
+        voice->zone_hold = ZONE_HOLD_HEAD;
+        atomic_store_explicit(&zone->wanted, true, memory_order_relaxed);
+    }
+    atomic_store_explicit(&zone->busy, false, memory_order_release);
+
+    atomic_store_explicit(&zone->last_played, residency_tick(&sampler->residency),
+                          memory_order_relaxed);
+}
@@ -0,0 +1,372 @@
+/**
+ * @file sample_cache_rt.c
+ * @brief On-disk cache of preprocessed sample data
+ *
+ * Decoding, resampling and trimming a library is repeated on every start
+ * unless the result is kept. The cache directory holds two kinds of file:
+ *
+ * - <key>.msc: a zone in its playback layout (engine rate, float, guard
+ *   frames included), named by a hash of the source file's content and of
+ *   everything that shapes the result (engine rate, preprocessing, loop
+ *   points). It is mapped straight into memory on later loads.
+ * - <path hash>.ref: the source's size, mtime and content hash, so an
+ *   unchanged file is found without reading it again.
+ *
+ * Files are written under a temporary name and renamed into place, so
+ * parallel loads and other processes only ever see complete entries. A
+ * hit refreshes the entry's mtime; when the directory grows past its
+ * limit the least recently used entries are deleted.
+ */
+
+#include "internal/internal_rt.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SAMPLE_CACHE_MAGIC "MSCACHE1"
+#define SAMPLE_CACHE_DEFAULT_BYTES (1024ull * 1024ull * 1024ull)
+#define SAMPLE_CACHE_MAX_ENTRIES 65536
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+/* Entry header, followed by (num_frames + 2 * guard) * channels floats */
+typedef struct {
+    char magic[8];
+    uint64_t key;
+    uint64_t num_frames;
+    uint32_t channels;
+    uint32_t guard_frames;
+    uint32_t loop_start;
+    uint32_t loop_end;
+    uint8_t reserved[24];           /* Pads to a cache line, so the data stays aligned */
+} sample_cache_header_t;
+
+typedef struct {
+    char magic[8];
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t content_hash;
+} sample_cache_ref_t;
+
+/* ============================================================================
+ * Keys
+ * ========================================================================== */
+
+static uint64_t fnv_update(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+#define FNV_FIELD(hash, field) fnv_update(hash, &(field), sizeof(field))
+
+/**
+ * @brief Hash of everything besides the source content that shapes a zone
+ */
+static uint64_t params_hash(const ms_sampler_t *sampler, const ms_sample_metadata_t *metadata) {
+    const ms_preprocess_config_t *cfg = &sampler->preprocess;
+    const uint32_t rate = (uint32_t)sampler->config.sample_rate;
+    const uint32_t guard = MS_SAMPLE_GUARD_FRAMES;
+    uint64_t h = fnv_update(FNV_OFFSET, SAMPLE_CACHE_MAGIC, 8);
+
+    h = FNV_FIELD(h, rate);
+    h = FNV_FIELD(h, guard);
+    h = FNV_FIELD(h, metadata->loop_enabled);
+    h = FNV_FIELD(h, metadata->loop_start);
+    h = FNV_FIELD(h, metadata->loop_end);
+    h = FNV_FIELD(h, cfg->downmix);
+    h = FNV_FIELD(h, cfg->resample);
+    h = FNV_FIELD(h, cfg->remove_dc);
+    h = FNV_FIELD(h, cfg->trim_silence);
+    h = FNV_FIELD(h, cfg->trim_db);
+    h = FNV_FIELD(h, cfg->trim_tail);
+    h = FNV_FIELD(h, cfg->tail_db);
+    h = FNV_FIELD(h, cfg->tail_fade_ms);
+    h = FNV_FIELD(h, cfg->normalize);
+    h = FNV_FIELD(h, cfg->normalize_db);
+    return h;
+}
+
+static ms_error_t content_hash(const char *filepath, uint64_t *hash) {
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    uint8_t chunk[65536];
+    uint64_t h = FNV_OFFSET;
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        h = fnv_update(h, chunk, n);
+    }
+
+    const bool failed = ferror(fp);
+    fclose(fp);
+    *hash = h;
+    return failed ? MS_ERROR_INVALID_FORMAT : MS_SUCCESS;
+}
+
+static void cache_path(const ms_sampler_t *sampler, uint64_t key, const char *suffix,
+                       char *path) {
+    snprintf(path, PATH_MAX, "%s/%016llx.%s", sampler->sample_cache_dir,
+             (unsigned long long)key, suffix);
+}
+
+/**
+ * @brief Write a cache file so that readers never see it half written
+ */
+static bool cache_write(const char *path, const void *head, size_t head_size,
+                        const void *body, size_t body_size) {
+    char tmp[PATH_MAX + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%ld.%lx.tmp", path, (long)getpid(),
+             (unsigned long)pthread_self());
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return false;
+
+    bool ok = fwrite(head, 1, head_size, fp) == head_size &&
+              (body_size == 0 || fwrite(body, 1, body_size, fp) == body_size);
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Content hash of the source, from its .ref when size and mtime match
+ */
+static ms_error_t source_hash(const ms_sampler_t *sampler, const char *filepath,
+                              uint64_t *hash) {
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    char resolved[PATH_MAX];
+    const char *name = realpath(filepath, resolved) ? resolved : filepath;
+    char path[PATH_MAX];
+    cache_path(sampler, fnv_update(FNV_OFFSET, name, strlen(name)), "ref", path);
+
+    const int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    sample_cache_ref_t ref;
+    FILE *fp = fopen(path, "rb");
+    if (fp) {
+        const bool valid = fread(&ref, sizeof(ref), 1, fp) == 1 &&
+                           memcmp(ref.magic, SAMPLE_CACHE_MAGIC, 8) == 0 &&
+                           ref.size == (uint64_t)st.st_size && ref.mtime_ns == mtime_ns;
+        fclose(fp);
+        if (valid) {
+            *hash = ref.content_hash;
+            return MS_SUCCESS;
+        }
+    }
+
+    ms_error_t err = content_hash(filepath, hash);
+    if (err != MS_SUCCESS) {
+        return err;
+    }
+
+    memcpy(ref.magic, SAMPLE_CACHE_MAGIC, 8);
+    ref.size = (uint64_t)st.st_size;
+    ref.mtime_ns = mtime_ns;
+    ref.content_hash = *hash;
+    cache_write(path, &ref, sizeof(ref), NULL, 0);  /* Best effort */
+    return MS_SUCCESS;
+}
+
+/* ============================================================================
+ * Eviction
+ * ========================================================================== */
+
+typedef struct {
+    int64_t mtime_ns;
+    off_t size;
+    char name[32];
+} cache_file_t;
+
+static int cache_file_older(const void *a, const void *b) {
+    const int64_t ta = ((const cache_file_t*)a)->mtime_ns;
+    const int64_t tb = ((const cache_file_t*)b)->mtime_ns;
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * @brief Delete least recently used entries until the directory fits
+ */
+static void cache_evict(const ms_sampler_t *sampler) {
+    DIR *dir = opendir(sampler->sample_cache_dir);
+    if (!dir) return;
+
+    cache_file_t *files = (cache_file_t*)malloc(SAMPLE_CACHE_MAX_ENTRIES * sizeof(cache_file_t));
+    if (!files) {
+        closedir(dir);
+        return;
+    }
+
+    size_t count = 0;
+    uint64_t total = 0;
+    char path[PATH_MAX];
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < SAMPLE_CACHE_MAX_ENTRIES) {
+        const size_t len = strlen(entry->d_name);
+        if (len >= sizeof(files[0].name) || len < 4 ||
+            strcmp(entry->d_name + len - 4, ".msc") != 0) continue;
+
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", sampler->sample_cache_dir, entry->d_name);
+        if (stat(path, &st) != 0) continue;
+
+        files[count].mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        files[count].size = st.st_size;
+        memcpy(files[count].name, entry->d_name, len + 1);
+        total += (uint64_t)st.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    qsort(files, count, sizeof(cache_file_t), cache_file_older);
+    for (size_t i = 0; i < count && total > sampler->sample_cache_max_bytes; i++) {
+        snprintf(path, sizeof(path), "%s/%s", sampler->sample_cache_dir, files[i].name);
+        if (unlink(path) == 0 || errno == ENOENT) {
+            total -= (uint64_t)files[i].size;
+        }
+    }
+
+    free(files);
+}
+
+/* ============================================================================
+ * Lookup and Store
+ * ========================================================================== */
+
+/**
+ * @brief Map a cached zone for a source file
+ *
+ * @param key Output, the entry key (also set on a miss, for storing)
+ * @param sample Output, set on a hit only
+ * @return true on a hit; on a miss the caller processes the file itself
+ */
+bool sample_cache_lookup(ms_sampler_t *sampler, const char *filepath,
+                         const ms_sample_metadata_t *metadata, uint64_t *key,
+                         ms_sample_data_t **sample) {
+    uint64_t hash;
+    if (source_hash(sampler, filepath, &hash) != MS_SUCCESS) {
+        return false;  /* Decoding reports the error */
+    }
+    *key = fnv_update(params_hash(sampler, metadata), &hash, sizeof(hash));
+
+    char path[PATH_MAX];
+    cache_path(sampler, *key, "msc", path);
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        atomic_fetch_add_explicit(&sampler->sample_cache_misses, 1, memory_order_relaxed);
+        return false;
+    }
+
+    struct stat st;
+    sample_cache_header_t header;
+    bool valid = fstat(fd, &st) == 0 &&
+                 pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                 memcmp(header.magic, SAMPLE_CACHE_MAGIC, 8) == 0 &&
+                 header.key == *key && header.channels > 0 &&
+                 header.guard_frames == MS_SAMPLE_GUARD_FRAMES &&
+                 (uint64_t)st.st_size == sizeof(header) +
+                     (header.num_frames + 2 * MS_SAMPLE_GUARD_FRAMES) * header.channels *
+                     sizeof(float);
+
+    ms_sample_data_t *s = NULL;
+    if (valid) {
+        s = (ms_sample_data_t*)aligned_alloc(MS_CACHE_LINE_SIZE, sizeof(ms_sample_data_t));
+        valid = s != NULL;
+    }
+    if (valid) {
+        memset(s, 0, sizeof(*s));
+        valid = rt_file_map(&s->mapping, fd, (size_t)st.st_size) == MS_SUCCESS;
+    }
+    close(fd);
+
+    if (!valid) {
+        free(s);
+        atomic_fetch_add_explicit(&sampler->sample_cache_misses, 1, memory_order_relaxed);
+        return false;
+    }
+
+    s->data = (float*)((char*)s->mapping.ptr + sizeof(header)) +
+              MS_SAMPLE_GUARD_FRAMES * header.channels;
+    s->num_frames = (size_t)header.num_frames;
+    s->channels = (uint16_t)header.channels;
+    s->meta = *metadata;
+    s->meta.loop_start = header.loop_start;
+    s->meta.loop_end = header.loop_end;
+
+    /* Recently used entries are evicted last */
+    utimensat(AT_FDCWD, path, NULL, 0);
+    atomic_fetch_add_explicit(&sampler->sample_cache_hits, 1, memory_order_relaxed);
+    *sample = s;
+    return true;
+}
+
+/**
+ * @brief Save a freshly processed zone under its key (best effort)
+ */
+void sample_cache_store(ms_sampler_t *sampler, uint64_t key, const ms_sample_data_t *sample) {
+    sample_cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAMPLE_CACHE_MAGIC, 8);
+    header.key = key;
+    header.num_frames = sample->num_frames;
+    header.channels = sample->channels;
+    header.guard_frames = MS_SAMPLE_GUARD_FRAMES;
+    header.loop_start = sample->meta.loop_start;
+    header.loop_end = sample->meta.loop_end;
+
+    char path[PATH_MAX];
+    cache_path(sampler, key, "msc", path);
+    const size_t body = (sample->num_frames + 2 * MS_SAMPLE_GUARD_FRAMES) * sample->channels *
+                        sizeof(float);
+    if (cache_write(path, &header, sizeof(header),
+                    sample->data - MS_SAMPLE_GUARD_FRAMES * sample->channels, body)) {
+        cache_evict(sampler);
+    }
+}
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+ms_error_t ms_sampler_set_sample_cache(ms_sampler_t *sampler,
+                                       const ms_sample_cache_config_t *config) {
+    if (!sampler || (config && !config->directory)) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    free(sampler->sample_cache_dir);
+    sampler->sample_cache_dir = NULL;
+    if (!config) {
+        return MS_SUCCESS;
+    }
+
+    if (mkdir(config->directory, 0755) != 0 && errno != EEXIST) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    sampler->sample_cache_dir = strdup(config->directory);
+    if (!sampler->sample_cache_dir) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    sampler->sample_cache_max_bytes = config->max_bytes ? config->max_bytes :
+                                      SAMPLE_CACHE_DEFAULT_BYTES;
+    cache_evict(sampler);
+    return MS_SUCCESS;
+}
@@ -15,11 +15,13 @@
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
 #include <sys/mman.h>
 
-/* Forward declarations */
-extern ms_error_t load_wav_file(const char *filepath, ms_sample_data_t *sample);
-extern void sample_data_destroy(ms_sample_data_t *sample);
+#define SAMPLER_STALL_POLLS 100     /* 1 ms polls without a rendered block */
+
+static void instrument_free(ms_instrument_t *instrument);
+static void forget_instrument_events(ms_sampler_t *sampler, const ms_instrument_t *inst);
 
 /* ============================================================================
  * Sampler Lifecycle
@@ -45,6 +47,32 @@ ms_error_t ms_sampler_create(const ms_audio_config_t *config, ms_sampler_t **sam
     /* Initialize lock-free event queue */
     atomic_init(&s->event_queue.write_idx, 0);
     atomic_init(&s->event_queue.read_idx, 0);
+    atomic_init(&s->notify_queue.write_idx, 0);
+    atomic_init(&s->notify_queue.read_idx, 0);
+    atomic_init(&s->notify_dropped, 0);
+    
+    for (size_t i = 0; i < MS_VOICE_HANDLES; i++) {
+        atomic_init(&s->handles[i].handle, 0);
+        atomic_init(&s->handles[i].in_use, false);
+    }
+    atomic_init(&s->stale_commands, 0);
+    governor_init(s);
+    atomic_init(&s->reserved_outstanding, 0);
+    atomic_init(&s->pool, NULL);
+    atomic_init(&s->notes_rejected, 0);
+    atomic_init(&s->all_notes_off, false);
+    
+    for (size_t i = 0; i < MS_MIDI_CHANNELS; i++) {
+        s->channel_expression[i].timbre = 1.0f;
+    }
+    for (size_t i = 0; i < RT_COALESCE_SLOTS; i++) {
+        s->coalesce_slots[i].event_type = RT_EVENT_NONE;
+    }
+    atomic_init(&s->events_coalesced, 0);
+    atomic_init(&s->notes_cached, 0);
+    atomic_init(&s->voices_stolen, 0);
+    atomic_init(&s->monitor.segment, NULL);
+    atomic_init(&s->monitor.busy, false);
     
     /* Initialize voices */
     for (size_t i = 0; i < config->max_polyphony && i < MS_MAX_VOICES; i++) {
@@ -52,9 +80,27 @@ ms_error_t ms_sampler_create(const ms_audio_config_t *config, ms_sampler_t **sam
     }
     
     pthread_mutex_init(&s->control_lock, NULL);
+    pthread_mutex_init(&s->drop_lock, NULL);
+    atomic_init(&s->drop_queue.write_idx, 0);
+    atomic_init(&s->drop_queue.read_idx, 0);
+    atomic_init(&s->stalled_frame, 0);
     atomic_init(&s->is_playing, false);
+    atomic_init(&s->playback_busy, false);
+    atomic_init(&s->playback_event_index, 0);
+    atomic_init(&s->playback_sample_count, 0);
+    atomic_init(&s->playback_epoch, 0);
+    atomic_init(&s->sequence_epoch, 0);
+    atomic_init(&s->sequences_busy, false);
     atomic_init(&s->frames_processed, 0);
     atomic_init(&s->xruns, 0);
+    atomic_init(&s->render.running, false);
+    atomic_init(&s->render.write_pos, 0);
+    atomic_init(&s->render.read_pos, 0);
+    atomic_init(&s->render.underrun_frames, 0);
+    atomic_init(&s->streamer.running, false);
+    atomic_init(&s->streamer.bytes_read, 0);
+    atomic_init(&s->streamer.preload_bytes, 0);
+    atomic_init(&s->streamer.preload_hugepage_bytes, 0);
     
     *sampler = s;
     return MS_SUCCESS;
@@ -63,16 +109,36 @@ ms_error_t ms_sampler_create(const ms_audio_config_t *config, ms_sampler_t **sam
 void ms_sampler_destroy(ms_sampler_t *sampler) {
     if (!sampler) return;
     
-    pthread_mutex_lock(&sampler->control_lock);
+    render_thread_shutdown(sampler);
+    stream_engine_shutdown(sampler);
+    residency_shutdown(sampler);
+    monitor_shutdown(sampler);
     
-    if (sampler->current_track) {
-        midi_track_destroy(sampler->current_track);
-        free(sampler->current_track);
+    /* Give slots of shared voice pools back */
+    for (size_t i = 0; i < MS_MAX_VOICES; i++) {
+        if (sampler->voice_pool[i]) {
+            atomic_fetch_sub_explicit(&sampler->voice_pool[i]->active, 1, memory_order_relaxed);
+        }
     }
     
+    pthread_mutex_lock(&sampler->control_lock);
+    sequencer_release(sampler);
     pthread_mutex_unlock(&sampler->control_lock);
     pthread_mutex_destroy(&sampler->control_lock);
+    pthread_mutex_destroy(&sampler->drop_lock);
+    
+    for (size_t i = 0; i < MS_MAX_SEQUENCES; i++) {
+        free(sampler->sequence_held[i]);
+    }
     
+    /* Destroyed while the engine was not rendering */
+    while (sampler->retired_instruments) {
+        ms_instrument_t *inst = sampler->retired_instruments;
+        sampler->retired_instruments = inst->retired_next;
+        instrument_free(inst);
+    }
+    
+    free(sampler->sample_cache_dir);
     free(sampler);
 }
 
@@ -105,6 +171,67 @@ ms_error_t ms_sampler_enable_rt(ms_sampler_t *sampler, int priority) {
     return MS_SUCCESS;
 }
 
+/* ============================================================================
+ * Drop Requests
+ * ========================================================================== */
+
+/**
+ * @brief Ask the audio thread to let go of part of an instrument
+ *
+ * Callable from any control thread: drops travel on their own queue, so
+ * they never race the note producer for the event queue.
+ *
+ * @param type RT_EVENT_CACHE_DROP or RT_EVENT_INSTRUMENT_DROP
+ * @return false if the queue is full (ask again later)
+ */
+bool sampler_request_drop(ms_sampler_t *sampler, uint8_t type, ms_instrument_t *instrument) {
+    const rt_event_t event = {
+        .event_type = type,
+        .instrument = instrument
+    };
+    
+    pthread_mutex_lock(&sampler->drop_lock);
+    const bool queued = rt_queue_push(&sampler->drop_queue, &event);
+    pthread_mutex_unlock(&sampler->drop_lock);
+    return queued;
+}
+
+/**
+ * @brief Poll done() every millisecond while the engine keeps rendering
+ *
+ * Gives up after SAMPLER_STALL_POLLS polls without a rendered block, and
+ * after the first check if an earlier wait already gave up at this frame,
+ * so a stopped engine costs one timeout rather than one per call.
+ *
+ * @return true once done() holds, false if the engine stalled first
+ */
+bool sampler_wait_blocks(ms_sampler_t *sampler, bool (*done)(void *ctx), void *ctx) {
+    const struct timespec poll = { .tv_sec = 0, .tv_nsec = 1000000L };
+    uint64_t seen = atomic_load_explicit(&sampler->frames_processed, memory_order_relaxed);
+    const uint64_t stalled = atomic_load_explicit(&sampler->stalled_frame, memory_order_relaxed);
+    unsigned idle = stalled == seen + 1 ? SAMPLER_STALL_POLLS : 0;
+    
+    while (!done(ctx)) {
+        if (idle >= SAMPLER_STALL_POLLS) {
+            atomic_store_explicit(&sampler->stalled_frame, seen + 1, memory_order_relaxed);
+            return false;
+        }
+        
+        nanosleep(&poll, NULL);
+        
+        const uint64_t frames = atomic_load_explicit(&sampler->frames_processed,
+                                                     memory_order_relaxed);
+        if (frames != seen) {
+            seen = frames;
+            idle = 0;
+        } else {
+            idle++;
+        }
+    }
+    
+    return true;
+}
+
 /* ============================================================================
  * Instrument Management
  * ========================================================================== */
@@ -131,12 +258,84 @@ ms_error_t ms_instrument_create(ms_sampler_t *sampler, const char *name,
     inst->envelope.release_time = 0.1f;    /* 100ms */
     
     inst->pitch_bend_range = 2.0f;
+    inst->pitch_bend_multiplier = 1.0f;
     inst->sampler = sampler;
+    ms_tuning_equal(&inst->tuning[0], 440.0);
     
     *instrument = inst;
     return MS_SUCCESS;
 }
 
+/**
+ * @brief Fill the guard frames around a resident zone
+ *
+ * MS_SAMPLE_GUARD_FRAMES frames on either side of data (allocated by the
+ * caller) let the voice kernel read interpolation taps past the ends
+ * without checks. Before frame 0 the guard is silent. A looped zone ends
+ * at loop_end (later frames are never played) and its trailing guard
+ * repeats the loop start; a one-shot zone ends in silence.
+ */
+void sample_guard_fill(ms_sample_data_t *sample) {
+    const size_t channels = sample->channels;
+    ms_sample_metadata_t *meta = &sample->meta;
+    
+    if (meta->loop_end > sample->num_frames) {
+        meta->loop_end = (uint32_t)sample->num_frames;
+    }
+    const bool looping = meta->loop_enabled && meta->loop_end > meta->loop_start;
+    if (looping) {
+        sample->num_frames = meta->loop_end;
+    }
+    
+    float *data = sample->data;
+    memset(data - MS_SAMPLE_GUARD_FRAMES * channels, 0,
+           MS_SAMPLE_GUARD_FRAMES * channels * sizeof(float));
+    
+    float *guard = data + sample->num_frames * channels;
+    for (size_t i = 0; i < MS_SAMPLE_GUARD_FRAMES; i++) {
+        for (size_t c = 0; c < channels; c++) {
+            /* Loops shorter than the guard repeat as often as needed */
+            guard[i * channels + c] = looping ?
+                data[(meta->loop_start + i % (sample->num_frames - meta->loop_start)) * channels + c] :
+                0.0f;
+        }
+    }
+}
+
+/**
+ * @brief Copy PCM into a cache-aligned, guard-padded playback buffer
+ */
+ms_error_t sample_layout(ms_sample_data_t *sample, const float *pcm, size_t num_frames) {
+    const size_t channels = sample->channels;
+    
+    size_t size = (num_frames + 2 * MS_SAMPLE_GUARD_FRAMES) * channels * sizeof(float);
+    size = (size + MS_CACHE_LINE_SIZE - 1) & ~(size_t)(MS_CACHE_LINE_SIZE - 1);
+    float *buffer = (float*)aligned_alloc(MS_CACHE_LINE_SIZE, size);
+    if (!buffer) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    
+    sample->data = buffer + MS_SAMPLE_GUARD_FRAMES * channels;
+    sample->num_frames = num_frames;
+    memcpy(sample->data, pcm, num_frames * channels * sizeof(float));
+    sample_guard_fill(sample);
+    return MS_SUCCESS;
+}
+
+void sample_data_free(ms_sample_data_t *sample) {
+    if (sample->shared) {
+        shared_pool_release(sample->shared);
+        sample->shared = NULL;
+        sample->data = NULL;
+    } else if (sample->mapping.ptr) {
+        rt_pinned_free(&sample->mapping);
+        sample->data = NULL;
+    } else if (sample->data) {
+        free(sample->data - MS_SAMPLE_GUARD_FRAMES * sample->channels);
+        sample->data = NULL;
+    }
+}
+
 ms_error_t ms_instrument_load_sample(ms_instrument_t *instrument, 
                                      const char *filepath,
                                      const ms_sample_metadata_t *metadata) {
@@ -148,32 +347,14 @@ ms_error_t ms_instrument_load_sample(ms_instrument_t *instrument,
         return MS_ERROR_BUFFER_OVERFLOW;
     }
     
-    /* Allocate cache-aligned sample structure */
-    ms_sample_data_t *sample = (ms_sample_data_t*)aligned_alloc(
-        MS_CACHE_LINE_SIZE, sizeof(ms_sample_data_t)
-    );
-    if (!sample) {
-        return MS_ERROR_OUT_OF_MEMORY;
-    }
-    
-    memset(sample, 0, sizeof(*sample));
-    
-    ms_error_t err = load_wav_file(filepath, sample);
+    /* Decode, preprocess and lay out for playback */
+    ms_sample_data_t *sample;
+    ms_error_t err = preprocess_load_file(instrument->sampler, filepath, metadata, &sample);
     if (err != MS_SUCCESS) {
-        free(sample);
         return err;
     }
     
-    /* Reallocate sample data cache-aligned for better performance */
-    size_t data_size = sample->num_frames * sample->channels * sizeof(float);
-    float *aligned_data = (float*)aligned_alloc(MS_CACHE_LINE_SIZE, data_size);
-    if (aligned_data) {
-        memcpy(aligned_data, sample->data, data_size);
-        free(sample->data);
-        sample->data = aligned_data;
-    }
-    
-    sample->meta = *metadata;
+    residency_register(instrument->sampler, sample, filepath, metadata);
     instrument->samples[instrument->num_samples++] = sample;
     
     return MS_SUCCESS;
@@ -200,18 +381,13 @@ ms_error_t ms_instrument_load_sample_memory(ms_instrument_t *instrument,
     
     memset(sample, 0, sizeof(*sample));
     
-    /* Allocate cache-aligned sample data */
-    size_t data_size = num_frames * channels * sizeof(float);
-    sample->data = (float*)aligned_alloc(MS_CACHE_LINE_SIZE, data_size);
-    if (!sample->data) {
-        free(sample);
-        return MS_ERROR_OUT_OF_MEMORY;
-    }
-    
-    memcpy(sample->data, data, data_size);
-    sample->num_frames = num_frames;
     sample->channels = channels;
     sample->meta = *metadata;
+    ms_error_t err = sample_layout(sample, data, num_frames);
+    if (err != MS_SUCCESS) {
+        free(sample);
+        return err;
+    }
     
     instrument->samples[instrument->num_samples++] = sample;
     
@@ -228,19 +404,90 @@ ms_error_t ms_instrument_set_envelope(ms_instrument_t *instrument,
     return MS_SUCCESS;
 }
 
-void ms_instrument_destroy(ms_instrument_t *instrument) {
-    if (!instrument) return;
+/**
+ * @brief Free an instrument the audio thread no longer refers to
+ */
+static void instrument_free(ms_instrument_t *instrument) {
+    note_cache_destroy_all(instrument);
     
     for (size_t i = 0; i < instrument->num_samples; i++) {
-        if (instrument->samples[i]) {
-            sample_data_destroy(instrument->samples[i]);
-            free(instrument->samples[i]);
+        ms_sample_data_t *sample = instrument->samples[i];
+        if (sample) {
+            if (sample->residency) {
+                residency_unregister(instrument->sampler, sample);
+            }
+            if (sample->preload.ptr) {
+                stream_sample_destroy(instrument->sampler, sample);
+            } else {
+                sample_data_free(sample);
+            }
+            free(sample);
         }
     }
     
     free(instrument);
 }
 
+typedef struct {
+    ms_sampler_t *sampler;
+    const ms_instrument_t *target;
+} instrument_release_t;
+
+/**
+ * @brief Queue drops for retired instruments and free those the audio
+ *        thread has let go of (control_lock held)
+ *
+ * @return true if target is no longer retired (freed here or by another call)
+ */
+static bool instrument_reap(ms_sampler_t *sampler, const ms_instrument_t *target) {
+    bool pending = false;
+    ms_instrument_t **link = &sampler->retired_instruments;
+    
+    while (*link) {
+        ms_instrument_t *inst = *link;
+        if (!inst->drop_queued) {
+            inst->drop_queued = sampler_request_drop(sampler, RT_EVENT_INSTRUMENT_DROP, inst);
+        }
+        
+        if (atomic_load_explicit(&inst->dropped, memory_order_acquire)) {
+            *link = inst->retired_next;
+            instrument_free(inst);
+        } else {
+            pending |= inst == target;
+            link = &inst->retired_next;
+        }
+    }
+    
+    return !pending;
+}
+
+static bool instrument_released(void *ctx) {
+    const instrument_release_t *release = (const instrument_release_t*)ctx;
+    
+    pthread_mutex_lock(&release->sampler->control_lock);
+    const bool freed = instrument_reap(release->sampler, release->target);
+    pthread_mutex_unlock(&release->sampler->control_lock);
+    return freed;
+}
+
+void ms_instrument_destroy(ms_instrument_t *instrument) {
+    if (!instrument) return;
+    
+    ms_sampler_t *sampler = instrument->sampler;
+    pthread_mutex_lock(&sampler->control_lock);
+    instrument->retired_next = sampler->retired_instruments;
+    sampler->retired_instruments = instrument;
+    pthread_mutex_unlock(&sampler->control_lock);
+    
+    /*
+     * Wait for the audio thread to end the voices and forget the instrument.
+     * If the engine stops rendering, leave it retired: a later destroy or
+     * ms_sampler_destroy() frees it.
+     */
+    instrument_release_t release = { .sampler = sampler, .target = instrument };
+    sampler_wait_blocks(sampler, instrument_released, &release);
+}
+
 ms_sample_data_t* instrument_find_sample(ms_instrument_t *instrument, 
                                          uint8_t note, uint8_t velocity) {
     if (!instrument) return NULL;
@@ -286,24 +533,90 @@ ms_sample_data_t* instrument_find_sample(ms_instrument_t *instrument,
  * Playback Control (Lock-free RT-safe API)
  * ========================================================================== */
 
+/**
+ * @brief Issue a fresh voice handle (control thread)
+ *
+ * Entries are recycled round-robin so a just-freed handle is not reissued
+ * immediately; the generation makes every issue of an entry distinct.
+ *
+ * @return Entry holding the new handle, or NULL if all are in use
+ */
+static voice_handle_entry_t *voice_handle_acquire(ms_sampler_t *sampler) {
+    for (uint32_t n = 0; n < MS_VOICE_HANDLES; n++) {
+        const uint32_t index = (sampler->handle_cursor + n) & (MS_VOICE_HANDLES - 1);
+        voice_handle_entry_t *entry = &sampler->handles[index];
+        if (atomic_load_explicit(&entry->in_use, memory_order_acquire)) {
+            continue;
+        }
+        
+        entry->generation = (entry->generation + 1) & 0x7FFFFF;
+        atomic_store_explicit(&entry->handle,
+                              MS_VOICE_HANDLE_FLAG | entry->generation << 8 | index,
+                              memory_order_relaxed);
+        atomic_store_explicit(&entry->in_use, true, memory_order_relaxed);
+        sampler->handle_cursor = index + 1;
+        return entry;  /* Published to the audio thread by the queue push */
+    }
+    
+    return NULL;
+}
+
+/**
+ * @brief Return the handle of a voice that is ending to the free pool
+ *
+ * Called exactly once per voice life (steal, finish, kill). Voices started
+ * without a handle carry an audio-assigned ID and are skipped.
+ */
+static FORCE_INLINE void voice_handle_free(ms_sampler_t *sampler, const voice_t *voice) {
+    const uint32_t id = voice->voice_id;
+    if (!(id & MS_VOICE_HANDLE_FLAG)) return;
+    
+    voice_handle_entry_t *entry = &sampler->handles[id & (MS_VOICE_HANDLES - 1)];
+    if (atomic_load_explicit(&entry->handle, memory_order_relaxed) == id) {
+        entry->voice = 0;
+        atomic_store_explicit(&entry->in_use, false, memory_order_release);
+    }
+}
+
 ms_error_t ms_note_on(ms_instrument_t *instrument, uint8_t note, 
                       uint8_t velocity, uint32_t *voice_id) {
     if (!instrument || !instrument->sampler) {
         return MS_ERROR_INVALID_PARAM;
     }
     
+    ms_sampler_t *sampler = instrument->sampler;
+    
     /* Push event to lock-free queue for processing in RT thread */
     rt_event_t event = {
         .note = note,
         .velocity = velocity,
-        .event_type = 0,  /* note_on */
+        .event_type = RT_EVENT_NOTE_ON,
+        .timestamp = (uint32_t)atomic_load_explicit(&sampler->frames_processed,
+                                                    memory_order_relaxed),
         .instrument = instrument
     };
     
-    if (!rt_queue_push(&instrument->sampler->event_queue, &event)) {
+    /* Only callers that want to address the voice later pay for a handle */
+    voice_handle_entry_t *entry = NULL;
+    if (voice_id) {
+        entry = voice_handle_acquire(sampler);
+        if (!entry) {
+            return MS_ERROR_VOICE_LIMIT;
+        }
+        event.voice_id = (uint32_t)atomic_load_explicit(&entry->handle, memory_order_relaxed);
+    }
+    
+    if (!rt_queue_push(&sampler->event_queue, &event)) {
+        if (entry) {
+            atomic_store_explicit(&entry->in_use, false, memory_order_relaxed);
+        }
         return MS_ERROR_BUFFER_OVERFLOW;  /* Queue full */
     }
     
+    if (voice_id) {
+        *voice_id = event.voice_id;
+    }
+    
     return MS_SUCCESS;
 }
 
@@ -316,7 +629,9 @@ ms_error_t ms_note_off(ms_instrument_t *instrument, uint8_t note) {
     rt_event_t event = {
         .note = note,
         .velocity = 0,
-        .event_type = 1,  /* note_off */
+        .event_type = RT_EVENT_NOTE_OFF,
+        .timestamp = (uint32_t)atomic_load_explicit(&instrument->sampler->frames_processed,
+                                                    memory_order_relaxed),
         .instrument = instrument
     };
     
@@ -330,82 +645,806 @@ ms_error_t ms_note_off(ms_instrument_t *instrument, uint8_t note) {
 void ms_all_notes_off(ms_sampler_t *sampler) {
     if (!sampler) return;
     
-    /* This is a non-RT operation, safe to use direct access */
-    for (size_t i = 0; i < sampler->config.max_polyphony && i < MS_MAX_VOICES; i++) {
-        sampler->voices[i].active = false;
+    /* Voices and their accounting belong to the audio thread */
+    rt_event_t event = {
+        .event_type = RT_EVENT_ALL_NOTES_OFF,
+        .timestamp = (uint32_t)atomic_load_explicit(&sampler->frames_processed,
+                                                    memory_order_relaxed)
+    };
+    
+    if (!rt_queue_push(&sampler->event_queue, &event)) {
+        atomic_store_explicit(&sampler->all_notes_off, true, memory_order_release);
     }
 }
 
 ms_error_t ms_pitch_bend(ms_instrument_t *instrument, int16_t value) {
-    if (!instrument) {
+    if (!instrument || !instrument->sampler) {
         return MS_ERROR_INVALID_PARAM;
     }
     
-    instrument->current_pitch_bend = value;
+    /* Voices belong to the audio thread: bend them in order with queued notes */
+    const int bend = (value < -8192 ? -8192 : value > 8191 ? 8191 : value) + 8192;
+    rt_event_t event = {
+        .note = (uint8_t)(bend & 0x7F),             /* LSB */
+        .velocity = (uint8_t)(bend >> 7),           /* MSB */
+        .event_type = RT_EVENT_PITCH_BEND,
+        .timestamp = (uint32_t)atomic_load_explicit(&instrument->sampler->frames_processed,
+                                                    memory_order_relaxed),
+        .instrument = instrument
+    };
     
-    /* Update active voices (this is atomic on each voice) */
-    if (instrument->sampler) {
-        for (size_t i = 0; i < MS_MAX_VOICES; i++) {
-            voice_t *voice = &instrument->sampler->voices[i];
-            if (voice->active && voice->instrument == instrument) {
-                float semitones = (value / 8192.0f) * instrument->pitch_bend_range;
-                voice->pitch_bend_multiplier = powf(2.0f, semitones / 12.0f);
-            }
-        }
+    if (!rt_queue_push(&instrument->sampler->event_queue, &event)) {
+        return MS_ERROR_BUFFER_OVERFLOW;
+    }
+    
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_instrument_set_voice_mode(ms_instrument_t *instrument, ms_voice_mode_t mode,
+                                        float portamento_ms) {
+    if (!instrument || !instrument->sampler || mode < MS_VOICE_MODE_POLY ||
+        mode > MS_VOICE_MODE_LEGATO || portamento_ms < 0.0f) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    
+    /* Held-note state belongs to the audio thread */
+    rt_event_t event = {
+        .note = (uint8_t)mode,
+        .event_type = RT_EVENT_VOICE_MODE,
+        .timestamp = (uint32_t)atomic_load_explicit(&instrument->sampler->frames_processed,
+                                                    memory_order_relaxed),
+        .instrument = instrument,
+        .value = portamento_ms
+    };
+    
+    if (!rt_queue_push(&instrument->sampler->event_queue, &event)) {
+        return MS_ERROR_BUFFER_OVERFLOW;
+    }
+    
+    return MS_SUCCESS;
+}
+
+/**
+ * @brief Queue a command for the voice behind a handle
+ */
+static ms_error_t voice_command(ms_sampler_t *sampler, uint32_t voice_id,
+                                uint8_t event_type, float value) {
+    if (!sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    
+    rt_event_t event = {
+        .event_type = event_type,
+        .timestamp = (uint32_t)atomic_load_explicit(&sampler->frames_processed,
+                                                    memory_order_relaxed),
+        .voice_id = voice_id,
+        .value = value
+    };
+    
+    if (!rt_queue_push(&sampler->event_queue, &event)) {
+        return MS_ERROR_BUFFER_OVERFLOW;
     }
     
     return MS_SUCCESS;
 }
 
+ms_error_t ms_voice_release(ms_sampler_t *sampler, uint32_t voice_id) {
+    return voice_command(sampler, voice_id, RT_EVENT_VOICE_RELEASE, 0.0f);
+}
+
+ms_error_t ms_voice_kill(ms_sampler_t *sampler, uint32_t voice_id) {
+    return voice_command(sampler, voice_id, RT_EVENT_VOICE_KILL, 0.0f);
+}
+
+ms_error_t ms_voice_set_pitch(ms_sampler_t *sampler, uint32_t voice_id, float semitones) {
+    return voice_command(sampler, voice_id, RT_EVENT_VOICE_PITCH, semitones);
+}
+
+ms_error_t ms_voice_set_gain(ms_sampler_t *sampler, uint32_t voice_id, float gain) {
+    return voice_command(sampler, voice_id, RT_EVENT_VOICE_GAIN, gain);
+}
+
+ms_error_t ms_voice_set_pan(ms_sampler_t *sampler, uint32_t voice_id, float pan) {
+    return voice_command(sampler, voice_id, RT_EVENT_VOICE_PAN, pan);
+}
+
 /* ============================================================================
  * Audio Processing (RT-safe, lock-free)
  * ========================================================================== */
 
+/**
+ * @brief Report a voice lifecycle change to the control thread
+ */
+static FORCE_INLINE void notify_voice(ms_sampler_t *sampler, ms_voice_event_type_t type,
+                                      const voice_t *voice) {
+    ms_voice_event_t event = {
+        .type = type,
+        .voice_id = voice->voice_id,
+        .note = voice->note,
+        .instrument = voice->instrument,
+        .frame = atomic_load_explicit(&sampler->frames_processed, memory_order_relaxed)
+    };
+    
+    if (UNLIKELY(!rt_notify_push(&sampler->notify_queue, &event))) {
+        atomic_fetch_add_explicit(&sampler->notify_dropped, 1, memory_order_relaxed);
+    }
+    
+    /* type is a constant at every (inlined) call site */
+    if (type == MS_VOICE_STARTED) {
+        MS_TRACE4(voice_start, sampler, event.voice_id, event.note, event.instrument);
+    } else if (type == MS_VOICE_STOLEN) {
+        MS_TRACE4(voice_steal, sampler, event.voice_id, event.note, event.instrument);
+    } else {
+        MS_TRACE4(voice_finish, sampler, event.voice_id, event.note, event.instrument);
+    }
+}
+
+/**
+ * @brief Stop routing MPE expression of the voice's channel to it
+ */
+static FORCE_INLINE void voice_unroute(ms_sampler_t *sampler, voice_t *voice) {
+    if (voice->channel) {
+        channel_expression_t *channel = &sampler->channel_expression[voice->channel - 1];
+        if (channel->voice == (uint8_t)(voice - sampler->voices + 1)) {
+            channel->voice = 0;
+        }
+    }
+}
+
+/**
+ * @brief Drop everything that still points at an ending or stolen voice
+ */
+static FORCE_INLINE void voice_detach(ms_sampler_t *sampler, voice_t *voice, bool release_pool) {
+    voice_handle_free(sampler, voice);
+    voice_unroute(sampler, voice);
+    if (voice->cached) {
+        voice_uncache(voice);
+    }
+    zone_release(voice);
+    
+    if (voice->instrument->mono_voice == (uint8_t)(voice - sampler->voices + 1)) {
+        voice->instrument->mono_voice = 0;
+    }
+    
+    voice_unbind(sampler, voice, release_pool);
+}
+
+/**
+ * @brief Voice reached its end: notify, detach it, stop streaming
+ */
+static FORCE_INLINE void voice_finished(ms_sampler_t *sampler, voice_t *voice) {
+    notify_voice(sampler, MS_VOICE_FINISHED, voice);
+    voice_detach(sampler, voice, true);
+    
+    /* Release the streamer as soon as a streamed voice finishes */
+    if (voice->stream) {
+        stream_voice_stop(voice->stream);
+    }
+}
+
+/**
+ * @brief Find the voice a command is addressed to
+ *
+ * O(1): the handle indexes its entry, and the voice must still carry the
+ * exact handle, so commands for ended or stolen notes are dropped.
+ */
+static FORCE_INLINE voice_t *voice_handle_resolve(ms_sampler_t *sampler, uint32_t voice_id) {
+    if (voice_id & MS_VOICE_HANDLE_FLAG) {
+        const voice_handle_entry_t *entry = &sampler->handles[voice_id & (MS_VOICE_HANDLES - 1)];
+        if (entry->voice != 0) {
+            voice_t *voice = &sampler->voices[entry->voice - 1];
+            if (voice->active && voice->voice_id == voice_id) {
+                return voice;
+            }
+        }
+    }
+    
+    atomic_fetch_add_explicit(&sampler->stale_commands, 1, memory_order_relaxed);
+    return NULL;
+}
+
+/**
+ * @brief Apply a voice handle command on the audio thread
+ */
+static void voice_handle_command(ms_sampler_t *sampler, const rt_event_t *event) {
+    voice_t *voice = voice_handle_resolve(sampler, event->voice_id);
+    if (!voice) return;
+    
+    switch (event->event_type) {
+        case RT_EVENT_VOICE_RELEASE:
+            voice_release(voice);
+            break;
+        case RT_EVENT_VOICE_KILL:
+            voice->active = false;
+            voice_finished(sampler, voice);
+            break;
+        case RT_EVENT_VOICE_PITCH:
+            voice_set_pitch(voice, event->value);
+            break;
+        case RT_EVENT_VOICE_GAIN:
+            voice_set_gain_pan(voice, event->value, voice->pan);
+            break;
+        case RT_EVENT_VOICE_PAN:
+            voice_set_gain_pan(voice, voice->gain, event->value);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Apply an MPE per-note message to its member channel's voice
+ *
+ * O(1): the channel remembers which voice holds its note.
+ */
+static void note_expression(ms_sampler_t *sampler, const rt_event_t *event) {
+    channel_expression_t *channel = &sampler->channel_expression[(event->channel - 1) &
+                                                                 (MS_MIDI_CHANNELS - 1)];
+    voice_t *voice = channel->voice ? &sampler->voices[channel->voice - 1] : NULL;
+    
+    switch (event->event_type) {
+        case RT_EVENT_NOTE_PITCH:
+            channel->pitch = event->value;
+            if (voice) voice->expression.pitch_target = event->value;
+            break;
+        case RT_EVENT_NOTE_PRESSURE:
+            channel->pressure = event->value;
+            if (voice) voice->expression.pressure_target = event->value;
+            break;
+        default:
+            channel->timbre = event->value;
+            if (voice) voice->expression.timbre_target = event->value;
+            break;
+    }
+    
+    if (voice) {
+        voice->expressive = true;
+    }
+}
+
+/**
+ * @brief Return a handle whose note never got a voice
+ */
+static FORCE_INLINE void voice_handle_discard(ms_sampler_t *sampler, uint32_t voice_id) {
+    if (voice_id) {
+        voice_handle_entry_t *entry = &sampler->handles[voice_id & (MS_VOICE_HANDLES - 1)];
+        atomic_store_explicit(&entry->in_use, false, memory_order_release);
+    }
+}
+
+/**
+ * @brief Give a voice the ID of the note it now plays and report the start
+ */
+static void voice_assign_id(ms_sampler_t *sampler, voice_t *voice, uint32_t handle) {
+    if (handle) {
+        voice->voice_id = handle;
+        sampler->handles[handle & (MS_VOICE_HANDLES - 1)].voice =
+            (uint8_t)(voice - sampler->voices + 1);
+    } else {
+        /* Unaddressable voice: audio-assigned ID, never a handle */
+        voice->voice_id = sampler->next_voice_id++ & ~MS_VOICE_HANDLE_FLAG;
+        if (UNLIKELY(voice->voice_id == 0)) {
+            voice->voice_id = sampler->next_voice_id++ & ~MS_VOICE_HANDLE_FLAG;
+        }
+    }
+    notify_voice(sampler, MS_VOICE_STARTED, voice);
+}
+
+static FORCE_INLINE void voice_start_stream(voice_t *voice, ms_sample_data_t *sample) {
+    if (voice->stream) {
+        if (sample->streamed) {
+            stream_voice_start(voice->stream, sample);
+        } else {
+            stream_voice_stop(voice->stream);
+        }
+    }
+}
+
+/**
+ * @brief Start a note on a voice taken from the budget
+ *
+ * @return The voice, or NULL if the note was rejected
+ */
+static voice_t *note_start(ms_sampler_t *sampler, ms_instrument_t *inst, const rt_event_t *event) {
+    ms_sample_data_t *sample = instrument_find_sample(inst, event->note, event->velocity);
+    const double frequency = instrument_note_frequency(inst, event->note);
+    atomic_fetch_add_explicit(&inst->note_counts[event->note & 0x7F], 1, memory_order_relaxed);
+    
+    /* Take a voice within the budgets (or within the governor's cap) */
+    voice_t *available_voice = NULL;
+    if (sample && frequency > 0.0) {
+        if (UNLIKELY(sampler->governor.degrade >= MS_GOVERNOR_CAP_POLYPHONY)) {
+            available_voice = governor_cap_voice(sampler);
+        }
+        if (!available_voice) {
+            available_voice = voice_allocate(sampler, inst);
+            if (!available_voice) {
+                atomic_fetch_add_explicit(&sampler->notes_rejected, 1, memory_order_relaxed);
+            }
+        }
+    }
+    
+    if (!available_voice) {
+        voice_handle_discard(sampler, event->voice_id);
+        return NULL;
+    }
+    
+    /* Voice stealing */
+    if (available_voice->active) {
+        atomic_fetch_add_explicit(&sampler->voices_stolen, 1, memory_order_relaxed);
+        notify_voice(sampler, MS_VOICE_STOLEN, available_voice);
+        voice_detach(sampler, available_voice, false);
+    }
+    
+    voice_trigger(available_voice, sample, event->note, event->velocity, &inst->envelope,
+                  frequency, inst->pitch_bend_multiplier);
+    if (sample->residency) {
+        zone_acquire(sampler, available_voice);
+    }
+    voice_bind(sampler, available_voice, inst);
+    
+    /* MPE: the member channel now addresses this voice */
+    if (event->channel) {
+        channel_expression_t *channel = &sampler->channel_expression[event->channel - 1];
+        available_voice->channel = event->channel;
+        channel->voice = (uint8_t)(available_voice - sampler->voices + 1);
+        voice_expression_start(available_voice, channel->pitch, channel->pressure,
+                               channel->timbre);
+    } else if (atomic_load_explicit(&inst->note_cache, memory_order_relaxed)) {
+        /* Static note: play the pre-rendered copy if there is one */
+        note_cache_attach(inst, available_voice);
+        if (available_voice->cached) {
+            atomic_fetch_add_explicit(&sampler->notes_cached, 1, memory_order_relaxed);
+        }
+    }
+    
+    voice_assign_id(sampler, available_voice, event->voice_id);
+    voice_start_stream(available_voice, sample);
+    return available_voice;
+}
+
+/* ============================================================================
+ * Mono / Legato
+ * ========================================================================== */
+
+/*
+ * A mono or legato instrument plays one voice at a time and keeps the keys
+ * that are down in a small last-note-priority stack. Moving to another
+ * note reuses the voice: mono retriggers it in place, legato just changes
+ * its pitch. Either way the pitch glides from where it was.
+ */
+
+static void held_note_remove(ms_instrument_t *inst, uint8_t note) {
+    for (uint8_t i = 0; i < inst->num_held; i++) {
+        if (inst->held_notes[i] == note) {
+            memmove(&inst->held_notes[i], &inst->held_notes[i + 1], inst->num_held - i - 1);
+            inst->num_held--;
+            return;
+        }
+    }
+}
+
+static void held_note_push(ms_instrument_t *inst, uint8_t note) {
+    held_note_remove(inst, note);
+    if (inst->num_held == MS_HELD_NOTES) {
+        memmove(&inst->held_notes[0], &inst->held_notes[1], MS_HELD_NOTES - 1);
+        inst->num_held--;
+    }
+    inst->held_notes[inst->num_held++] = note;
+}
+
+/**
+ * @brief Move the instrument's mono voice to another note
+ *
+ * @param event Note-on that caused the move, NULL when returning to a
+ *              held key (the voice then keeps its ID)
+ * @param retrigger Restart sample and envelope (mono) or only glide (legato)
+ */
+static void mono_move(ms_sampler_t *sampler, ms_instrument_t *inst, voice_t *voice,
+                      uint8_t note, uint8_t velocity, const rt_event_t *event, bool retrigger) {
+    const double frequency = instrument_note_frequency(inst, note);
+    const double previous = instrument_note_frequency(inst, voice->note);
+    if (frequency <= 0.0) {
+        voice_handle_discard(sampler, event ? event->voice_id : 0);
+        return;
+    }
+    
+    /* Interval in the instrument's tuning, in equal-tempered semitones */
+    const float interval = previous > 0.0 ? 12.0f * log2f((float)(frequency / previous)) :
+                                            (float)note - voice->note;
+    
+    if (retrigger) {
+        ms_sample_data_t *sample = instrument_find_sample(inst, note, velocity);
+        if (!sample) {
+            voice_handle_discard(sampler, event ? event->voice_id : 0);
+            return;
+        }
+        
+        const float offset = voice->glide_offset - interval;
+        voice_unroute(sampler, voice);
+        zone_release(voice);
+        voice_trigger(voice, sample, note, velocity, &inst->envelope, frequency,
+                      inst->pitch_bend_multiplier);
+        if (sample->residency) {
+            zone_acquire(sampler, voice);
+        }
+        voice_start_stream(voice, sample);
+        voice_glide_from(voice, offset, inst->glide_frames);
+    } else {
+        voice_retarget(voice, interval, inst->glide_frames);
+        voice->note = note;
+    }
+    
+    if (event) {
+        notify_voice(sampler, MS_VOICE_FINISHED, voice);
+        voice_handle_free(sampler, voice);
+        voice_assign_id(sampler, voice, event->voice_id);
+    }
+}
+
+static void mono_note_on(ms_sampler_t *sampler, ms_instrument_t *inst, const rt_event_t *event) {
+    const bool legato = inst->voice_mode == MS_VOICE_MODE_LEGATO && inst->num_held > 0;
+    held_note_push(inst, event->note);
+    
+    voice_t *voice = inst->mono_voice ? &sampler->voices[inst->mono_voice - 1] : NULL;
+    if (voice && voice->active) {
+        mono_move(sampler, inst, voice, event->note, event->velocity, event, !legato);
+        return;
+    }
+    
+    voice = note_start(sampler, inst, event);
+    if (voice) {
+        inst->mono_voice = (uint8_t)(voice - sampler->voices + 1);
+    }
+}
+
+static void mono_note_off(ms_sampler_t *sampler, ms_instrument_t *inst, const rt_event_t *event) {
+    held_note_remove(inst, event->note);
+    
+    voice_t *voice = inst->mono_voice ? &sampler->voices[inst->mono_voice - 1] : NULL;
+    if (!voice || !voice->active || voice->note != event->note) {
+        return;
+    }
+    
+    if (inst->num_held > 0) {
+        /* Fall back to the most recent key still down */
+        mono_move(sampler, inst, voice, inst->held_notes[inst->num_held - 1], voice->velocity,
+                  NULL, inst->voice_mode == MS_VOICE_MODE_MONO);
+    } else {
+        voice_release(voice);
+    }
+}
+
+/**
+ * @brief End every sounding voice at once
+ */
+static void all_voices_off(ms_sampler_t *sampler) {
+    for (size_t i = 0; i < sampler->config.max_polyphony && i < MS_MAX_VOICES; i++) {
+        voice_t *voice = &sampler->voices[i];
+        if (voice->active) {
+            voice->active = false;
+            voice_finished(sampler, voice);
+        }
+    }
+}
+
+/**
+ * @brief Apply an RT_EVENT_INSTRUMENT_DROP event
+ *
+ * Ends the instrument's voices, which also takes it off active_instruments,
+ * hands its unused reservation back and drops sequence notes and the
+ * events still queued or held for it.
+ * After the ack the control thread frees it.
+ */
+static void instrument_drop(ms_sampler_t *sampler, ms_instrument_t *inst) {
+    for (size_t i = 0; i < sampler->config.max_polyphony && i < MS_MAX_VOICES; i++) {
+        voice_t *voice = &sampler->voices[i];
+        if (voice->active && voice->instrument == inst) {
+            voice->active = false;
+            voice_finished(sampler, voice);
+        }
+    }
+    
+    if (inst->reserved_voices > inst->active_voices) {
+        atomic_fetch_sub_explicit(&sampler->reserved_outstanding,
+                                  inst->reserved_voices - inst->active_voices,
+                                  memory_order_relaxed);
+    }
+    inst->reserved_voices = 0;
+    inst->mono_voice = 0;
+    sequences_forget_instrument(sampler, inst);
+    forget_instrument_events(sampler, inst);
+    
+    atomic_store_explicit(&inst->dropped, true, memory_order_release);
+}
+
+/**
+ * @brief Bend the instrument's sounding voices (audio thread)
+ *
+ * Notes started later pick the bend up from the instrument.
+ */
+static void apply_pitch_bend(ms_sampler_t *sampler, ms_instrument_t *inst, int16_t value) {
+    inst->current_pitch_bend = value;
+    
+    const float semitones = (value / 8192.0f) * inst->pitch_bend_range;
+    const float multiplier = powf(2.0f, semitones / 12.0f);
+    inst->pitch_bend_multiplier = multiplier;
+    for (size_t i = 0; i < sampler->config.max_polyphony && i < MS_MAX_VOICES; i++) {
+        voice_t *voice = &sampler->voices[i];
+        if (voice->active && voice->instrument == inst) {
+            voice_set_bend(voice, multiplier);
+        }
+    }
+}
+
+/**
+ * @brief Apply one event on the audio thread
+ */
+static void sampler_apply_event(ms_sampler_t *sampler, const rt_event_t *event) {
+    ms_instrument_t *inst = (ms_instrument_t*)event->instrument;
+    
+    if (event->event_type == RT_EVENT_NOTE_ON) {
+        if (UNLIKELY(inst->voice_mode != MS_VOICE_MODE_POLY)) {
+            mono_note_on(sampler, inst, event);
+        } else {
+            note_start(sampler, inst, event);
+        }
+        
+    } else if (event->event_type == RT_EVENT_NOTE_OFF) {
+        if (UNLIKELY(inst->voice_mode != MS_VOICE_MODE_POLY)) {
+            mono_note_off(sampler, inst, event);
+            return;
+        }
+        
+        /* Note Off */
+        for (size_t j = 0; j < sampler->config.max_polyphony && j < MS_MAX_VOICES; j++) {
+            voice_t *voice = &sampler->voices[j];
+            if (voice->active && voice->note == event->note && voice->instrument == inst &&
+                (!event->channel || voice->channel == event->channel)) {
+                voice_release(voice);
+            }
+        }
+        
+    } else if (event->event_type == RT_EVENT_PITCH_BEND) {
+        apply_pitch_bend(sampler, inst, (int16_t)(((event->velocity << 7) | event->note) - 8192));
+        
+    } else if (event->event_type <= RT_EVENT_VOICE_PAN) {
+        voice_handle_command(sampler, event);
+        
+    } else if (event->event_type == RT_EVENT_VOICE_BUDGET) {
+        voice_budget_apply(sampler, event);
+        
+    } else if (event->event_type == RT_EVENT_ALL_NOTES_OFF) {
+        all_voices_off(sampler);
+        
+    } else if (event->event_type <= RT_EVENT_NOTE_TIMBRE) {
+        note_expression(sampler, event);
+        
+    } else if (event->event_type == RT_EVENT_VOICE_MODE) {
+        inst->voice_mode = event->note;
+        inst->glide_frames = event->value * sampler->config.sample_rate * 0.001f /
+                             GLIDE_TIME_CONSTANTS;
+        inst->num_held = 0;
+        
+    } else if (event->event_type == RT_EVENT_CACHE_DROP) {
+        note_cache_drop(sampler, inst);
+        
+    } else if (event->event_type == RT_EVENT_INSTRUMENT_DROP) {
+        instrument_drop(sampler, inst);
+    }
+}
+
+/* ============================================================================
+ * Controller Coalescing
+ * ========================================================================== */
+
+/**
+ * @brief Events that only set a continuous value, so only the last one counts
+ */
+static FORCE_INLINE bool event_is_controller(uint8_t type) {
+    return type == RT_EVENT_PITCH_BEND ||
+           (type >= RT_EVENT_VOICE_PITCH && type <= RT_EVENT_VOICE_PAN) ||
+           (type >= RT_EVENT_NOTE_PITCH && type <= RT_EVENT_NOTE_TIMBRE);
+}
+
+static FORCE_INLINE bool event_same_controller(const rt_event_t *a, const rt_event_t *b) {
+    return a->event_type == b->event_type && a->instrument == b->instrument &&
+           a->channel == b->channel && a->voice_id == b->voice_id;
+}
+
+static FORCE_INLINE uint32_t event_controller_slot(const rt_event_t *event) {
+    uint32_t hash = (uint32_t)((uintptr_t)event->instrument >> 4) * 0x9E3779B1u;
+    hash ^= event->voice_id * 0x85EBCA6Bu;
+    hash ^= (uint32_t)event->event_type << 8 | event->channel;
+    return (hash ^ (hash >> 15)) & (RT_COALESCE_SLOTS - 1);
+}
+
+/**
+ * @brief Apply the latest value of every controller seen since the last flush
+ */
+void sampler_flush_controllers(ms_sampler_t *sampler) {
+    for (uint32_t i = 0; i < sampler->coalesce_count; i++) {
+        rt_event_t *slot = &sampler->coalesce_slots[sampler->coalesce_order[i]];
+        sampler_apply_event(sampler, slot);
+        slot->event_type = RT_EVENT_NONE;
+    }
+    sampler->coalesce_count = 0;
+    
+    if (sampler->coalesce_skipped) {
+        atomic_fetch_add_explicit(&sampler->events_coalesced, sampler->coalesce_skipped,
+                                  memory_order_relaxed);
+        sampler->coalesce_skipped = 0;
+    }
+}
+
+/**
+ * @brief Remember a controller value, replacing any earlier one
+ *
+ * Open addressing over a table at most half full, so a lookup is a probe
+ * or two however many messages arrive.
+ */
+static FORCE_INLINE void coalesce_controller(ms_sampler_t *sampler, const rt_event_t *event) {
+    uint32_t index = event_controller_slot(event);
+    
+    for (;;) {
+        rt_event_t *slot = &sampler->coalesce_slots[index];
+        if (slot->event_type == RT_EVENT_NONE) {
+            *slot = *event;
+            sampler->coalesce_order[sampler->coalesce_count++] = (uint8_t)index;
+            if (UNLIKELY(sampler->coalesce_count == RT_COALESCE_PENDING)) {
+                sampler_flush_controllers(sampler);
+            }
+            return;
+        }
+        if (event_same_controller(slot, event)) {
+            *slot = *event;
+            sampler->coalesce_skipped++;
+            return;
+        }
+        index = (index + 1) & (RT_COALESCE_SLOTS - 1);
+    }
+}
+
+/**
+ * @brief Handle one event on the audio thread
+ *
+ * Shared by the lock-free queue drain and the sequencer. Controller
+ * messages are coalesced per (type, instrument, channel, voice) and
+ * applied before the next note event or at the end of the drain, so a
+ * controller flood costs O(distinct controllers) per block while notes
+ * still see every controller sent before them.
+ */
+void sampler_handle_event(ms_sampler_t *sampler, const rt_event_t *event) {
+    MS_TRACE5(event, sampler, event->event_type, event->note, event->velocity, event->timestamp);
+    
+    if (event_is_controller(event->event_type)) {
+        coalesce_controller(sampler, event);
+        return;
+    }
+    
+    if (UNLIKELY(sampler->coalesce_count)) {
+        sampler_flush_controllers(sampler);
+    }
+    sampler_apply_event(sampler, event);
+}
+
+/* ============================================================================
+ * Scheduled Events
+ * ========================================================================== */
+
+/**
+ * @brief Hold an event until its block, after any held event due no later
+ */
+static void schedule_event(ms_sampler_t *sampler, const rt_event_t *event) {
+    uint32_t i = sampler->num_scheduled;
+    
+    while (i > 0 && (int32_t)(sampler->scheduled[i - 1].timestamp - event->timestamp) > 0) {
+        sampler->scheduled[i] = sampler->scheduled[i - 1];
+        i--;
+    }
+    sampler->scheduled[i] = *event;
+    sampler->num_scheduled++;
+}
+
+/**
+ * @brief Handle the held events due before block_end
+ */
+static void release_scheduled(ms_sampler_t *sampler, uint32_t block_end) {
+    uint32_t due = 0;
+    
+    while (due < sampler->num_scheduled &&
+           (int32_t)(sampler->scheduled[due].timestamp - block_end) < 0) {
+        sampler_handle_event(sampler, &sampler->scheduled[due]);
+        due++;
+    }
+    
+    if (due > 0) {
+        sampler->num_scheduled -= due;
+        memmove(sampler->scheduled, sampler->scheduled + due,
+                sampler->num_scheduled * sizeof(rt_event_t));
+    }
+}
+
+/**
+ * @brief Forget queued and held events for an instrument about to be freed
+ *
+ * The drop comes on its own queue, so events sent before the destroy may
+ * still wait in the event queue; they become no-ops. The consumer may
+ * rewrite published slots: the producer reuses them only once read.
+ */
+static void forget_instrument_events(ms_sampler_t *sampler, const ms_instrument_t *inst) {
+    rt_event_queue_t *queue = &sampler->event_queue;
+    const uint32_t write_idx = atomic_load_explicit(&queue->write_idx, memory_order_acquire);
+    
+    for (uint32_t i = atomic_load_explicit(&queue->read_idx, memory_order_relaxed);
+         i != write_idx; i = (i + 1) % RT_EVENT_QUEUE_SIZE) {
+        if (queue->events[i].instrument == inst) {
+            queue->events[i].event_type = RT_EVENT_NONE;
+            queue->events[i].instrument = NULL;
+        }
+    }
+    
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < sampler->num_scheduled; i++) {
+        if (sampler->scheduled[i].instrument != inst) {
+            sampler->scheduled[kept++] = sampler->scheduled[i];
+        }
+    }
+    sampler->num_scheduled = kept;
+}
+
+/**
+ * @brief Apply drop requests from control threads
+ *
+ * Pending controllers go first, as they would before any other
+ * non-controller event.
+ */
+static FORCE_INLINE void process_drops(ms_sampler_t *sampler) {
+    const rt_event_t *event = rt_queue_peek(&sampler->drop_queue);
+    if (LIKELY(!event)) return;
+    
+    if (sampler->coalesce_count) {
+        sampler_flush_controllers(sampler);
+    }
+    do {
+        sampler_apply_event(sampler, event);
+        rt_queue_advance(&sampler->drop_queue);
+    } while ((event = rt_queue_peek(&sampler->drop_queue)));
+}
+
 /**
  * @brief Process pending events from lock-free queue
+ *
+ * Events stamped for a later block move to the scheduled list, so they do
+ * not hold back the events behind them. Held events come first: they were
+ * sent before anything still in the queue. Only when the list is full does
+ * a stamped event wait at the head of the queue.
  */
-static FORCE_INLINE void process_events(ms_sampler_t *sampler) {
-    rt_event_t event;
+static FORCE_INLINE void process_events(ms_sampler_t *sampler, size_t num_frames) {
+    const uint32_t block_end = (uint32_t)(atomic_load_explicit(&sampler->frames_processed,
+                                                               memory_order_relaxed) + num_frames);
+    
+    if (UNLIKELY(sampler->num_scheduled)) {
+        release_scheduled(sampler, block_end);
+    }
     
     /* Process up to queue size events per call */
     for (int i = 0; i < RT_EVENT_QUEUE_SIZE; i++) {
-        if (!rt_queue_pop(&sampler->event_queue, &event)) {
+        const rt_event_t *event = rt_queue_peek(&sampler->event_queue);
+        if (!event) {
             break;  /* Queue empty */
         }
         
-        ms_instrument_t *inst = (ms_instrument_t*)event.instrument;
-        
-        if (event.event_type == 0) {
-            /* Note On */
-            ms_sample_data_t *sample = instrument_find_sample(inst, event.note, event.velocity);
-            if (!sample) continue;
-            
-            /* Find available voice */
-            voice_t *available_voice = NULL;
-            for (size_t j = 0; j < sampler->config.max_polyphony && j < MS_MAX_VOICES; j++) {
-                if (!sampler->voices[j].active) {
-                    available_voice = &sampler->voices[j];
-                    break;
-                }
-            }
-            
-            /* Voice stealing if needed */
-            if (!available_voice) {
-                available_voice = &sampler->voices[0];
-            }
-            
-            voice_trigger(available_voice, sample, event.note, event.velocity, &inst->envelope);
-            available_voice->instrument = inst;
-            
+        if (UNLIKELY(event->event_type == RT_EVENT_NONE)) {
+            /* Cancelled by an instrument drop */
+        } else if ((int32_t)(event->timestamp - block_end) < 0) {
+            sampler_handle_event(sampler, event);
+        } else if (LIKELY(sampler->num_scheduled < RT_SCHEDULE_SLOTS)) {
+            schedule_event(sampler, event);
         } else {
-            /* Note Off */
-            for (size_t j = 0; j < sampler->config.max_polyphony && j < MS_MAX_VOICES; j++) {
-                voice_t *voice = &sampler->voices[j];
-                if (voice->active && voice->note == event.note && voice->instrument == inst) {
-                    voice_release(voice);
-                }
-            }
+            break;  /* Due in a later block, nowhere to hold it */
         }
+        rt_queue_advance(&sampler->event_queue);
     }
 }
 
@@ -414,29 +1453,123 @@ ms_error_t ms_process(ms_sampler_t *sampler, float *output, size_t num_frames) {
         return MS_ERROR_INVALID_PARAM;
     }
     
+    RT_CHECK_ENTER();
+    MS_TRACE3(block_start, sampler,
+              atomic_load_explicit(&sampler->frames_processed, memory_order_relaxed), num_frames);
+    
     /* Clear output buffer (optimized memset) */
     const size_t buffer_size = num_frames * sampler->config.channels;
     memset(output, 0, buffer_size * sizeof(float));
     
+    const bool governed = governor_begin(sampler);
+    const bool monitored = monitor_begin(sampler);
+    
+    if (UNLIKELY(atomic_load_explicit(&sampler->all_notes_off, memory_order_relaxed))) {
+        atomic_store_explicit(&sampler->all_notes_off, false, memory_order_relaxed);
+        all_voices_off(sampler);
+    }
+    
     /* Process pending events from lock-free queue */
-    process_events(sampler);
+    process_events(sampler, num_frames);
+    process_drops(sampler);
+    
+    /* MIDI file playback */
+    sequencer_process(sampler, num_frames);
+    sequences_process(sampler, num_frames);
+    if (sampler->coalesce_count) {
+        sampler_flush_controllers(sampler);
+    }
     
     /* Process all active voices */
     const uint16_t max_voices = sampler->config.max_polyphony < MS_MAX_VOICES ? 
                                 sampler->config.max_polyphony : MS_MAX_VOICES;
     
+    const uint8_t degrade = sampler->governor.degrade;
+    
+    /* Per-note expression glides with a ~5 ms time constant */
+    if (UNLIKELY(num_frames != sampler->expression_frames)) {
+        sampler->expression_frames = num_frames;
+        sampler->expression_alpha = 1.0f - expf(-(float)num_frames /
+                                                (sampler->config.sample_rate * 0.005f));
+    }
+    
     for (size_t i = 0; i < max_voices; i++) {
-        if (LIKELY(sampler->voices[i].active)) {
-            voice_process(&sampler->voices[i], output, num_frames, sampler->config.channels);
+        voice_t *voice = &sampler->voices[i];
+        if (LIKELY(voice->active)) {
+            if (UNLIKELY(degrade)) {
+                const float level = voice_level(voice);
+                if (degrade >= MS_GOVERNOR_RETIRE_QUIET && level < sampler->governor.retire_level) {
+                    voice->active = false;
+                    atomic_fetch_add_explicit(&sampler->governor.retired_voices, 1,
+                                              memory_order_relaxed);
+                    voice_finished(sampler, voice);
+                    continue;
+                }
+                voice->coarse = level < sampler->governor.quiet_level;
+            } else if (UNLIKELY(voice->coarse)) {
+                voice->coarse = false;
+            }
+            
+            if (UNLIKELY(voice->expressive)) {
+                voice->expressive = voice_expression_update(voice, sampler->expression_alpha);
+            }
+            if (UNLIKELY(voice->gliding)) {
+                voice_glide_update(voice, num_frames);
+            } else if (UNLIKELY(voice->speed_step != 1.0)) {
+                voice->speed_step = 1.0;
+            }
+            
+            /* Voices started on an evicted zone's head move to the body once it is back */
+            if (UNLIKELY(voice->zone_hold == ZONE_HOLD_HEAD)) {
+                zone_acquire(sampler, voice);
+            }
+            
+            voice_process(voice, output, num_frames, sampler->config.channels);
+            
+            if (UNLIKELY(!voice->active)) {
+                if (UNLIKELY(voice->zone_hold == ZONE_HOLD_HEAD) &&
+                    voice->playback_position >= voice->sample->residency->head.num_frames) {
+                    atomic_fetch_add_explicit(&sampler->residency.head_underruns, 1,
+                                              memory_order_relaxed);
+                }
+                voice_finished(sampler, voice);
+            }
         }
     }
     
+    if (governed) {
+        governor_end(sampler, num_frames);
+    }
+    if (monitored) {
+        monitor_end(sampler, num_frames);
+    }
+    
     /* Update statistics */
     atomic_fetch_add_explicit(&sampler->frames_processed, num_frames, memory_order_relaxed);
     
+    MS_TRACE4(block_end, sampler,
+              atomic_load_explicit(&sampler->frames_processed, memory_order_relaxed) - num_frames,
+              num_frames, sampler->active_voices);
+    RT_CHECK_LEAVE();
     return MS_SUCCESS;
 }
 
+/* ============================================================================
+ * Voice Notifications (control thread)
+ * ========================================================================== */
+
+size_t ms_poll_voice_events(ms_sampler_t *sampler, ms_voice_event_t *events,
+                            size_t max_events) {
+    if (!sampler || !events) return 0;
+    
+    size_t count = 0;
+    while (count < max_events && rt_notify_pop(&sampler->notify_queue, &events[count])) {
+        count++;
+    }
+    
+    return count;
+}
+
 /* ============================================================================
  * Utility Functions
  * ========================================================================== */
@@ -472,3 +1605,69 @@ void ms_get_stats(const ms_sampler_t *sampler, uint64_t *frames, uint32_t *xruns
         *xruns = atomic_load_explicit(&sampler->xruns, memory_order_relaxed);
     }
 }
+
+ms_error_t ms_sampler_get_stats(const ms_sampler_t *sampler, ms_stats_t *stats) {
+    if (!sampler || !stats) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    
+    memset(stats, 0, sizeof(*stats));
+    stats->frames_processed = atomic_load_explicit(&sampler->frames_processed, memory_order_relaxed);
+    stats->xruns = atomic_load_explicit(&sampler->xruns, memory_order_relaxed);
+    
+    const stream_engine_t *engine = &sampler->streamer;
+    for (size_t i = 0; i < engine->num_voices && engine->voices; i++) {
+        const stream_voice_t *sv = &engine->voices[i];
+        stats->stream_voice_starts += atomic_load_explicit(&sv->starts, memory_order_relaxed);
+        stats->stream_underruns += atomic_load_explicit(&sv->underruns, memory_order_relaxed);
+        stats->stream_underrun_frames += atomic_load_explicit(&sv->underrun_frames, memory_order_relaxed);
+    }
+    stats->stream_bytes_read = atomic_load_explicit(&engine->bytes_read, memory_order_relaxed);
+    stats->preload_bytes = atomic_load_explicit(&engine->preload_bytes, memory_order_relaxed);
+    stats->preload_hugepage_bytes = atomic_load_explicit(&engine->preload_hugepage_bytes,
+                                                         memory_order_relaxed);
+    stats->stream_io = engine->voices ? atomic_load_explicit(&engine->io, memory_order_relaxed)
+                                      : MS_STREAM_IO_AUTO;
+    stats->stream_reads = atomic_load_explicit(&engine->reads, memory_order_relaxed);
+    stats->stream_iops = atomic_load_explicit(&engine->iops, memory_order_relaxed);
+    stats->stream_queue_depth = atomic_load_explicit(&engine->queue_depth, memory_order_relaxed);
+    stats->stream_max_queue_depth = atomic_load_explicit(&engine->max_queue_depth,
+                                                         memory_order_relaxed);
+    stats->prefetches = atomic_load_explicit(&engine->prefetches, memory_order_relaxed);
+    stats->prefetch_hits = atomic_load_explicit(&engine->prefetch_hits, memory_order_relaxed);
+    stats->prefetch_misses = atomic_load_explicit(&engine->prefetch_misses, memory_order_relaxed);
+    
+    stats->render_buffered_frames = ms_render_available(sampler);
+    stats->render_underrun_frames = atomic_load_explicit(&sampler->render.underrun_frames,
+                                                         memory_order_relaxed);
+    stats->voice_events_dropped = atomic_load_explicit(&sampler->notify_dropped,
+                                                       memory_order_relaxed);
+    stats->voice_commands_stale = atomic_load_explicit(&sampler->stale_commands,
+                                                       memory_order_relaxed);
+    
+    const governor_t *gov = &sampler->governor;
+    stats->governor_level = (ms_governor_level_t)atomic_load_explicit(&gov->shared_level,
+                                                                      memory_order_relaxed);
+    stats->dsp_load = atomic_load_explicit(&gov->load_ppm, memory_order_relaxed) / 1e6f;
+    stats->dsp_peak_load = atomic_load_explicit(&gov->peak_load_ppm, memory_order_relaxed) / 1e6f;
+    stats->governor_escalations = atomic_load_explicit(&gov->escalations, memory_order_relaxed);
+    stats->governor_retired_voices = atomic_load_explicit(&gov->retired_voices,
+                                                          memory_order_relaxed);
+    stats->governor_capped_notes = atomic_load_explicit(&gov->capped_notes, memory_order_relaxed);
+    stats->notes_rejected = atomic_load_explicit(&sampler->notes_rejected, memory_order_relaxed);
+    stats->events_coalesced = atomic_load_explicit(&sampler->events_coalesced,
+                                                   memory_order_relaxed);
+    stats->notes_cached = atomic_load_explicit(&sampler->notes_cached, memory_order_relaxed);
+    
+    stats->resident_bytes = atomic_load_explicit(&sampler->residency.resident_bytes,
+                                                 memory_order_relaxed);
+    stats->zones_evicted = atomic_load_explicit(&sampler->residency.evictions,
+                                                memory_order_relaxed);
+    stats->zones_reloaded = atomic_load_explicit(&sampler->residency.reloads,
+                                                 memory_order_relaxed);
+    stats->head_underruns = atomic_load_explicit(&sampler->residency.head_underruns,
+                                                 memory_order_relaxed);
+    stats->voices_stolen = atomic_load_explicit(&sampler->voices_stolen, memory_order_relaxed);
+    
+    return MS_SUCCESS;
+}
@@ -0,0 +1,610 @@
+/**
+ * @file sequencer_rt.c
+ * @brief MIDI file playback driven from the audio thread
+ *
+ * Track events are converted to frame timestamps once at load time, so the
+ * audio thread only compares integers per block. Control operations hand
+ * the track over with a busy flag instead of a lock: the audio thread
+ * never waits, the control thread spins until the current block is done.
+ *
+ * Besides the single ms_load_midi_file() track, any number of sequences
+ * can play at once. The audio thread keeps the playing ones in a min-heap
+ * keyed by the engine frame of their next event, so a block costs
+ * O(events + log sequences) no matter how many sequences are idle.
+ */
+
+#include "internal/internal_rt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+/**
+ * @brief Apply one track event to an instrument on the audio thread
+ */
+static FORCE_INLINE void sequencer_dispatch(ms_sampler_t *sampler, const midi_event_t *ev,
+                                            ms_instrument_t *inst) {
+    if (ev->type == MIDI_NOTE_ON || ev->type == MIDI_NOTE_OFF) {
+        rt_event_t event = {
+            .note = ev->data1,
+            .velocity = ev->data2,
+            .event_type = ev->type == MIDI_NOTE_ON ? RT_EVENT_NOTE_ON : RT_EVENT_NOTE_OFF,
+            .instrument = inst
+        };
+        sampler_handle_event(sampler, &event);
+    } else if (ev->type == MIDI_PITCH_BEND) {
+        /* Back to the 14-bit wire format so bends coalesce with live input */
+        const uint16_t raw = (uint16_t)((int16_t)(ev->data1 | (ev->data2 << 8)) + 8192);
+        rt_event_t event = {
+            .note = raw & 0x7F,
+            .velocity = (raw >> 7) & 0x7F,
+            .event_type = RT_EVENT_PITCH_BEND,
+            .instrument = inst
+        };
+        sampler_handle_event(sampler, &event);
+    }
+}
+
+/* ============================================================================
+ * Control Thread
+ * ========================================================================== */
+
+/**
+ * @brief Stop the sequencer and wait until the audio thread has left it
+ */
+static void sequencer_quiesce(ms_sampler_t *sampler) {
+    atomic_store(&sampler->is_playing, false);
+    while (atomic_load(&sampler->playback_busy)) {
+        sched_yield();
+    }
+}
+
+void sequencer_release(ms_sampler_t *sampler) {
+    sequencer_quiesce(sampler);
+
+    if (sampler->current_track) {
+        midi_track_destroy(sampler->current_track);
+        free(sampler->current_track);
+        sampler->current_track = NULL;
+    }
+
+    free(sampler->event_frames);
+    sampler->event_frames = NULL;
+    sampler->playback_instrument = NULL;
+}
+
+ms_error_t ms_load_midi_file(ms_sampler_t *sampler, ms_instrument_t *instrument,
+                             const char *filepath) {
+    if (!sampler || !instrument || !filepath) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    midi_track_t *track = (midi_track_t*)calloc(1, sizeof(midi_track_t));
+    if (!track) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    ms_error_t err = midi_parse_file(filepath, track);
+    if (err != MS_SUCCESS) {
+        free(track);
+        return err;
+    }
+
+    uint64_t *frames = (uint64_t*)malloc((track->num_events ? track->num_events : 1) *
+                                         sizeof(uint64_t));
+    if (!frames) {
+        midi_track_destroy(track);
+        free(track);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    midi_track_tick_frames(track, sampler->config.sample_rate, frames);
+
+    pthread_mutex_lock(&sampler->control_lock);
+
+    sequencer_release(sampler);
+    sampler->current_track = track;
+    sampler->event_frames = frames;
+    sampler->playback_instrument = instrument;
+    atomic_store(&sampler->playback_event_index, 0);
+    atomic_store(&sampler->playback_sample_count, 0);
+    atomic_fetch_add(&sampler->playback_epoch, 1);
+
+    pthread_mutex_unlock(&sampler->control_lock);
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_start_playback(ms_sampler_t *sampler) {
+    if (!sampler) return MS_ERROR_INVALID_PARAM;
+
+    pthread_mutex_lock(&sampler->control_lock);
+
+    if (!sampler->current_track) {
+        pthread_mutex_unlock(&sampler->control_lock);
+        return MS_ERROR_NOT_INITIALIZED;
+    }
+
+    sequencer_quiesce(sampler);
+    atomic_store(&sampler->playback_event_index, 0);
+    atomic_store(&sampler->playback_sample_count, 0);
+    atomic_fetch_add(&sampler->playback_epoch, 1);
+    atomic_store(&sampler->is_playing, true);
+
+    pthread_mutex_unlock(&sampler->control_lock);
+    return MS_SUCCESS;
+}
+
+void ms_stop_playback(ms_sampler_t *sampler) {
+    if (!sampler) return;
+    atomic_store(&sampler->is_playing, false);
+}
+
+bool ms_is_playing(const ms_sampler_t *sampler) {
+    return sampler && atomic_load_explicit(&sampler->is_playing, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Audio Thread
+ * ========================================================================== */
+
+/**
+ * @brief Dispatch all track events that fall into the next block
+ *
+ * Events are applied at the start of the block they fall into, like
+ * events from the lock-free queue.
+ */
+void sequencer_process(ms_sampler_t *sampler, size_t num_frames) {
+    if (LIKELY(!atomic_load_explicit(&sampler->is_playing, memory_order_relaxed))) {
+        return;
+    }
+
+    /* Pairs with sequencer_quiesce(): either it sees busy, or we see !playing */
+    atomic_store(&sampler->playback_busy, true);
+    if (UNLIKELY(!atomic_load(&sampler->is_playing))) {
+        atomic_store_explicit(&sampler->playback_busy, false, memory_order_release);
+        return;
+    }
+
+    const midi_track_t *track = sampler->current_track;
+    const uint64_t *frames = sampler->event_frames;
+    ms_instrument_t *inst = sampler->playback_instrument;
+
+    size_t index = atomic_load_explicit(&sampler->playback_event_index, memory_order_relaxed);
+    const uint64_t block_end = atomic_load_explicit(&sampler->playback_sample_count,
+                                                    memory_order_relaxed) + num_frames;
+
+    while (index < track->num_events && frames[index] < block_end) {
+        sequencer_dispatch(sampler, &track->events[index++], inst);
+    }
+
+    atomic_store_explicit(&sampler->playback_event_index, index, memory_order_release);
+    atomic_store_explicit(&sampler->playback_sample_count, block_end, memory_order_release);
+
+    if (index >= track->num_events) {
+        atomic_store_explicit(&sampler->is_playing, false, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&sampler->playback_busy, false, memory_order_release);
+}
+
+/* ============================================================================
+ * Multi-Sequence Player: Control Thread
+ * ========================================================================== */
+
+/**
+ * @brief Publish a change of the playing set and wait out the current merge
+ *
+ * After this returns, the audio thread rebuilds its heap before touching
+ * any sequence again.
+ */
+static void sequences_changed(ms_sampler_t *sampler) {
+    atomic_fetch_add(&sampler->sequence_epoch, 1);
+    while (atomic_load(&sampler->sequences_busy)) {
+        sched_yield();
+    }
+}
+
+ms_error_t ms_sequence_load(ms_sampler_t *sampler, const char *filepath,
+                            ms_sequence_t **sequence) {
+    if (!sampler || !filepath || !sequence) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    ms_sequence_t *seq = (ms_sequence_t*)calloc(1, sizeof(ms_sequence_t));
+    if (!seq) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    ms_error_t err = midi_parse_file(filepath, &seq->track);
+    if (err != MS_SUCCESS) {
+        free(seq);
+        return err;
+    }
+
+    size_t num_events = seq->track.num_events;
+    seq->event_frames = (uint64_t*)malloc((num_events ? num_events : 1) * sizeof(uint64_t));
+    if (!seq->event_frames) {
+        midi_track_destroy(&seq->track);
+        free(seq);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    midi_track_tick_frames(&seq->track, sampler->config.sample_rate, seq->event_frames);
+
+    seq->sampler = sampler;
+    for (int ch = 0; ch < MS_MIDI_CHANNELS; ch++) {
+        atomic_init(&seq->channels[ch], NULL);
+    }
+    atomic_init(&seq->start_frame, 0);
+    atomic_init(&seq->request_gen, 0);
+    atomic_init(&seq->playing, false);
+    atomic_init(&seq->played_origin, 0);
+    atomic_init(&seq->played_gen, 0);
+
+    pthread_mutex_lock(&sampler->control_lock);
+
+    size_t slot = 0;
+    while (slot < MS_MAX_SEQUENCES && sampler->sequences[slot]) {
+        slot++;
+    }
+    if (slot == MS_MAX_SEQUENCES) {
+        pthread_mutex_unlock(&sampler->control_lock);
+        free(seq->event_frames);
+        midi_track_destroy(&seq->track);
+        free(seq);
+        return MS_ERROR_VOICE_LIMIT;
+    }
+
+    if (!sampler->sequence_held[slot]) {
+        sampler->sequence_held[slot] = (sequence_held_t*)calloc(1, sizeof(sequence_held_t));
+        if (!sampler->sequence_held[slot]) {
+            pthread_mutex_unlock(&sampler->control_lock);
+            free(seq->event_frames);
+            midi_track_destroy(&seq->track);
+            free(seq);
+            return MS_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    /* Not playing yet, so the audio thread has no reason to look at it */
+    seq->slot = slot;
+    sampler->sequences[slot] = seq;
+
+    pthread_mutex_unlock(&sampler->control_lock);
+
+    *sequence = seq;
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_sequence_set_instrument(ms_sequence_t *sequence, int channel,
+                                      ms_instrument_t *instrument) {
+    if (!sequence || channel < -1 || channel >= MS_MIDI_CHANNELS) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    int first = channel < 0 ? 0 : channel;
+    int last = channel < 0 ? MS_MIDI_CHANNELS - 1 : channel;
+    for (int ch = first; ch <= last; ch++) {
+        atomic_store_explicit(&sequence->channels[ch], instrument, memory_order_release);
+    }
+
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_sequence_start(ms_sequence_t *sequence, uint64_t start_frame) {
+    if (!sequence) return MS_ERROR_INVALID_PARAM;
+
+    ms_sampler_t *sampler = sequence->sampler;
+    pthread_mutex_lock(&sampler->control_lock);
+
+    atomic_store_explicit(&sequence->start_frame, start_frame, memory_order_relaxed);
+    atomic_fetch_add_explicit(&sequence->request_gen, 1, memory_order_release);
+    atomic_store(&sequence->playing, true);
+    sequences_changed(sampler);
+
+    pthread_mutex_unlock(&sampler->control_lock);
+    return MS_SUCCESS;
+}
+
+void ms_sequence_stop(ms_sequence_t *sequence) {
+    if (!sequence) return;
+
+    ms_sampler_t *sampler = sequence->sampler;
+    pthread_mutex_lock(&sampler->control_lock);
+
+    atomic_store(&sequence->playing, false);
+    sequences_changed(sampler);
+
+    pthread_mutex_unlock(&sampler->control_lock);
+}
+
+bool ms_sequence_is_playing(const ms_sequence_t *sequence) {
+    return sequence && atomic_load_explicit(&sequence->playing, memory_order_relaxed);
+}
+
+uint64_t ms_sequence_length(const ms_sequence_t *sequence) {
+    if (!sequence || sequence->track.num_events == 0) return 0;
+    return sequence->event_frames[sequence->track.num_events - 1];
+}
+
+ms_error_t ms_sequence_note_counts(const ms_sequence_t *sequence, const ms_instrument_t *instrument,
+                                   uint32_t *counts) {
+    if (!sequence || !instrument || !counts) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    memset(counts, 0, 128 * sizeof(uint32_t));
+    for (size_t i = 0; i < sequence->track.num_events; i++) {
+        const midi_event_t *event = &sequence->track.events[i];
+        if (event->type == MIDI_NOTE_ON && event->data2 > 0 &&
+            atomic_load_explicit(&sequence->channels[event->channel & 0x0F],
+                                 memory_order_relaxed) == instrument) {
+            counts[event->data1 & 0x7F]++;
+        }
+    }
+
+    return MS_SUCCESS;
+}
+
+void ms_sequence_destroy(ms_sequence_t *sequence) {
+    if (!sequence) return;
+
+    ms_sampler_t *sampler = sequence->sampler;
+    pthread_mutex_lock(&sampler->control_lock);
+
+    atomic_store(&sequence->playing, false);
+    sampler->sequences[sequence->slot] = NULL;
+    sequences_changed(sampler);
+
+    pthread_mutex_unlock(&sampler->control_lock);
+
+    free(sequence->event_frames);
+    midi_track_destroy(&sequence->track);
+    free(sequence);
+}
+
+/* ============================================================================
+ * Multi-Sequence Player: Audio Thread
+ * ========================================================================== */
+
+static FORCE_INLINE void sequence_heap_sift_down(sequence_heap_entry_t *heap, size_t size,
+                                                 size_t i) {
+    sequence_heap_entry_t entry = heap[i];
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1].due < heap[child].due) {
+            child++;
+        }
+        if (entry.due <= heap[child].due) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = entry;
+}
+
+/**
+ * @brief Release every note a sequence slot still has sounding
+ *
+ * Each note-off goes to the instrument its note-on went to, whatever the
+ * channel is mapped to now.
+ */
+static void sequence_release_held(ms_sampler_t *sampler, sequence_held_t *held) {
+    for (int ch = 0; ch < MS_MIDI_CHANNELS && held->count; ch++) {
+        for (int word = 0; word < 2; word++) {
+            uint64_t bits = held->bits[ch][word];
+            while (bits) {
+                const uint8_t note = (uint8_t)(word * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+                rt_event_t event = {
+                    .note = note,
+                    .event_type = RT_EVENT_NOTE_OFF,
+                    .instrument = held->instrument[ch][note]
+                };
+                sampler_handle_event(sampler, &event);
+                held->count--;
+            }
+            held->bits[ch][word] = 0;
+        }
+    }
+    held->count = 0;
+}
+
+/**
+ * @brief Forget held notes that went to an instrument being destroyed
+ *
+ * Its voices are already gone, and a later release must not reach it.
+ */
+void sequences_forget_instrument(ms_sampler_t *sampler, const ms_instrument_t *instrument) {
+    for (size_t i = 0; i < MS_MAX_SEQUENCES; i++) {
+        sequence_held_t *held = sampler->sequence_held[i];
+        if (!held) continue;
+
+        for (int ch = 0; ch < MS_MIDI_CHANNELS && held->count; ch++) {
+            for (int word = 0; word < 2; word++) {
+                uint64_t bits = held->bits[ch][word];
+                while (bits) {
+                    const uint8_t note = (uint8_t)(word * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                    if (held->instrument[ch][note] == instrument) {
+                        held->bits[ch][word] &= ~(1ULL << (note & 63));
+                        held->count--;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Dispatch one sequence event, keeping track of its sounding notes
+ */
+static FORCE_INLINE void sequence_dispatch(ms_sampler_t *sampler, ms_sequence_t *seq,
+                                           sequence_held_t *held, const midi_event_t *ev) {
+    const int ch = ev->channel & 0x0F;
+    ms_instrument_t *inst = atomic_load_explicit(&seq->channels[ch], memory_order_acquire);
+
+    if (ev->type == MIDI_NOTE_ON || ev->type == MIDI_NOTE_OFF) {
+        const uint8_t note = ev->data1 & 0x7F;
+        uint64_t *word = &held->bits[ch][note >> 6];
+        const uint64_t bit = 1ULL << (note & 63);
+
+        if (*word & bit) {
+            ms_instrument_t *target = held->instrument[ch][note];
+            if (ev->type == MIDI_NOTE_OFF || target != inst) {
+                /* Off to where the note-on went, even if the channel was remapped */
+                *word &= ~bit;
+                held->count--;
+                const midi_event_t off = { .type = MIDI_NOTE_OFF, .data1 = note };
+                sequencer_dispatch(sampler, &off, target);
+                if (ev->type == MIDI_NOTE_OFF) return;
+            }
+        }
+
+        if (ev->type == MIDI_NOTE_ON && inst && !(*word & bit)) {
+            *word |= bit;
+            held->instrument[ch][note] = inst;
+            held->owner = seq;
+            held->count++;
+        }
+    }
+
+    if (inst) {
+        sequencer_dispatch(sampler, ev, inst);
+    }
+}
+
+/**
+ * @brief First event at or after a sequence position (binary search)
+ */
+static size_t sequence_seek(const ms_sequence_t *seq, uint64_t frame) {
+    size_t lo = 0, hi = seq->track.num_events;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (seq->event_frames[mid] < frame) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * @brief Rebuild the heap from the playing sequences after a control change
+ *
+ * Only runs when the control thread started, stopped, added or removed a
+ * sequence; O(sequences).
+ */
+static void sequences_rebuild(ms_sampler_t *sampler) {
+    size_t size = 0;
+
+    for (size_t i = 0; i < MS_MAX_SEQUENCES; i++) {
+        ms_sequence_t *seq = sampler->sequences[i];
+        const bool playing = seq && atomic_load_explicit(&seq->playing, memory_order_acquire);
+        const uint32_t gen = playing ? atomic_load_explicit(&seq->request_gen,
+                                                            memory_order_acquire) : 0;
+
+        /* Stopped, restarted, seeked or destroyed: its notes must not hang */
+        sequence_held_t *held = sampler->sequence_held[i];
+        if (held && held->count &&
+            (!playing || held->owner != seq || gen != seq->served_gen)) {
+            sequence_release_held(sampler, held);
+        }
+        if (!playing) {
+            continue;
+        }
+
+        if (gen != seq->served_gen) {
+            uint64_t start = atomic_load_explicit(&seq->start_frame, memory_order_relaxed);
+            seq->served_gen = gen;
+            seq->cursor = sequence_seek(seq, start);
+            seq->origin = sampler->sequence_clock - start;
+            atomic_store_explicit(&seq->played_origin, seq->origin, memory_order_relaxed);
+            atomic_store_explicit(&seq->played_gen, gen, memory_order_release);
+        }
+
+        if (seq->cursor >= seq->track.num_events) {
+            atomic_store_explicit(&seq->playing, false, memory_order_relaxed);
+            if (held && held->count) {
+                sequence_release_held(sampler, held);
+            }
+            continue;
+        }
+
+        sampler->sequence_heap[size].due = seq->origin + seq->event_frames[seq->cursor];
+        sampler->sequence_heap[size].sequence = seq;
+        size++;
+    }
+
+    for (size_t i = size / 2; i-- > 0;) {
+        sequence_heap_sift_down(sampler->sequence_heap, size, i);
+    }
+
+    sampler->sequence_heap_size = size;
+}
+
+/**
+ * @brief Merge the next events of all playing sequences into this block
+ *
+ * The earliest sequence is taken from the heap top and drained for as long
+ * as it stays ahead of the runner-up, so a burst of events from one
+ * sequence costs a single sift.
+ */
+void sequences_process(ms_sampler_t *sampler, size_t num_frames) {
+    const uint64_t block_end = sampler->sequence_clock + num_frames;
+    uint32_t epoch = atomic_load_explicit(&sampler->sequence_epoch, memory_order_relaxed);
+
+    if (LIKELY(sampler->sequence_heap_size == 0 && epoch == sampler->sequence_heap_epoch)) {
+        sampler->sequence_clock = block_end;
+        return;
+    }
+
+    /* Pairs with sequences_changed(): either it sees busy, or we see its epoch */
+    atomic_store(&sampler->sequences_busy, true);
+
+    epoch = atomic_load(&sampler->sequence_epoch);
+    if (UNLIKELY(epoch != sampler->sequence_heap_epoch)) {
+        sampler->sequence_heap_epoch = epoch;
+        sequences_rebuild(sampler);
+    }
+
+    sequence_heap_entry_t *heap = sampler->sequence_heap;
+    size_t size = sampler->sequence_heap_size;
+
+    while (size > 0 && heap[0].due < block_end) {
+        ms_sequence_t *seq = heap[0].sequence;
+        sequence_held_t *held = sampler->sequence_held[seq->slot];
+        const size_t num_events = seq->track.num_events;
+
+        uint64_t limit = block_end;
+        if (size > 1 && heap[1].due < limit) limit = heap[1].due + 1;
+        if (size > 2 && heap[2].due < limit) limit = heap[2].due + 1;
+
+        uint64_t due = heap[0].due;
+        do {
+            sequence_dispatch(sampler, seq, held, &seq->track.events[seq->cursor++]);
+
+            if (seq->cursor >= num_events) break;
+            due = seq->origin + seq->event_frames[seq->cursor];
+        } while (due < limit);
+
+        if (seq->cursor < num_events) {
+            heap[0].due = due;
+        } else {
+            atomic_store_explicit(&seq->playing, false, memory_order_relaxed);
+            if (held->count) {
+                sequence_release_held(sampler, held);  /* File ended with notes on */
+            }
+            heap[0] = heap[--size];
+        }
+        sequence_heap_sift_down(heap, size, 0);
+    }
+
+    sampler->sequence_heap_size = size;
+    sampler->sequence_clock = block_end;
+
+    atomic_store_explicit(&sampler->sequences_busy, false, memory_order_release);
+}
@@ -0,0 +1,284 @@
+/**
+ * @file shared_rt.c
+ * @brief Sample pools shared between processes through sealed memfds
+ *
+ * One loader process copies the zones of its instruments into a memfd:
+ * a header, a zone table per instrument and every zone's guard-padded PCM.
+ * The memfd is sealed against writes and resizing before anyone sees it,
+ * so the processes that attach it can map it read-only and point their
+ * zones straight into the mapping. The kernel keeps a single copy of the
+ * PCM however many processes play from it.
+ *
+ * Layout (offsets from the start of the memfd):
+ *   shared_pool_header_t
+ *   shared_pool_instrument_t[num_instruments]
+ *   shared_pool_zone_t[num_zones]
+ *   PCM of each zone, cache-line aligned, guard frames included
+ */
+
+#include "internal/internal_rt.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHARED_POOL_MAGIC "MSPOOL01"
+
+typedef struct {
+    char magic[8];
+    uint32_t guard_frames;
+    uint32_t num_instruments;
+    uint32_t num_zones;
+    uint32_t reserved;
+    uint64_t size;                  /* Bytes in the memfd */
+} shared_pool_header_t;
+
+typedef struct {
+    uint32_t first_zone;
+    uint32_t num_zones;
+} shared_pool_instrument_t;
+
+typedef struct {
+    ms_sample_metadata_t meta;
+    uint64_t num_frames;
+    uint64_t offset;                /* Leading guard frame of the PCM */
+    uint16_t channels;
+} shared_pool_zone_t;
+
+/** A mapped pool, shared by every zone attached from it */
+struct shared_pool_t {
+    rt_pinned_block_t mapping;
+    atomic_uint refs;
+};
+
+static size_t align_up(size_t value) {
+    return (value + MS_CACHE_LINE_SIZE - 1) & ~(size_t)(MS_CACHE_LINE_SIZE - 1);
+}
+
+/**
+ * @brief Zones that can go into a pool: resident, with PCM in memory
+ */
+static bool zone_exportable(const ms_sample_data_t *sample) {
+    return sample && sample->data && !sample->streamed;
+}
+
+/* ============================================================================
+ * Loader Process
+ * ========================================================================== */
+
+ms_error_t ms_shared_pool_create(ms_instrument_t *const *instruments, size_t count, int *fd) {
+    if (!instruments || count == 0 || !fd) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!instruments[i]) {
+            return MS_ERROR_INVALID_PARAM;
+        }
+    }
+
+    /* Evicted zones have no PCM to copy; keep the budget from changing that meanwhile */
+    for (size_t i = 0; i < count; i++) {
+        if (instruments[i]->sampler) {
+            residency_lock(instruments[i]->sampler);
+        }
+    }
+
+    size_t num_zones = 0;
+    size_t pcm_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t z = 0; z < instruments[i]->num_samples; z++) {
+            const ms_sample_data_t *sample = instruments[i]->samples[z];
+            if (!zone_exportable(sample)) continue;
+            num_zones++;
+            pcm_bytes += align_up(zone_bytes(sample));
+        }
+    }
+
+    const size_t tables = align_up(sizeof(shared_pool_header_t) +
+                                   count * sizeof(shared_pool_instrument_t) +
+                                   num_zones * sizeof(shared_pool_zone_t));
+    const size_t size = tables + pcm_bytes;
+
+    ms_error_t err = MS_SUCCESS;
+    const int memfd = memfd_create("midi_sampler_pool", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    void *base = MAP_FAILED;
+    if (memfd < 0) {
+        err = MS_ERROR_UNKNOWN;
+    } else if (ftruncate(memfd, (off_t)size) != 0) {
+        err = MS_ERROR_OUT_OF_MEMORY;
+    } else {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (base == MAP_FAILED) {
+            err = MS_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    if (err == MS_SUCCESS) {
+        shared_pool_header_t *header = (shared_pool_header_t*)base;
+        shared_pool_instrument_t *table = (shared_pool_instrument_t*)(header + 1);
+        shared_pool_zone_t *zones = (shared_pool_zone_t*)(table + count);
+
+        memcpy(header->magic, SHARED_POOL_MAGIC, 8);
+        header->guard_frames = MS_SAMPLE_GUARD_FRAMES;
+        header->num_instruments = (uint32_t)count;
+        header->num_zones = (uint32_t)num_zones;
+        header->size = size;
+
+        size_t zone = 0;
+        size_t offset = tables;
+        for (size_t i = 0; i < count; i++) {
+            table[i].first_zone = (uint32_t)zone;
+            for (size_t z = 0; z < instruments[i]->num_samples; z++) {
+                const ms_sample_data_t *sample = instruments[i]->samples[z];
+                if (!zone_exportable(sample)) continue;
+
+                zones[zone].meta = sample->meta;
+                zones[zone].num_frames = sample->num_frames;
+                zones[zone].channels = sample->channels;
+                zones[zone].offset = offset;
+                memcpy((char*)base + offset, sample->data - MS_SAMPLE_GUARD_FRAMES * sample->channels,
+                       zone_bytes(sample));
+
+                offset += align_up(zone_bytes(sample));
+                zone++;
+            }
+            table[i].num_zones = (uint32_t)(zone - table[i].first_zone);
+        }
+
+        munmap(base, size);
+
+        /* Nobody may change the pool once it is handed out */
+        if (fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+            err = MS_ERROR_UNKNOWN;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (instruments[i]->sampler) {
+            residency_unlock(instruments[i]->sampler);
+        }
+    }
+
+    if (err != MS_SUCCESS) {
+        if (memfd >= 0) {
+            close(memfd);
+        }
+        return err;
+    }
+
+    *fd = memfd;
+    return MS_SUCCESS;
+}
+
+/* ============================================================================
+ * Attaching Processes
+ * ========================================================================== */
+
+/**
+ * @brief Drop one zone's reference to its pool; the last one unmaps it
+ */
+void shared_pool_release(struct shared_pool_t *pool) {
+    if (atomic_fetch_sub_explicit(&pool->refs, 1, memory_order_acq_rel) == 1) {
+        rt_pinned_free(&pool->mapping);
+        free(pool);
+    }
+}
+
+static bool pool_valid(const shared_pool_header_t *header, size_t size) {
+    if (size < sizeof(*header) || memcmp(header->magic, SHARED_POOL_MAGIC, 8) != 0 ||
+        header->guard_frames != MS_SAMPLE_GUARD_FRAMES || header->size != size) {
+        return false;
+    }
+
+    const size_t tables = sizeof(*header) +
+                          (size_t)header->num_instruments * sizeof(shared_pool_instrument_t) +
+                          (size_t)header->num_zones * sizeof(shared_pool_zone_t);
+    if (tables > size) return false;
+
+    const shared_pool_instrument_t *table = (const shared_pool_instrument_t*)(header + 1);
+    const shared_pool_zone_t *zones = (const shared_pool_zone_t*)(table + header->num_instruments);
+    for (uint32_t i = 0; i < header->num_instruments; i++) {
+        if ((uint64_t)table[i].first_zone + table[i].num_zones > header->num_zones) return false;
+    }
+    for (uint32_t z = 0; z < header->num_zones; z++) {
+        const uint64_t bytes = (zones[z].num_frames + 2 * MS_SAMPLE_GUARD_FRAMES) *
+                               zones[z].channels * sizeof(float);
+        if (zones[z].channels == 0 || zones[z].offset % MS_CACHE_LINE_SIZE != 0 ||
+            zones[z].offset < tables || zones[z].offset > size || bytes > size - zones[z].offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ms_error_t ms_instrument_attach_shared(ms_instrument_t *instrument, int fd, uint32_t index) {
+    if (!instrument || fd < 0) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    /* Only a pool sealed against writes is safe to play from */
+    const int seals = fcntl(fd, F_GET_SEALS);
+    struct stat st;
+    if (seals < 0 || !(seals & F_SEAL_WRITE) || !(seals & F_SEAL_SHRINK) ||
+        fstat(fd, &st) != 0 || st.st_size <= 0) {
+        return MS_ERROR_INVALID_FORMAT;
+    }
+
+    struct shared_pool_t *pool = (struct shared_pool_t*)calloc(1, sizeof(struct shared_pool_t));
+    if (!pool) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    ms_error_t err = rt_file_map(&pool->mapping, fd, (size_t)st.st_size);
+    if (err != MS_SUCCESS) {
+        free(pool);
+        return err;
+    }
+
+    const shared_pool_header_t *header = (const shared_pool_header_t*)pool->mapping.ptr;
+    if (!pool_valid(header, (size_t)st.st_size) || index >= header->num_instruments) {
+        rt_pinned_free(&pool->mapping);
+        free(pool);
+        return MS_ERROR_INVALID_FORMAT;
+    }
+
+    const shared_pool_instrument_t *entry = (const shared_pool_instrument_t*)(header + 1) + index;
+    const shared_pool_zone_t *zones = (const shared_pool_zone_t*)
+        ((const shared_pool_instrument_t*)(header + 1) + header->num_instruments) + entry->first_zone;
+    if (instrument->num_samples + entry->num_zones > MS_MAX_SAMPLES_PER_INSTRUMENT) {
+        rt_pinned_free(&pool->mapping);
+        free(pool);
+        return MS_ERROR_BUFFER_OVERFLOW;
+    }
+
+    ms_sample_data_t *samples[MS_MAX_SAMPLES_PER_INSTRUMENT];
+    for (uint32_t z = 0; z < entry->num_zones; z++) {
+        samples[z] = (ms_sample_data_t*)aligned_alloc(MS_CACHE_LINE_SIZE, sizeof(ms_sample_data_t));
+        if (!samples[z]) {
+            while (z > 0) free(samples[--z]);
+            rt_pinned_free(&pool->mapping);
+            free(pool);
+            return MS_ERROR_OUT_OF_MEMORY;
+        }
+
+        memset(samples[z], 0, sizeof(ms_sample_data_t));
+        samples[z]->meta = zones[z].meta;
+        samples[z]->num_frames = (size_t)zones[z].num_frames;
+        samples[z]->channels = zones[z].channels;
+        samples[z]->data = (float*)((char*)pool->mapping.ptr + zones[z].offset) +
+                           MS_SAMPLE_GUARD_FRAMES * zones[z].channels;
+        samples[z]->shared = pool;
+    }
+
+    if (entry->num_zones == 0) {
+        rt_pinned_free(&pool->mapping);
+        free(pool);
+        return MS_SUCCESS;
+    }
+
+    atomic_init(&pool->refs, entry->num_zones);
+    for (uint32_t z = 0; z < entry->num_zones; z++) {
+        instrument->samples[instrument->num_samples++] = samples[z];
+    }
+    return MS_SUCCESS;
+}
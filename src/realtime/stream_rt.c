@@ -0,0 +1,903 @@
+/**
+ * @file stream_rt.c
+ * @brief Disk streaming of long samples with pinned zone preloads
+ *
+ * Design:
+ * - Each streamed zone keeps its first preload_frames resident in pinned
+ *   memory, so note-on starts instantly from RAM
+ * - A background streamer thread refills a per-voice ring with the tail
+ *   while the voice plays the preload
+ * - Audio thread <-> streamer communication is lock-free (generation
+ *   counters and fill/read positions, see stream_voice_t)
+ * - A voice that reaches the end of the ring before the streamer caught up
+ *   renders silence and is counted as an underrun
+ * - Refills of all voices are planned per pass and submitted as one batch,
+ *   through io_uring (registered buffers, O_DIRECT) when the kernel allows
+ *   it, otherwise with pread() on the streamer thread. io_uring reads that
+ *   fail or come back short are finished with pread(), and the streamer
+ *   stays on pread() if they keep failing
+ * - While a MIDI file plays, the streamer scans the events ahead of the
+ *   playback position and caches the tail head of every streamed zone they
+ *   will hit, so the first refill after note-on is a memcpy
+ */
+
+#include "internal/internal_rt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STREAM_URING_ERROR_LIMIT 4  /* Passes in a row with a failed io_uring read */
+
+/* ============================================================================
+ * Streamer Thread
+ * ========================================================================== */
+
+/**
+ * @brief Seed a freshly requested ring from the lookahead cache
+ */
+static void stream_take_prefetch(stream_engine_t *engine, stream_voice_t *sv) {
+    if (!engine->prefetch) return;
+
+    const stream_prefetch_t *slot = NULL;
+    for (size_t i = 0; i < engine->num_voices; i++) {
+        if (engine->prefetch[i].sample == sv->source) {
+            slot = &engine->prefetch[i];
+            break;
+        }
+    }
+
+    if (slot) {
+        memcpy(sv->ring, slot->data, slot->frames * sv->source->channels * sizeof(float));
+        sv->source_fill = slot->frames;
+        atomic_store_explicit(&sv->fill_frames, slot->frames, memory_order_release);
+        atomic_fetch_add_explicit(&engine->prefetch_hits, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&engine->prefetch_misses, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Plan the next refill of one voice ring
+ *
+ * Picks up new requests from the audio thread and describes the next
+ * contiguous ring segment to read. O_DIRECT reads are widened to the
+ * alignment the kernel requires; the extra bytes are skipped on completion.
+ *
+ * @return true if a read was planned into req
+ */
+static bool stream_plan_refill(stream_engine_t *engine, size_t slot, stream_request_t *req) {
+    stream_voice_t *sv = &engine->voices[slot];
+    
+    /* Pick up a new request from the audio thread */
+    uint32_t request = atomic_load_explicit(&sv->request_gen, memory_order_acquire);
+    if (request != sv->source_gen) {
+        sv->source_gen = request;
+        sv->source = atomic_load_explicit(&sv->request_sample, memory_order_relaxed);
+        sv->source_fill = 0;
+        atomic_store_explicit(&sv->fill_frames, 0, memory_order_relaxed);
+        atomic_store_explicit(&sv->serviced_gen, request, memory_order_release);
+        
+        if (sv->source) {
+            stream_take_prefetch(engine, sv);
+        }
+    }
+
+    ms_sample_data_t *sample = sv->source;
+    if (!sample) return false;
+
+    const size_t ring_frames = sv->ring_mask + 1;
+    const size_t tail_frames = sample->num_frames - sample->preload_frames;
+    size_t fill = sv->source_fill;
+    size_t read = atomic_load_explicit(&sv->read_frames, memory_order_acquire);
+
+    /* The voice outran the stream; frames behind it are no longer needed */
+    if (read > fill) {
+        fill = read;
+        sv->source_fill = fill;
+    }
+
+    /* Batch small top-ups: refill once a quarter of the ring has drained */
+    if (fill >= tail_frames || ring_frames - (fill - read) < ring_frames / 4) {
+        return false;
+    }
+
+    size_t ring_pos = fill & sv->ring_mask;
+    size_t count = ring_frames - (fill - read);
+    if (count > ring_frames - ring_pos) count = ring_frames - ring_pos;
+    if (count > tail_frames - fill) count = tail_frames - fill;
+    if (count > engine->chunk_frames) count = engine->chunk_frames;
+
+    const size_t frame_bytes = sample->channels * (sample->stream_bits / 8);
+    const uint64_t offset = sample->stream_data_offset +
+                            (sample->preload_frames + fill) * frame_bytes;
+    const size_t bytes = count * frame_bytes;
+
+    req->sv = sv;
+    req->sample = sample;
+    req->frames = count;
+    req->fd = sample->stream_io_fd;
+    req->buf_index = (int)slot;
+    req->result = 0;
+
+    if (sample->stream_io_fd != sample->stream_fd) {
+        uint64_t aligned = offset & ~(uint64_t)(MS_STREAM_IO_ALIGN - 1);
+        req->skip = (size_t)(offset - aligned);
+        req->length = (req->skip + bytes + MS_STREAM_IO_ALIGN - 1) &
+                      ~(size_t)(MS_STREAM_IO_ALIGN - 1);
+        req->offset = (off_t)aligned;
+    } else {
+        req->skip = 0;
+        req->length = bytes;
+        req->offset = (off_t)offset;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Convert a completed read into the voice ring and publish it
+ *
+ * @return true if the full request was delivered
+ */
+static bool stream_complete_refill(stream_engine_t *engine, const stream_request_t *req) {
+    stream_voice_t *sv = req->sv;
+    const ms_sample_data_t *sample = req->sample;
+    const size_t frame_bytes = sample->channels * (sample->stream_bits / 8);
+
+    size_t frames = 0;
+    if (req->result > (ssize_t)req->skip) {
+        frames = ((size_t)req->result - req->skip) / frame_bytes;
+        if (frames > req->frames) frames = req->frames;
+        atomic_fetch_add_explicit(&engine->bytes_read, (uint64_t)req->result,
+                                  memory_order_relaxed);
+    }
+
+    size_t fill = sv->source_fill;
+    wav_pcm_to_float(sv->staging + req->skip, sample->stream_bits,
+                     sv->ring + (fill & sv->ring_mask) * sample->channels,
+                     frames * sample->channels);
+
+    fill += frames;
+    sv->source_fill = fill;
+    atomic_store_explicit(&sv->fill_frames, fill, memory_order_release);
+
+    MS_TRACE4(stream_refill, sample, req->buf_index, frames,
+              fill - atomic_load_explicit(&sv->read_frames, memory_order_relaxed));
+
+    /* A short read means end of file or an I/O error: don't spin on it */
+    return frames == req->frames;
+}
+
+/**
+ * @brief Read a request with pread() from byte done on
+ *
+ * If O_DIRECT refuses the read (alignment, a file system without it), the
+ * rest goes through the zone's buffered descriptor.
+ */
+static void stream_pread_request(stream_request_t *req, size_t done) {
+    int fd = req->fd;
+
+    while (done < req->length) {
+        ssize_t n = pread(fd, req->sv->staging + done, req->length - done,
+                          req->offset + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && fd != req->sample->stream_fd) {
+            fd = req->sample->stream_fd;
+            continue;
+        }
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+
+    req->result = (ssize_t)done;
+}
+
+static void stream_execute_pread(stream_engine_t *engine, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        stream_pread_request(&engine->requests[i], 0);
+    }
+}
+
+/**
+ * @brief Submit a whole batch with one io_uring_enter() and reap it
+ *
+ * @return false if the ring failed and the batch must be retried with pread
+ */
+static bool stream_execute_uring(stream_engine_t *engine, size_t count) {
+    rt_uring_t *ring = &engine->uring;
+
+    for (size_t i = 0; i < count; i++) {
+        stream_request_t *req = &engine->requests[i];
+        if (!rt_uring_queue_read(ring, req->fd, req->sv->staging, req->length,
+                                 req->offset, req->buf_index, i)) {
+            return false;
+        }
+    }
+
+    if (rt_uring_submit_and_wait(ring, (unsigned)count) < 0) {
+        return false;
+    }
+
+    size_t reaped = 0;
+    uint64_t index;
+    int32_t result;
+    while (reaped < count) {
+        if (!rt_uring_pop_completion(ring, &index, &result)) {
+            if (rt_uring_submit_and_wait(ring, 1) < 0) return false;
+            continue;
+        }
+        if (index < count) {
+            engine->requests[index].result = result;
+        }
+        reaped++;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Finish io_uring reads that failed or came back short with pread()
+ *
+ * A failed read (an opcode the kernel lacks, O_DIRECT refusing the
+ * request) is redone and a short one continued, so the voice does not
+ * underrun on every pass. After STREAM_URING_ERROR_LIMIT passes in a row
+ * with failures the streamer switches to pread() for good.
+ */
+static void stream_finish_uring(stream_engine_t *engine, size_t count) {
+    bool failed = false;
+
+    for (size_t i = 0; i < count; i++) {
+        stream_request_t *req = &engine->requests[i];
+        if (req->result < 0) {
+            failed = true;
+            stream_pread_request(req, 0);
+        } else if ((size_t)req->result < req->length) {
+            stream_pread_request(req, (size_t)req->result);
+        }
+    }
+
+    engine->uring_error_passes = failed ? engine->uring_error_passes + 1 : 0;
+    if (engine->uring_error_passes >= STREAM_URING_ERROR_LIMIT) {
+        rt_uring_destroy(&engine->uring);
+        engine->io = MS_STREAM_IO_PREAD;
+    }
+}
+
+/**
+ * @brief One streamer pass: plan, submit and complete a refill per voice
+ *
+ * @return Number of voices whose refill was delivered in full
+ */
+static size_t stream_pass(stream_engine_t *engine) {
+    size_t count = 0;
+    for (size_t i = 0; i < engine->num_voices; i++) {
+        if (stream_plan_refill(engine, i, &engine->requests[count])) {
+            count++;
+        }
+    }
+
+    if (count == 0) return 0;
+
+    atomic_store_explicit(&engine->queue_depth, (uint32_t)count, memory_order_relaxed);
+    if (count > atomic_load_explicit(&engine->max_queue_depth, memory_order_relaxed)) {
+        atomic_store_explicit(&engine->max_queue_depth, (uint32_t)count, memory_order_relaxed);
+    }
+
+    if (engine->io == MS_STREAM_IO_URING) {
+        if (stream_execute_uring(engine, count)) {
+            stream_finish_uring(engine, count);
+        } else {
+            /* The ring broke (e.g. resource limits); keep streaming with pread */
+            rt_uring_destroy(&engine->uring);
+            engine->io = MS_STREAM_IO_PREAD;
+            stream_execute_pread(engine, count);
+        }
+    } else {
+        stream_execute_pread(engine, count);
+    }
+
+    size_t complete = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (stream_complete_refill(engine, &engine->requests[i])) {
+            complete++;
+        }
+    }
+
+    atomic_fetch_add_explicit(&engine->reads, count, memory_order_relaxed);
+    return complete;
+}
+
+/**
+ * @brief Cache the tail head of a zone a scheduled note-on will hit
+ *
+ * Reuses the zone's slot if it is already cached, otherwise takes a free
+ * slot or one whose note-on has long passed.
+ */
+static void stream_prefetch_zone(stream_engine_t *engine, ms_sample_data_t *sample,
+                                 uint64_t due, uint64_t position) {
+    pthread_mutex_lock(&engine->io_lock);
+
+    stream_prefetch_t *slot = NULL;
+    stream_prefetch_t *spare = NULL;
+    for (size_t i = 0; i < engine->num_voices; i++) {
+        stream_prefetch_t *p = &engine->prefetch[i];
+        if (p->sample == sample) {
+            slot = p;
+            break;
+        }
+        if (!spare && (!p->sample || p->expires < position)) {
+            spare = p;
+        }
+    }
+
+    if (slot) {
+        if (due + engine->lookahead_frames > slot->expires) {
+            slot->expires = due + engine->lookahead_frames;
+        }
+        pthread_mutex_unlock(&engine->io_lock);
+        return;
+    }
+
+    if (!spare) {
+        pthread_mutex_unlock(&engine->io_lock);
+        return;  /* Cache full: the note-on will count as a miss */
+    }
+
+    size_t frames = sample->num_frames - sample->preload_frames;
+    if (frames > engine->prefetch_frames) frames = engine->prefetch_frames;
+
+    const size_t frame_bytes = sample->channels * (sample->stream_bits / 8);
+    const off_t offset = (off_t)(sample->stream_data_offset +
+                                 sample->preload_frames * frame_bytes);
+    size_t done = 0;
+    while (done < frames * frame_bytes) {
+        ssize_t n = pread(sample->stream_fd, engine->prefetch_raw + done,
+                          frames * frame_bytes - done, offset + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+
+    frames = done / frame_bytes;
+    wav_pcm_to_float(engine->prefetch_raw, sample->stream_bits, spare->data,
+                     frames * sample->channels);
+
+    spare->sample = frames > 0 ? sample : NULL;
+    spare->frames = frames;
+    spare->expires = due + engine->lookahead_frames;
+
+    atomic_fetch_add_explicit(&engine->bytes_read, done, memory_order_relaxed);
+    atomic_fetch_add_explicit(&engine->prefetches, 1, memory_order_relaxed);
+
+    pthread_mutex_unlock(&engine->io_lock);
+}
+
+/**
+ * @brief Get the zone a note-on will hit ready: prefetch its stream head
+ *        or have the memory budget reload its body
+ */
+static void stream_lookahead_note(ms_sampler_t *sampler, ms_instrument_t *instrument,
+                                  const midi_event_t *ev, uint64_t due, uint64_t now) {
+    if (!instrument || ev->type != MIDI_NOTE_ON || ev->data2 == 0) return;
+
+    ms_sample_data_t *sample = instrument_find_sample(instrument, ev->data1, ev->data2);
+    if (!sample) return;
+
+    if (sample->streamed) {
+        stream_prefetch_zone(&sampler->streamer, sample, due, now);
+    } else if (sample->residency) {
+        zone_expect(sampler, sample);
+    }
+}
+
+/**
+ * @brief Scan the single-file player's upcoming events
+ */
+static void stream_lookahead_track(ms_sampler_t *sampler, uint64_t now) {
+    stream_engine_t *engine = &sampler->streamer;
+
+    const midi_track_t *track = sampler->current_track;
+    if (!track || !sampler->playback_instrument ||
+        !atomic_load_explicit(&sampler->is_playing, memory_order_acquire)) {
+        return;
+    }
+
+    /* Track reloaded or playback restarted: rescan from the start */
+    uint32_t epoch = atomic_load_explicit(&sampler->playback_epoch, memory_order_acquire);
+    if (epoch != engine->lookahead_epoch) {
+        engine->lookahead_epoch = epoch;
+        engine->lookahead_cursor = 0;
+    }
+
+    size_t index = atomic_load_explicit(&sampler->playback_event_index, memory_order_acquire);
+    uint64_t position = atomic_load_explicit(&sampler->playback_sample_count,
+                                             memory_order_acquire);
+    uint64_t horizon = position + engine->lookahead_frames;
+
+    if (engine->lookahead_cursor < index) {
+        engine->lookahead_cursor = index;
+    }
+
+    size_t i = engine->lookahead_cursor;
+    for (; i < track->num_events && sampler->event_frames[i] < horizon; i++) {
+        uint64_t ahead = sampler->event_frames[i] > position ?
+                         sampler->event_frames[i] - position : 0;
+        stream_lookahead_note(sampler, sampler->playback_instrument, &track->events[i],
+                              now + ahead, now);
+    }
+    engine->lookahead_cursor = i;
+}
+
+/**
+ * @brief Scan a playing sequence's upcoming events
+ *
+ * Each sequence keeps its own cursor, positioned from the origin the audio
+ * thread published when it served the latest start.
+ */
+static void stream_lookahead_sequence(ms_sampler_t *sampler, ms_sequence_t *seq,
+                                      uint64_t now) {
+    stream_engine_t *engine = &sampler->streamer;
+
+    if (!atomic_load_explicit(&seq->playing, memory_order_acquire)) return;
+
+    /* Not served yet: the origin still belongs to the previous start */
+    uint32_t gen = atomic_load_explicit(&seq->played_gen, memory_order_acquire);
+    if (gen != atomic_load_explicit(&seq->request_gen, memory_order_acquire)) return;
+
+    uint64_t origin = atomic_load_explicit(&seq->played_origin, memory_order_relaxed);
+    uint64_t position = now > origin ? now - origin : 0;
+    uint64_t horizon = position + engine->lookahead_frames;
+
+    if (gen != seq->lookahead_gen) {
+        seq->lookahead_gen = gen;
+        seq->lookahead_cursor = 0;
+    }
+
+    size_t i = seq->lookahead_cursor;
+    const size_t num_events = seq->track.num_events;
+
+    /* Skip what already played (first scan after a start or seek) */
+    while (i < num_events && seq->event_frames[i] < position) i++;
+
+    for (; i < num_events && seq->event_frames[i] < horizon; i++) {
+        const midi_event_t *ev = &seq->track.events[i];
+        ms_instrument_t *instrument = atomic_load_explicit(&seq->channels[ev->channel & 0x0F],
+                                                           memory_order_acquire);
+        stream_lookahead_note(sampler, instrument, ev, origin + seq->event_frames[i], now);
+    }
+    seq->lookahead_cursor = i;
+}
+
+/**
+ * @brief Scan upcoming sequencer events and prefetch the zones they hit
+ *
+ * Covers the single-file player and every playing sequence. Prefetch
+ * slots are dated in engine frames so both share one expiry clock.
+ * Evicted zones under a memory budget are flagged for reload as well.
+ */
+static void stream_lookahead(ms_sampler_t *sampler) {
+    uint64_t now = atomic_load_explicit(&sampler->frames_processed, memory_order_relaxed);
+
+    pthread_mutex_lock(&sampler->control_lock);
+
+    stream_lookahead_track(sampler, now);
+
+    for (size_t i = 0; i < MS_MAX_SEQUENCES; i++) {
+        if (sampler->sequences[i]) {
+            stream_lookahead_sequence(sampler, sampler->sequences[i], now);
+        }
+    }
+
+    pthread_mutex_unlock(&sampler->control_lock);
+}
+
+static void *stream_thread_main(void *arg) {
+    ms_sampler_t *sampler = (ms_sampler_t*)arg;
+    stream_engine_t *engine = &sampler->streamer;
+
+    /* Wake often enough that a ring is topped up well within the preload */
+    long period_ns = (long)(engine->config.preload_ms * 1000000.0f / 4.0f);
+    if (period_ns < 1000000L) period_ns = 1000000L;
+    struct timespec period = {
+        .tv_sec = period_ns / 1000000000L,
+        .tv_nsec = period_ns % 1000000000L
+    };
+
+    uint64_t window_start = ms_now_ns();
+    uint64_t window_reads = 0;
+
+    while (atomic_load_explicit(&engine->running, memory_order_acquire)) {
+        if (engine->prefetch) {
+            stream_lookahead(sampler);
+        }
+        
+        pthread_mutex_lock(&engine->io_lock);
+        for (int pass = 0; pass < MS_STREAM_MAX_PASSES; pass++) {
+            if (stream_pass(engine) == 0) break;
+        }
+        pthread_mutex_unlock(&engine->io_lock);
+
+        uint64_t now = ms_now_ns();
+        if (now - window_start >= 1000000000ULL) {
+            uint64_t reads = atomic_load_explicit(&engine->reads, memory_order_relaxed);
+            uint64_t iops = (reads - window_reads) * 1000000000ULL / (now - window_start);
+            atomic_store_explicit(&engine->iops, (uint32_t)iops, memory_order_relaxed);
+            window_reads = reads;
+            window_start = now;
+        }
+
+        nanosleep(&period, NULL);
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+/**
+ * @brief Free everything ms_sampler_enable_streaming() set up
+ *
+ * The streamer thread must not be running.
+ */
+static void stream_engine_release(ms_sampler_t *sampler) {
+    stream_engine_t *engine = &sampler->streamer;
+
+    for (size_t i = 0; i < engine->num_voices; i++) {
+        sampler->voices[i].stream = NULL;
+    }
+
+    if (engine->io == MS_STREAM_IO_URING) {
+        rt_uring_destroy(&engine->uring);
+    }
+
+    free(engine->prefetch);
+    engine->prefetch = NULL;
+    free(engine->prefetch_raw);
+    engine->prefetch_raw = NULL;
+    rt_pinned_free(&engine->prefetch_block);
+
+    free(engine->requests);
+    engine->requests = NULL;
+    rt_pinned_free(&engine->staging);
+    rt_pinned_free(&engine->rings);
+    free(engine->voices);
+    engine->voices = NULL;
+    engine->num_voices = 0;
+}
+
+ms_error_t ms_sampler_enable_streaming(ms_sampler_t *sampler, const ms_stream_config_t *config) {
+    if (!sampler) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    stream_engine_t *engine = &sampler->streamer;
+    if (engine->voices) {
+        return MS_ERROR_INVALID_PARAM;  /* Already enabled */
+    }
+
+    ms_stream_config_t cfg = {
+        .preload_ms = MS_STREAM_DEFAULT_PRELOAD_MS,
+        .max_start_offset = 0,
+        .ring_frames = MS_STREAM_DEFAULT_RING_FRAMES,
+        .io_backend = MS_STREAM_IO_AUTO,
+        .direct_io = true,
+        .lookahead_ms = MS_STREAM_DEFAULT_LOOKAHEAD_MS
+    };
+    if (config) {
+        cfg = *config;
+    }
+
+    if (cfg.preload_ms <= 0.0f || cfg.lookahead_ms < 0.0f || cfg.ring_frames < 1024 ||
+        (cfg.ring_frames & (cfg.ring_frames - 1)) != 0) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    size_t num_voices = sampler->config.max_polyphony < MS_MAX_VOICES ?
+                        sampler->config.max_polyphony : MS_MAX_VOICES;
+
+    /* Preload covers the streamer latency, rounded to whole blocks */
+    size_t preload = (size_t)(cfg.preload_ms * sampler->config.sample_rate / 1000.0f + 0.5f);
+    if (sampler->config.buffer_size > 0) {
+        preload = (preload + sampler->config.buffer_size - 1) /
+                  sampler->config.buffer_size * sampler->config.buffer_size;
+    }
+    preload += cfg.max_start_offset;
+
+    engine->voices = (stream_voice_t*)aligned_alloc(MS_CACHE_LINE_SIZE,
+                                                    num_voices * sizeof(stream_voice_t));
+    if (!engine->voices) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    memset(engine->voices, 0, num_voices * sizeof(stream_voice_t));
+
+    size_t ring_floats = (size_t)cfg.ring_frames * MS_STREAM_MAX_CHANNELS;
+    ms_error_t err = rt_pinned_alloc(&engine->rings, num_voices * ring_floats * sizeof(float));
+    if (err != MS_SUCCESS) {
+        free(engine->voices);
+        engine->voices = NULL;
+        return err;
+    }
+
+    /* Staging buffers hold one refill of raw PCM plus O_DIRECT alignment slack */
+    engine->chunk_frames = cfg.ring_frames / 2;
+    engine->staging_stride = (engine->chunk_frames * MS_STREAM_MAX_CHANNELS * sizeof(int16_t) +
+                              3 * MS_STREAM_IO_ALIGN - 1) & ~(size_t)(MS_STREAM_IO_ALIGN - 1);
+    err = rt_pinned_alloc(&engine->staging, num_voices * engine->staging_stride);
+    if (err != MS_SUCCESS) {
+        rt_pinned_free(&engine->rings);
+        free(engine->voices);
+        engine->voices = NULL;
+        return err;
+    }
+
+    engine->requests = (stream_request_t*)calloc(num_voices, sizeof(stream_request_t));
+    if (!engine->requests) {
+        rt_pinned_free(&engine->staging);
+        rt_pinned_free(&engine->rings);
+        free(engine->voices);
+        engine->voices = NULL;
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    engine->num_voices = num_voices;
+    engine->config = cfg;
+    engine->preload_frames = preload;
+
+    /* Lookahead cache: one slot per voice, each a quarter ring of tail */
+    if (cfg.lookahead_ms > 0.0f) {
+        engine->prefetch_frames = cfg.ring_frames / 4;
+        size_t slot_floats = engine->prefetch_frames * MS_STREAM_MAX_CHANNELS;
+
+        engine->prefetch = (stream_prefetch_t*)calloc(num_voices, sizeof(stream_prefetch_t));
+        engine->prefetch_raw = (uint8_t*)malloc(slot_floats * sizeof(int16_t));
+        if (!engine->prefetch || !engine->prefetch_raw ||
+            rt_pinned_alloc(&engine->prefetch_block,
+                            num_voices * slot_floats * sizeof(float)) != MS_SUCCESS) {
+            stream_engine_release(sampler);
+            return MS_ERROR_OUT_OF_MEMORY;
+        }
+
+        for (size_t i = 0; i < num_voices; i++) {
+            engine->prefetch[i].data = (float*)engine->prefetch_block.ptr + i * slot_floats;
+        }
+        engine->lookahead_frames = (uint64_t)(cfg.lookahead_ms *
+                                              sampler->config.sample_rate / 1000.0f);
+        engine->lookahead_cursor = 0;
+        engine->lookahead_epoch = 0;
+    }
+
+    float *rings = (float*)engine->rings.ptr;
+    for (size_t i = 0; i < num_voices; i++) {
+        stream_voice_t *sv = &engine->voices[i];
+        atomic_init(&sv->request_sample, NULL);
+        atomic_init(&sv->request_gen, 0);
+        atomic_init(&sv->read_frames, 0);
+        atomic_init(&sv->serviced_gen, 0);
+        atomic_init(&sv->fill_frames, 0);
+        atomic_init(&sv->starts, 0);
+        atomic_init(&sv->underruns, 0);
+        atomic_init(&sv->underrun_frames, 0);
+        sv->ring = rings + i * ring_floats;
+        sv->ring_mask = cfg.ring_frames - 1;
+        sv->staging = (uint8_t*)engine->staging.ptr + i * engine->staging_stride;
+        sampler->voices[i].stream = sv;
+    }
+
+    /* Resolve the I/O backend; registered buffers are optional (RLIMIT_MEMLOCK) */
+    engine->io = MS_STREAM_IO_PREAD;
+    engine->uring_error_passes = 0;
+    if (cfg.io_backend != MS_STREAM_IO_PREAD) {
+        if (rt_uring_init(&engine->uring, (unsigned)num_voices) == MS_SUCCESS) {
+            struct iovec iov[MS_MAX_VOICES];
+            for (size_t i = 0; i < num_voices; i++) {
+                iov[i].iov_base = engine->voices[i].staging;
+                iov[i].iov_len = engine->staging_stride;
+            }
+            rt_uring_register_buffers(&engine->uring, iov, (unsigned)num_voices);
+            engine->io = MS_STREAM_IO_URING;
+        } else if (cfg.io_backend == MS_STREAM_IO_URING) {
+            stream_engine_release(sampler);
+            return MS_ERROR_NOT_INITIALIZED;
+        }
+    }
+
+    atomic_init(&engine->bytes_read, 0);
+    atomic_init(&engine->reads, 0);
+    atomic_init(&engine->iops, 0);
+    atomic_init(&engine->queue_depth, 0);
+    atomic_init(&engine->max_queue_depth, 0);
+    atomic_init(&engine->prefetches, 0);
+    atomic_init(&engine->prefetch_hits, 0);
+    atomic_init(&engine->prefetch_misses, 0);
+    pthread_mutex_init(&engine->io_lock, NULL);
+    atomic_store(&engine->running, true);
+
+    if (pthread_create(&engine->thread, NULL, stream_thread_main, sampler) != 0) {
+        atomic_store(&engine->running, false);
+        pthread_mutex_destroy(&engine->io_lock);
+        stream_engine_release(sampler);
+        return MS_ERROR_UNKNOWN;
+    }
+
+    return MS_SUCCESS;
+}
+
+void stream_engine_shutdown(ms_sampler_t *sampler) {
+    stream_engine_t *engine = &sampler->streamer;
+    if (!engine->voices) return;
+
+    atomic_store(&engine->running, false);
+    pthread_join(engine->thread, NULL);
+
+    pthread_mutex_destroy(&engine->io_lock);
+    stream_engine_release(sampler);
+}
+
+ms_error_t ms_instrument_load_sample_streamed(ms_instrument_t *instrument,
+                                              const char *filepath,
+                                              const ms_sample_metadata_t *metadata) {
+    if (!instrument || !instrument->sampler || !filepath || !metadata) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    stream_engine_t *engine = &instrument->sampler->streamer;
+    if (!engine->voices) {
+        return MS_ERROR_NOT_INITIALIZED;
+    }
+
+    if (instrument->num_samples >= MS_MAX_SAMPLES_PER_INSTRUMENT) {
+        return MS_ERROR_BUFFER_OVERFLOW;
+    }
+
+    wav_info_t info;
+    ms_error_t err = wav_probe_file(filepath, &info);
+    if (err != MS_SUCCESS) {
+        return err;
+    }
+
+    if (info.channels > MS_STREAM_MAX_CHANNELS || info.num_frames == 0) {
+        return MS_ERROR_INVALID_FORMAT;
+    }
+
+    /* Looped zones would have to re-stream on every wrap: keep them resident */
+    size_t preload = engine->preload_frames;
+    bool streamed = !metadata->loop_enabled && info.num_frames > preload;
+    if (!streamed) {
+        preload = info.num_frames;
+    }
+
+    ms_sample_data_t *sample = (ms_sample_data_t*)aligned_alloc(
+        MS_CACHE_LINE_SIZE, sizeof(ms_sample_data_t)
+    );
+    if (!sample) {
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+    memset(sample, 0, sizeof(*sample));
+    sample->stream_fd = -1;
+    sample->stream_io_fd = -1;
+
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        free(sample);
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    /* Resident zones get guard frames around them for the voice kernel */
+    const size_t guard = streamed ? 0 : MS_SAMPLE_GUARD_FRAMES * info.channels;
+    err = rt_pinned_alloc(&sample->preload, (preload * info.channels + 2 * guard) * sizeof(float));
+    if (err != MS_SUCCESS) {
+        close(fd);
+        free(sample);
+        return err;
+    }
+
+    sample->data = (float*)sample->preload.ptr + guard;
+    sample->num_frames = info.num_frames;
+    sample->channels = info.channels;
+    sample->meta = *metadata;
+    sample->preload_frames = preload;
+    sample->stream_fd = fd;
+    sample->stream_data_offset = info.data_offset;
+    sample->stream_bits = info.bits_per_sample;
+
+    /* Read and convert the preload head */
+    size_t frame_bytes = info.channels * (info.bits_per_sample / 8);
+    uint8_t *raw = (uint8_t*)malloc(preload * frame_bytes);
+    if (!raw) {
+        rt_pinned_free(&sample->preload);
+        close(fd);
+        free(sample);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    size_t done = 0;
+    while (done < preload * frame_bytes) {
+        ssize_t n = pread(fd, raw + done, preload * frame_bytes - done,
+                          (off_t)(info.data_offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+
+    if (done < preload * frame_bytes) {
+        free(raw);
+        rt_pinned_free(&sample->preload);
+        close(fd);
+        free(sample);
+        return MS_ERROR_INVALID_FORMAT;
+    }
+
+    wav_pcm_to_float(raw, info.bits_per_sample, sample->data, preload * info.channels);
+    free(raw);
+
+    if (streamed) {
+        sample->streamed = true;
+        sample->stream_io_fd = fd;
+        
+        /* Tail refills bypass the page cache; tmpfs and friends refuse O_DIRECT */
+        if (engine->config.direct_io) {
+            int direct_fd = open(filepath, O_RDONLY | O_DIRECT | O_CLOEXEC);
+            if (direct_fd >= 0) {
+                sample->stream_io_fd = direct_fd;
+            }
+        }
+    } else {
+        close(fd);
+        sample->stream_fd = -1;
+        sample_guard_fill(sample);
+    }
+
+    atomic_fetch_add(&engine->preload_bytes, sample->preload.length);
+    if (sample->preload.hugetlb) {
+        atomic_fetch_add(&engine->preload_hugepage_bytes, sample->preload.length);
+    }
+
+    instrument->samples[instrument->num_samples++] = sample;
+    return MS_SUCCESS;
+}
+
+void stream_sample_destroy(ms_sampler_t *sampler, ms_sample_data_t *sample) {
+    if (!sample) return;
+
+    if (sampler) {
+        stream_engine_t *engine = &sampler->streamer;
+        atomic_fetch_sub(&engine->preload_bytes, sample->preload.length);
+        if (sample->preload.hugetlb) {
+            atomic_fetch_sub(&engine->preload_hugepage_bytes, sample->preload.length);
+        }
+
+        /* Detach the zone from the streamer before its file and preload go */
+        if (engine->voices) {
+            pthread_mutex_lock(&engine->io_lock);
+            for (size_t i = 0; i < engine->num_voices; i++) {
+                if (engine->voices[i].source == sample) {
+                    engine->voices[i].source = NULL;
+                }
+                if (engine->prefetch && engine->prefetch[i].sample == sample) {
+                    engine->prefetch[i].sample = NULL;
+                }
+            }
+            pthread_mutex_unlock(&engine->io_lock);
+        }
+    }
+
+    if (sample->stream_io_fd >= 0 && sample->stream_io_fd != sample->stream_fd) {
+        close(sample->stream_io_fd);
+    }
+    sample->stream_io_fd = -1;
+    
+    if (sample->stream_fd >= 0) {
+        close(sample->stream_fd);
+        sample->stream_fd = -1;
+    }
+
+    rt_pinned_free(&sample->preload);
+    sample->data = NULL;
+    sample->streamed = false;
+}
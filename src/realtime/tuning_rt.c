@@ -0,0 +1,303 @@
+/**
+ * @file tuning_rt.c
+ * @brief Microtuning: Scala scales and keyboard mappings, master tune
+ *
+ * Everything here runs on the control thread. A tuning is resolved into
+ * one frequency per MIDI note up front, so a note-on only looks up its
+ * frequency. Each instrument double-buffers its table: the new table is
+ * written into the buffer the audio thread is not using and published
+ * with a single index store.
+ */
+
+#include "internal/internal_rt.h"
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCALA_MAX_DEGREES 1024
+#define SCALA_LINE_SIZE 256
+
+/* ============================================================================
+ * Scala Parsing
+ * ========================================================================== */
+
+/**
+ * @brief Read the next line that is not a '!' comment
+ *
+ * @return Pointer to the line with leading whitespace skipped, NULL at EOF
+ */
+static char *scala_next_line(FILE *fp, char *line) {
+    while (fgets(line, SCALA_LINE_SIZE, fp)) {
+        if (line[0] == '!') continue;
+
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        return p;
+    }
+    return NULL;
+}
+
+static bool scala_read_int(FILE *fp, char *line, long *value) {
+    char *p = scala_next_line(fp, line);
+    if (!p) return false;
+
+    char *end;
+    *value = strtol(p, &end, 10);
+    return end != p;
+}
+
+/**
+ * @brief Parse a scale degree: cents if it has a '.', a ratio otherwise
+ */
+static bool scala_parse_pitch(const char *p, double *ratio) {
+    const char *token_end = p + strcspn(p, " \t\r\n");
+    const char *dot = memchr(p, '.', (size_t)(token_end - p));
+    char *end;
+
+    if (dot) {
+        const double cents = strtod(p, &end);
+        if (end == p) return false;
+        *ratio = exp2(cents / 1200.0);
+        return true;
+    }
+
+    const long num = strtol(p, &end, 10);
+    if (end == p || num <= 0) return false;
+
+    long den = 1;
+    if (*end == '/') {
+        const char *den_start = end + 1;
+        den = strtol(den_start, &end, 10);
+        if (end == den_start || den <= 0) return false;
+    }
+
+    *ratio = (double)num / (double)den;
+    return true;
+}
+
+/**
+ * @brief Load the degrees of a .scl file
+ *
+ * @param ratios Output, ratios[0] = 1 and ratios[num_degrees] = period
+ */
+static ms_error_t scala_load_scale(const char *path, double *ratios, size_t *num_degrees) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    char line[SCALA_LINE_SIZE];
+    long count;
+    ms_error_t err = MS_SUCCESS;
+
+    /* Description line, then the number of degrees */
+    if (!scala_next_line(fp, line) || !scala_read_int(fp, line, &count) ||
+        count < 1 || count > SCALA_MAX_DEGREES) {
+        err = MS_ERROR_INVALID_FORMAT;
+    }
+
+    ratios[0] = 1.0;
+    for (long i = 1; err == MS_SUCCESS && i <= count; i++) {
+        const char *p = scala_next_line(fp, line);
+        if (!p || !scala_parse_pitch(p, &ratios[i])) {
+            err = MS_ERROR_INVALID_FORMAT;
+        }
+    }
+
+    fclose(fp);
+    *num_degrees = (size_t)count;
+    return err;
+}
+
+typedef struct {
+    long size;                  /* 0 = linear: every key is the next degree */
+    long first_note;
+    long last_note;
+    long middle_note;           /* Key that plays degree 0 */
+    long reference_note;
+    double reference_frequency;
+    long octave_degree;         /* Degree the mapping repeats at */
+    long map[128];              /* -1 = key not mapped */
+} keyboard_map_t;
+
+static ms_error_t scala_load_mapping(const char *path, keyboard_map_t *kbm) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return MS_ERROR_FILE_NOT_FOUND;
+    }
+
+    char line[SCALA_LINE_SIZE];
+    ms_error_t err = MS_SUCCESS;
+
+    if (!scala_read_int(fp, line, &kbm->size) ||
+        !scala_read_int(fp, line, &kbm->first_note) ||
+        !scala_read_int(fp, line, &kbm->last_note) ||
+        !scala_read_int(fp, line, &kbm->middle_note) ||
+        !scala_read_int(fp, line, &kbm->reference_note)) {
+        err = MS_ERROR_INVALID_FORMAT;
+    }
+
+    const char *p = err == MS_SUCCESS ? scala_next_line(fp, line) : NULL;
+    if (p) {
+        char *end;
+        kbm->reference_frequency = strtod(p, &end);
+        if (end == p || kbm->reference_frequency <= 0.0) {
+            err = MS_ERROR_INVALID_FORMAT;
+        }
+    } else {
+        err = MS_ERROR_INVALID_FORMAT;
+    }
+
+    if (err == MS_SUCCESS && (!scala_read_int(fp, line, &kbm->octave_degree) ||
+                              kbm->size < 0 || kbm->size > 128 ||
+                              kbm->reference_note < 0 || kbm->reference_note > 127)) {
+        err = MS_ERROR_INVALID_FORMAT;
+    }
+
+    /* Mapping entries; missing trailing entries count as unmapped */
+    for (long i = 0; err == MS_SUCCESS && i < kbm->size; i++) {
+        p = scala_next_line(fp, line);
+        if (!p || *p == 'x' || *p == 'X') {
+            kbm->map[i] = -1;
+            continue;
+        }
+
+        char *end;
+        kbm->map[i] = strtol(p, &end, 10);
+        if (end == p || kbm->map[i] < 0) {
+            err = MS_ERROR_INVALID_FORMAT;
+        }
+    }
+
+    fclose(fp);
+    return err;
+}
+
+/* Floor division and modulo for negative key offsets */
+static long floor_div(long a, long b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+/**
+ * @brief Scale degree a key plays, or false if it is unmapped
+ */
+static bool keyboard_degree(const keyboard_map_t *kbm, long note, long *degree) {
+    if (note < kbm->first_note || note > kbm->last_note) return false;
+
+    const long offset = note - kbm->middle_note;
+    if (kbm->size == 0) {
+        *degree = offset;
+        return true;
+    }
+
+    const long octave = floor_div(offset, kbm->size);
+    const long entry = kbm->map[offset - octave * kbm->size];
+    if (entry < 0) return false;
+
+    *degree = entry + octave * kbm->octave_degree;
+    return true;
+}
+
+static double scale_ratio(const double *ratios, size_t num_degrees, long degree) {
+    const long period_count = floor_div(degree, (long)num_degrees);
+    const long index = degree - period_count * (long)num_degrees;
+    return ratios[index] * pow(ratios[num_degrees], (double)period_count);
+}
+
+/* ============================================================================
+ * Control API
+ * ========================================================================== */
+
+void ms_tuning_equal(ms_tuning_t *tuning, double a4_hz) {
+    if (!tuning) return;
+
+    if (a4_hz <= 0.0) {
+        a4_hz = 440.0;
+    }
+    for (int note = 0; note < MS_TUNING_NOTES; note++) {
+        tuning->frequency[note] = a4_hz * exp2((note - 69) / 12.0);
+    }
+}
+
+ms_error_t ms_tuning_load_scala(ms_tuning_t *tuning, const char *scl_path, const char *kbm_path) {
+    if (!tuning || !scl_path) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    double ratios[SCALA_MAX_DEGREES + 1];
+    size_t num_degrees;
+    ms_error_t err = scala_load_scale(scl_path, ratios, &num_degrees);
+    if (err != MS_SUCCESS) {
+        return err;
+    }
+
+    /* Scala's default mapping: linear from middle C, A4 = 440 Hz */
+    keyboard_map_t kbm = {
+        .size = 0,
+        .first_note = 0,
+        .last_note = 127,
+        .middle_note = 60,
+        .reference_note = 69,
+        .reference_frequency = 440.0,
+        .octave_degree = (long)num_degrees
+    };
+    if (kbm_path) {
+        err = scala_load_mapping(kbm_path, &kbm);
+        if (err != MS_SUCCESS) {
+            return err;
+        }
+        if (kbm.octave_degree == 0) {
+            kbm.octave_degree = (long)num_degrees;
+        }
+    }
+
+    /* The reference key must sound, even if it lies outside first..last */
+    keyboard_map_t reference_kbm = kbm;
+    reference_kbm.first_note = 0;
+    reference_kbm.last_note = 127;
+    long reference_degree;
+    if (!keyboard_degree(&reference_kbm, kbm.reference_note, &reference_degree)) {
+        return MS_ERROR_INVALID_FORMAT;
+    }
+    const double base = kbm.reference_frequency /
+                        scale_ratio(ratios, num_degrees, reference_degree);
+
+    for (long note = 0; note < MS_TUNING_NOTES; note++) {
+        long degree;
+        tuning->frequency[note] = keyboard_degree(&kbm, note, &degree) ?
+                                  base * scale_ratio(ratios, num_degrees, degree) : 0.0;
+    }
+
+    return MS_SUCCESS;
+}
+
+ms_error_t ms_instrument_set_tuning(ms_instrument_t *instrument, const ms_tuning_t *tuning,
+                                    double master_tune_cents) {
+    if (!instrument) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    const unsigned current = atomic_load_explicit(&instrument->tuning_index, memory_order_relaxed);
+    ms_tuning_t *next = &instrument->tuning[current ^ 1];
+
+    if (tuning) {
+        *next = *tuning;
+    } else {
+        ms_tuning_equal(next, 440.0);
+    }
+
+    const double master = exp2(master_tune_cents / 1200.0);
+    for (int note = 0; note < MS_TUNING_NOTES; note++) {
+        next->frequency[note] *= master;
+    }
+
+    /* Publish, then wait until no note-on still reads the old table */
+    atomic_store(&instrument->tuning_index, current ^ 1);
+    while (atomic_load(&instrument->tuning_busy)) {
+        sched_yield();
+    }
+
+    return MS_SUCCESS;
+}
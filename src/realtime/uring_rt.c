@@ -0,0 +1,241 @@
+/**
+ * @file uring_rt.c
+ * @brief Minimal io_uring wrapper for the disk streamer
+ *
+ * Talks to the kernel through the raw syscalls so the library does not
+ * depend on liburing. Only what the streamer needs is implemented: fixed
+ * (registered) buffer reads, batched submission and completion reaping.
+ * Every function fails cleanly when io_uring is unavailable, so callers
+ * can fall back to pread().
+ */
+
+#include "internal/internal_rt.h"
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define MS_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef MS_HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+ms_error_t rt_uring_init(rt_uring_t *ring, unsigned entries) {
+    if (!ring || entries == 0) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0) {
+        return MS_ERROR_NOT_INITIALIZED;  /* ENOSYS, EPERM under seccomp, ... */
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(fd);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+            close(fd);
+            return MS_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring != ring->sq_ring) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(fd);
+        return MS_ERROR_OUT_OF_MEMORY;
+    }
+
+    uint8_t *sq = (uint8_t*)ring->sq_ring;
+    uint8_t *cq = (uint8_t*)ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = cq + params.cq_off.cqes;
+    ring->entries = params.sq_entries;
+    ring->fd = fd;
+
+    return MS_SUCCESS;
+}
+
+ms_error_t rt_uring_register_buffers(rt_uring_t *ring, const struct iovec *iov, unsigned count) {
+    if (!ring || ring->fd < 0 || !iov || count == 0) {
+        return MS_ERROR_INVALID_PARAM;
+    }
+
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov, count) < 0) {
+        return MS_ERROR_UNKNOWN;  /* Typically RLIMIT_MEMLOCK */
+    }
+
+    ring->buffers_registered = true;
+    return MS_SUCCESS;
+}
+
+bool rt_uring_queue_read(rt_uring_t *ring, int fd, void *buf, size_t length, off_t offset,
+                         int buf_index, uint64_t user_data) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail + ring->pending;
+
+    if (tail - head >= ring->entries) {
+        return false;  /* Submission queue full */
+    }
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe*)ring->sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->fd = fd;
+    sqe->off = (uint64_t)offset;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)length;
+    sqe->user_data = user_data;
+
+    if (ring->buffers_registered && buf_index >= 0) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = (uint16_t)buf_index;
+    } else {
+        sqe->opcode = IORING_OP_READ;
+    }
+
+    ring->sq_array[index] = index;
+    ring->pending++;
+    return true;
+}
+
+int rt_uring_submit_and_wait(rt_uring_t *ring, unsigned wait_nr) {
+    unsigned to_submit = ring->pending;
+
+    /* Publish queued SQEs to the kernel */
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + to_submit, __ATOMIC_RELEASE);
+    ring->pending = 0;
+
+    int ret;
+    do {
+        ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr,
+                                 wait_nr ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret;
+}
+
+bool rt_uring_pop_completion(rt_uring_t *ring, uint64_t *user_data, int32_t *result) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return false;
+    }
+
+    const struct io_uring_cqe *cqe = (const struct io_uring_cqe*)ring->cqes +
+                                     (head & *ring->cq_mask);
+    *user_data = cqe->user_data;
+    *result = cqe->res;
+
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void rt_uring_destroy(rt_uring_t *ring) {
+    if (!ring || ring->fd < 0) return;
+
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+#else /* !MS_HAVE_IO_URING */
+
+ms_error_t rt_uring_init(rt_uring_t *ring, unsigned entries) {
+    (void)entries;
+    if (ring) {
+        memset(ring, 0, sizeof(*ring));
+        ring->fd = -1;
+    }
+    return MS_ERROR_NOT_INITIALIZED;
+}
+
+ms_error_t rt_uring_register_buffers(rt_uring_t *ring, const struct iovec *iov, unsigned count) {
+    (void)ring; (void)iov; (void)count;
+    return MS_ERROR_NOT_INITIALIZED;
+}
+
+bool rt_uring_queue_read(rt_uring_t *ring, int fd, void *buf, size_t length, off_t offset,
+                         int buf_index, uint64_t user_data) {
+    (void)ring; (void)fd; (void)buf; (void)length; (void)offset;
+    (void)buf_index; (void)user_data;
+    return false;
+}
+
+int rt_uring_submit_and_wait(rt_uring_t *ring, unsigned wait_nr) {
+    (void)ring; (void)wait_nr;
+    return -1;
+}
+
+bool rt_uring_pop_completion(rt_uring_t *ring, uint64_t *user_data, int32_t *result) {
+    (void)ring; (void)user_data; (void)result;
+    return false;
+}
+
+void rt_uring_destroy(rt_uring_t *ring) {
+    (void)ring;
+}
+
+#endif /* MS_HAVE_IO_URING */
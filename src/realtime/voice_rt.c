@@ -14,24 +14,40 @@
 #include <math.h>
 #include <string.h>
 
-/* Pre-calculated MIDI note to frequency table (avoids pow() in RT path) */
+/* 12-TET at A4 = 440 Hz: the pitch each zone's root note was recorded at */
 static const double MIDI_FREQ_TABLE[128] = {
-    8.176, 8.662, 9.177, 9.723, 10.301, 10.913, 11.562, 12.250,
-    12.978, 13.750, 14.568, 15.434, 16.352, 17.324, 18.354, 19.445,
-    20.602, 21.827, 23.125, 24.500, 25.957, 27.500, 29.135, 30.868,
-    32.703, 34.648, 36.708, 38.891, 41.203, 43.654, 46.249, 48.999,
-    51.913, 55.000, 58.270, 61.735, 65.406, 69.296, 73.416, 77.782,
-    82.407, 87.307, 92.499, 97.999, 103.826, 110.000, 116.541, 123.471,
-    130.813, 138.591, 146.832, 155.563, 164.814, 174.614, 184.997, 195.998,
-    207.652, 220.000, 233.082, 246.942, 261.626, 277.183, 293.665, 311.127,
-    329.628, 349.228, 369.994, 391.995, 415.305, 440.000, 466.164, 493.883,
-    523.251, 554.365, 587.330, 622.254, 659.255, 698.456, 739.989, 783.991,
-    830.609, 880.000, 932.328, 987.767, 1046.502, 1108.731, 1174.659, 1244.508,
-    1318.510, 1396.913, 1479.978, 1567.982, 1661.219, 1760.000, 1864.655, 1975.533,
-    2093.005, 2217.461, 2349.318, 2489.016, 2637.020, 2793.826, 2959.955, 3135.963,
-    3322.438, 3520.000, 3729.310, 3951.066, 4186.009, 4434.922, 4698.636, 4978.032,
-    5274.041, 5587.652, 5919.911, 6271.927, 6644.875, 7040.000, 7458.620, 7902.133,
-    8372.018, 8869.844, 9397.273, 9956.063, 10548.082, 11175.303, 11839.822, 12543.854
+    8.175798915643707, 8.6619572180272524, 9.1770239974189884, 9.7227182413150288,
+    10.300861153527183, 10.913382232281373, 11.562325709738575, 12.249857374429663,
+    12.978271799373287, 13.75, 14.567617547440307, 15.433853164253883,
+    16.351597831287414, 17.323914436054505, 18.354047994837977, 19.445436482630058,
+    20.601722307054366, 21.826764464562746, 23.12465141947715, 24.499714748859326,
+    25.956543598746574, 27.5, 29.13523509488062, 30.867706328507751,
+    32.703195662574828, 34.64782887210901, 36.70809598967594, 38.890872965260115,
+    41.203444614108747, 43.653528929125486, 46.2493028389543, 48.999429497718666,
+    51.913087197493141, 55.0, 58.270470189761241, 61.735412657015502,
+    65.406391325149656, 69.295657744218019, 73.416191979351879, 77.781745930520231,
+    82.406889228217494, 87.307057858250971, 92.4986056779086, 97.998858995437331,
+    103.82617439498628, 110.0, 116.54094037952248, 123.47082531403103,
+    130.81278265029931, 138.59131548843604, 146.83238395870379, 155.56349186104046,
+    164.81377845643496, 174.61411571650194, 184.9972113558172, 195.99771799087463,
+    207.65234878997256, 220.0, 233.08188075904496, 246.94165062806206,
+    261.62556530059862, 277.18263097687208, 293.66476791740757, 311.12698372208092,
+    329.62755691286992, 349.22823143300388, 369.9944227116344, 391.99543598174927,
+    415.30469757994513, 440.0, 466.16376151808993, 493.88330125612413,
+    523.25113060119725, 554.36526195374415, 587.32953583481515, 622.25396744416184,
+    659.25511382573984, 698.45646286600777, 739.9888454232688, 783.99087196349853,
+    830.60939515989025, 880.0, 932.32752303617985, 987.76660251224826,
+    1046.5022612023945, 1108.7305239074883, 1174.6590716696303, 1244.5079348883237,
+    1318.5102276514797, 1396.9129257320155, 1479.9776908465376, 1567.9817439269971,
+    1661.2187903197805, 1760.0, 1864.6550460723597, 1975.5332050244961,
+    2093.004522404789, 2217.4610478149766, 2349.3181433392601, 2489.0158697766474,
+    2637.0204553029598, 2793.8258514640311, 2959.9553816930752, 3135.9634878539946,
+    3322.437580639561, 3520.0, 3729.3100921447194, 3951.0664100489921,
+    4186.009044809578, 4434.9220956299532, 4698.6362866785203, 4978.0317395532948,
+    5274.0409106059196, 5587.6517029280622, 5919.9107633861504, 6271.9269757079892,
+    6644.875161279122, 7040.0, 7458.620184289437, 7902.1328200979879,
+    8372.0180896191559, 8869.8441912599064, 9397.2725733570442, 9956.0634791065895,
+    10548.081821211836, 11175.303405856126, 11839.821526772301, 12543.853951415975
 };
 
 static FORCE_INLINE double midi_note_to_frequency(uint8_t note) {
@@ -44,12 +60,24 @@ void voice_init(voice_t *voice, uint32_t voice_id, float sample_rate) {
     memset(voice, 0, sizeof(*voice));
     voice->voice_id = voice_id;
     voice->pitch_bend_multiplier = 1.0f;
+    voice->pitch_multiplier = 1.0f;
+    voice->gain = 1.0f;
+    voice->gain_left = 1.0f;
+    voice->gain_right = 1.0f;
+    voice->expression.pitch_multiplier = 1.0f;
+    voice->expression.lowpass_coeff = 1.0f;
+    voice->speed_step = 1.0;
 }
 
 void voice_trigger(voice_t *voice, ms_sample_data_t *sample, uint8_t note, 
-                   uint8_t velocity, const ms_envelope_t *envelope) {
+                   uint8_t velocity, const ms_envelope_t *envelope, double frequency,
+                   float bend) {
     if (UNLIKELY(!voice || !sample || !envelope)) return;
     
+    if (UNLIKELY(voice->cached)) {
+        voice_uncache(voice);
+    }
+    
     voice->active = true;
     voice->note = note;
     voice->velocity = velocity;
@@ -59,10 +87,29 @@ void voice_trigger(voice_t *voice, ms_sample_data_t *sample, uint8_t note,
     /* Pre-calculate velocity gain (avoid division in RT path) */
     voice->velocity_gain = velocity * (1.0f / 127.0f);
     
-    /* Calculate playback speed using lookup table */
-    double target_freq = midi_note_to_frequency(note);
+    /* Per-voice modulation starts neutral */
+    voice->pitch_multiplier = 1.0f;
+    voice->gain = 1.0f;
+    voice->pan = 0.0f;
+    voice->gain_left = 1.0f;
+    voice->gain_right = 1.0f;
+    voice->coarse = false;
+    voice->channel = 0;
+    voice->expressive = false;
+    voice->expression = (voice_expression_t){
+        .timbre_target = 1.0f,
+        .timbre = 1.0f,
+        .pitch_multiplier = 1.0f,
+        .lowpass_coeff = 1.0f
+    };
+    voice->speed_step = 1.0;
+    voice->glide_offset = 0.0f;
+    voice->gliding = false;
+    
+    /* Tuned note frequency against the zone's recorded pitch */
     double sample_freq = midi_note_to_frequency(sample->meta.root_note);
-    voice->playback_speed = (target_freq / sample_freq) * voice->pitch_bend_multiplier;
+    voice->pitch_bend_multiplier = bend;
+    voice->playback_speed = (frequency / sample_freq) * bend;
     
     /* Initialize envelope with pre-calculated coefficients */
     envelope_init(&voice->envelope, 44100.0f, envelope);
@@ -74,83 +121,334 @@ void voice_release(voice_t *voice) {
     envelope_release(&voice->envelope);
 }
 
+void voice_set_pitch(voice_t *voice, float semitones) {
+    if (UNLIKELY(voice->cached)) {
+        voice_uncache(voice);
+    }
+    
+    const float multiplier = powf(2.0f, semitones / 12.0f);
+    voice->playback_speed = voice->playback_speed / voice->pitch_multiplier * multiplier;
+    voice->pitch_multiplier = multiplier;
+}
+
 /**
- * @brief RT-safe voice processing with optimizations
- * 
- * Optimizations:
- * - Loop unrolling friendly structure
- * - Prefetching for sample data
- * - Minimal branching in hot loop
- * - SIMD-friendly memory access patterns
+ * @brief Follow the instrument's pitch bend (multiplier, not semitones)
  */
-void voice_process(voice_t *voice, float *output, size_t num_frames, uint16_t channels) {
-    if (UNLIKELY(!voice || !voice->active || !voice->sample || !output)) return;
+void voice_set_bend(voice_t *voice, float multiplier) {
+    if (UNLIKELY(voice->cached)) {
+        voice_uncache(voice);
+    }
+    
+    voice->playback_speed = voice->playback_speed / voice->pitch_bend_multiplier * multiplier;
+    voice->pitch_bend_multiplier = multiplier;
+}
+
+/**
+ * @brief Set gain and balance; centre leaves both channels at full gain
+ */
+void voice_set_gain_pan(voice_t *voice, float gain, float pan) {
+    if (pan < -1.0f) pan = -1.0f;
+    if (pan > 1.0f) pan = 1.0f;
+    
+    voice->gain = gain;
+    voice->pan = pan;
+    voice->gain_left = gain * (pan > 0.0f ? 1.0f - pan : 1.0f);
+    voice->gain_right = gain * (pan < 0.0f ? 1.0f + pan : 1.0f);
+}
+
+/* ============================================================================
+ * Per-Note Expression (MPE)
+ * ========================================================================== */
+
+#define EXPRESSION_EPSILON 1e-4f
+
+/**
+ * @brief Fold the current expression into playback speed and filter
+ */
+static void voice_expression_apply(voice_t *voice) {
+    voice_expression_t *expr = &voice->expression;
+    
+    if (UNLIKELY(voice->cached)) {
+        voice_uncache(voice);
+    }
+    
+    const float multiplier = exp2f(expr->pitch * (1.0f / 12.0f));
+    voice->playback_speed = voice->playback_speed / expr->pitch_multiplier * multiplier;
+    expr->pitch_multiplier = multiplier;
+    
+    /* Timbre 1 leaves the filter open, 0 closes it to a few hundred Hz */
+    expr->lowpass_coeff = expr->timbre >= 1.0f ? 1.0f : exp2f((expr->timbre - 1.0f) * 4.0f);
+}
+
+/**
+ * @brief Jump to the channel's expression at note-on, without smoothing
+ */
+void voice_expression_start(voice_t *voice, float pitch, float pressure, float timbre) {
+    voice_expression_t *expr = &voice->expression;
+    
+    expr->pitch = expr->pitch_target = pitch;
+    expr->pressure = expr->pressure_target = pressure;
+    expr->timbre = expr->timbre_target = timbre;
+    voice_expression_apply(voice);
+}
+
+/**
+ * @brief Move expression one block towards its targets
+ *
+ * @param alpha Fraction of the remaining distance covered per block
+ * @return false once all values have settled
+ */
+bool voice_expression_update(voice_t *voice, float alpha) {
+    voice_expression_t *expr = &voice->expression;
+    const float d_pitch = expr->pitch_target - expr->pitch;
+    const float d_pressure = expr->pressure_target - expr->pressure;
+    const float d_timbre = expr->timbre_target - expr->timbre;
+    
+    const bool settled = fabsf(d_pitch) < EXPRESSION_EPSILON &&
+                         fabsf(d_pressure) < EXPRESSION_EPSILON &&
+                         fabsf(d_timbre) < EXPRESSION_EPSILON;
+    if (settled) {
+        expr->pitch = expr->pitch_target;
+        expr->pressure = expr->pressure_target;
+        expr->timbre = expr->timbre_target;
+    } else {
+        expr->pitch += d_pitch * alpha;
+        expr->pressure += d_pressure * alpha;
+        expr->timbre += d_timbre * alpha;
+    }
     
+    voice_expression_apply(voice);
+    return !settled;
+}
+
+/* ============================================================================
+ * Portamento
+ * ========================================================================== */
+
+#define GLIDE_EPSILON 1e-3f  /* Semitones */
+
+/*
+ * A glide is the distance in semitones between the pitch sounding now and
+ * the voice's note, shrinking exponentially with time constant
+ * glide_frames. Once per block the next offset is computed and turned into
+ * a constant per-frame ratio, so the render loop only multiplies
+ * playback_speed by speed_step.
+ */
+
+/**
+ * @brief Start a freshly triggered voice offset semitones away from its note
+ */
+void voice_glide_from(voice_t *voice, float offset, float glide_frames) {
+    if (glide_frames <= 0.0f || fabsf(offset) < GLIDE_EPSILON) return;
+    
+    if (UNLIKELY(voice->cached)) {
+        voice_uncache(voice);
+    }
+    voice->playback_speed *= exp2((double)offset / 12.0);
+    voice->glide_offset = offset;
+    voice->glide_frames = glide_frames;
+    voice->gliding = true;
+}
+
+/**
+ * @brief Move a sounding voice's note by interval semitones
+ *
+ * The pitch heard does not jump; it glides to the new note, or jumps at
+ * once if glide_frames is 0.
+ */
+void voice_retarget(voice_t *voice, float interval, float glide_frames) {
+    if (UNLIKELY(voice->cached)) {
+        voice_uncache(voice);
+    }
+    
+    voice->glide_offset -= interval;
+    
+    if (glide_frames <= 0.0f) {
+        voice->playback_speed *= exp2(-(double)voice->glide_offset / 12.0);
+        voice->glide_offset = 0.0f;
+        voice->gliding = false;
+        return;
+    }
+    
+    voice->glide_frames = glide_frames;
+    voice->gliding = fabsf(voice->glide_offset) >= GLIDE_EPSILON;
+    if (!voice->gliding) {
+        voice->playback_speed *= exp2(-(double)voice->glide_offset / 12.0);
+        voice->glide_offset = 0.0f;
+    }
+}
+
+/**
+ * @brief Set up this block's per-frame speed ramp
+ */
+void voice_glide_update(voice_t *voice, size_t num_frames) {
+    if (UNLIKELY(num_frames == 0)) return;
+    
+    const float offset = voice->glide_offset;
+    float next = offset * expf(-(float)num_frames / voice->glide_frames);
+    
+    if (fabsf(next) < GLIDE_EPSILON) {
+        next = 0.0f;
+        voice->gliding = false;
+    }
+    
+    voice->speed_step = exp2((double)(next - offset) / (12.0 * (double)num_frames));
+    voice->glide_offset = next;
+}
+
+/* ============================================================================
+ * Pre-Rendered Notes
+ * ========================================================================== */
+
+/**
+ * @brief Switch a voice from its pre-rendered note back to live resampling
+ */
+void voice_uncache(voice_t *voice) {
+    const note_cache_entry_t *entry = voice->cached;
+    
+    /* Rendered frame n is source position n * speed */
+    voice->playback_position *= entry->speed;
+    voice->cached = NULL;
+    atomic_fetch_sub_explicit(&entry->cache->voices, 1, memory_order_release);
+}
+
+/**
+ * @brief Voice processing for notes played from the note cache
+ *
+ * The note is already resampled, so each frame is a load, the envelope and
+ * the gains.
+ */
+static void voice_process_cached(voice_t *voice, float *output, size_t num_frames,
+                                 uint16_t channels) {
+    const note_cache_entry_t *entry = voice->cached;
+    const size_t position = (size_t)voice->playback_position;
+    const float *data = entry->data + position;
+    const size_t remaining = position < entry->num_frames ? entry->num_frames - position : 0;
+    const size_t frames = num_frames < remaining ? num_frames : remaining;
+    const float velocity_gain = voice->velocity_gain * (1.0f + voice->expression.pressure);
+    const float gain = voice->gain;
+    const float gain_left = voice->gain_left;
+    const float gain_right = voice->gain_right;
+    const bool is_stereo_out = (channels == 2);
+    
+    size_t i = 0;
+    for (; i < frames; i++) {
+        const float final_value = data[i] * envelope_process(&voice->envelope) * velocity_gain;
+        
+        if (is_stereo_out) {
+            output[i * 2] += final_value * gain_left;
+            output[i * 2 + 1] += final_value * gain_right;
+        } else {
+            output[i] += final_value * gain;
+        }
+        
+        if (UNLIKELY(!envelope_is_active(&voice->envelope))) {
+            voice->active = false;
+            i++;
+            break;
+        }
+    }
+    
+    if (i == remaining) {
+        voice->active = false;
+    }
+    voice->playback_position = (double)(position + i);
+}
+
+/**
+ * @brief Fetch the first channel of a frame of a streamed zone
+ *
+ * Frames below the preload come from RAM, later frames from the voice's
+ * streaming ring if the streamer has already delivered them.
+ */
+static FORCE_INLINE bool stream_fetch(const ms_sample_data_t *sample, const stream_voice_t *stream,
+                                      size_t fill, size_t index, float *value) {
+    if (LIKELY(index < sample->preload_frames)) {
+        *value = sample->data[index * sample->channels];
+        return true;
+    }
+    
+    const size_t tail_index = index - sample->preload_frames;
+    if (UNLIKELY(tail_index >= fill)) {
+        return false;
+    }
+    
+    *value = stream->ring[(tail_index & stream->ring_mask) * sample->channels];
+    return true;
+}
+
+/**
+ * @brief Voice processing for disk-streamed zones
+ *
+ * Same signal path as voice_process(), but frames are fetched through the
+ * preload/ring split. Frames the streamer has not delivered yet render as
+ * silence; the first such frame marks the voice as an underrun.
+ */
+static void voice_process_streamed(voice_t *voice, float *output, size_t num_frames,
+                                   uint16_t channels) {
     ms_sample_data_t *sample = voice->sample;
+    stream_voice_t *stream = voice->stream;
     double position = voice->playback_position;
-    const double speed = voice->playback_speed;
-    const float velocity_gain = voice->velocity_gain;
-    const bool is_mono = (sample->channels == 1);
+    double speed = voice->playback_speed;
+    const double speed_step = voice->speed_step;
+    const float velocity_gain = voice->velocity_gain * (1.0f + voice->expression.pressure);
+    const float gain = voice->gain;
+    const float gain_left = voice->gain_left;
+    const float gain_right = voice->gain_right;
+    const bool coarse = voice->coarse;
+    const float lowpass_coeff = voice->expression.lowpass_coeff;
+    const bool filtered = lowpass_coeff < 1.0f;
+    float lowpass = voice->expression.lowpass_state;
     const bool is_stereo_out = (channels == 2);
+    const size_t max_frames = sample->num_frames;
     
-    /* Prefetch first sample data */
-    PREFETCH_READ(sample->data);
+    /* The ring is only valid once the streamer acknowledged our request */
+    size_t fill = 0;
+    if (LIKELY(atomic_load_explicit(&stream->serviced_gen, memory_order_acquire) == stream->gen)) {
+        fill = atomic_load_explicit(&stream->fill_frames, memory_order_acquire);
+    }
     
-    /* Loop parameters */
-    const bool loop_enabled = sample->meta.loop_enabled;
-    const uint32_t loop_start = sample->meta.loop_start;
-    const uint32_t loop_end = sample->meta.loop_end;
-    const size_t max_frames = sample->num_frames;
+    uint64_t missing = 0;
     
     for (size_t i = 0; i < num_frames; i++) {
-        /* Check bounds */
         if (UNLIKELY(position >= max_frames)) {
-            if (loop_enabled && loop_end > loop_start) {
-                position = loop_start;
-            } else {
-                voice->active = false;
-                break;
-            }
+            voice->active = false;
+            break;
         }
         
-        /* Get interpolation parameters */
         const size_t index = (size_t)position;
         const float frac = (float)(position - index);
         
-        /* Prefetch next cache line */
-        if (LIKELY((i & 15) == 0)) {
-            PREFETCH_READ(&sample->data[index + 64]);
-        }
-        
-        /* Linear interpolation */
-        float sample_value;
-        if (is_mono) {
-            const float s0 = sample->data[index];
-            const float s1 = (index + 1 < max_frames) ? sample->data[index + 1] : s0;
+        float s0, s1;
+        float sample_value = 0.0f;
+        if (LIKELY(stream_fetch(sample, stream, fill, index, &s0))) {
+            if (coarse || index + 1 >= max_frames ||
+                !stream_fetch(sample, stream, fill, index + 1, &s1)) {
+                s1 = s0;
+            }
             sample_value = s0 + frac * (s1 - s0);
         } else {
-            /* Stereo sample - use left channel */
-            const float s0 = sample->data[index * 2];
-            const float s1 = (index + 1 < max_frames) ? sample->data[(index + 1) * 2] : s0;
-            sample_value = s0 + frac * (s1 - s0);
+            missing++;
+        }
+        
+        if (UNLIKELY(filtered)) {
+            lowpass += lowpass_coeff * (sample_value - lowpass);
+            sample_value = lowpass;
         }
         
-        /* Apply envelope (inlined for performance) */
         const float env_level = envelope_process(&voice->envelope);
         const float final_value = sample_value * env_level * velocity_gain;
         
-        /* Mix into output */
         if (is_stereo_out) {
-            output[i * 2] += final_value;
-            output[i * 2 + 1] += final_value;
+            output[i * 2] += final_value * gain_left;
+            output[i * 2 + 1] += final_value * gain_right;
         } else {
-            output[i] += final_value;
+            output[i] += final_value * gain;
         }
         
-        /* Advance position */
         position += speed;
+        speed *= speed_step;
         
-        /* Check if envelope finished (less common, put at end) */
         if (UNLIKELY(!envelope_is_active(&voice->envelope))) {
             voice->active = false;
             break;
@@ -158,6 +456,152 @@ void voice_process(voice_t *voice, float *output, size_t num_frames, uint16_t ch
     }
     
     voice->playback_position = position;
+    voice->playback_speed = speed;
+    voice->expression.lowpass_state = lowpass;
+    
+    /* Let the streamer reuse ring space behind the playhead */
+    const size_t index = (size_t)position;
+    if (index > sample->preload_frames) {
+        atomic_store_explicit(&stream->read_frames, index - sample->preload_frames,
+                              memory_order_release);
+    }
+    
+    if (UNLIKELY(missing)) {
+        if (!stream->underrun) {
+            stream->underrun = true;
+            atomic_fetch_add_explicit(&stream->underruns, 1, memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&stream->underrun_frames, missing, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief RT-safe voice processing with optimizations
+ * 
+ * Optimizations:
+ * - Loop unrolling friendly structure
+ * - Prefetching for sample data
+ * - Minimal branching in hot loop
+ * - SIMD-friendly memory access patterns
+ */
+void voice_process(voice_t *voice, float *output, size_t num_frames, uint16_t channels) {
+    if (UNLIKELY(!voice || !voice->active || !voice->sample || !output)) return;
+    
+    if (UNLIKELY(voice->sample->streamed)) {
+        voice_process_streamed(voice, output, num_frames, channels);
+        return;
+    }
+    
+    if (voice->cached) {
+        voice_process_cached(voice, output, num_frames, channels);
+        return;
+    }
+    
+    ms_sample_data_t *sample = voice->sample;
+    double position = voice->playback_position;
+    double speed = voice->playback_speed;
+    const double speed_step = voice->speed_step;
+    const float velocity_gain = voice->velocity_gain * (1.0f + voice->expression.pressure);
+    const float gain = voice->gain;
+    const float gain_left = voice->gain_left;
+    const float gain_right = voice->gain_right;
+    const bool coarse = voice->coarse;
+    const float lowpass_coeff = voice->expression.lowpass_coeff;
+    const bool filtered = lowpass_coeff < 1.0f;
+    float lowpass = voice->expression.lowpass_state;
+    const size_t stride = sample->channels;    /* First channel of interleaved frames */
+    
+    /* Evicted zone (memory budget): play the resident head until the body is back */
+    const bool on_head = UNLIKELY(voice->zone_hold == ZONE_HOLD_HEAD);
+    const ms_sample_data_t *source = on_head ? &sample->residency->head : sample;
+    const float *data = source->data;
+    const bool is_stereo_out = (channels == 2);
+    
+    /* Prefetch first sample data */
+    PREFETCH_READ(data);
+    
+    /*
+     * The buffer has guard frames past the end (a copy of the loop start
+     * for looped zones), so every tap is readable and the only bounds work
+     * is once per segment: render as many frames as stay inside the zone,
+     * then wrap or stop.
+     */
+    const size_t end = source->num_frames;
+    const bool looping = !on_head && sample->meta.loop_enabled &&
+                         sample->meta.loop_end > sample->meta.loop_start;
+    const double loop_start = sample->meta.loop_start;
+    const double loop_length = (double)end - loop_start;
+    
+    size_t i = 0;
+    while (i < num_frames) {
+        if (UNLIKELY(position >= end)) {
+            if (!looping) {
+                voice->active = false;
+                break;
+            }
+            do {
+                position -= loop_length;
+            } while (position >= end);
+        }
+        
+        /* Frames before the playhead crosses the end, at the fastest speed of the block */
+        const size_t remaining = num_frames - i;
+        const double max_speed = speed_step > 1.0 ? speed * pow(speed_step, (double)remaining) : speed;
+        size_t run = (size_t)ceil(((double)end - position) / max_speed);
+        if (run > remaining) run = remaining;
+        const size_t segment_end = i + run;
+        
+        for (; i < segment_end; i++) {
+            /* Get interpolation parameters */
+            const size_t index = (size_t)position;
+            const float frac = (float)(position - index);
+            
+            /* Prefetch next cache line */
+            if (LIKELY((i & 15) == 0)) {
+                PREFETCH_READ(&data[(index + 64) * stride]);
+            }
+            
+            /* Linear interpolation (nearest sample for governed quiet voices) */
+            const float s0 = data[index * stride];
+            float sample_value = s0;
+            if (LIKELY(!coarse)) {
+                sample_value += frac * (data[(index + 1) * stride] - s0);
+            }
+            
+            /* Per-note timbre */
+            if (UNLIKELY(filtered)) {
+                lowpass += lowpass_coeff * (sample_value - lowpass);
+                sample_value = lowpass;
+            }
+            
+            /* Apply envelope (inlined for performance) */
+            const float env_level = envelope_process(&voice->envelope);
+            const float final_value = sample_value * env_level * velocity_gain;
+            
+            /* Mix into output */
+            if (is_stereo_out) {
+                output[i * 2] += final_value * gain_left;
+                output[i * 2 + 1] += final_value * gain_right;
+            } else {
+                output[i] += final_value * gain;
+            }
+            
+            /* Advance position */
+            position += speed;
+            speed *= speed_step;
+            
+            /* Check if envelope finished (less common, put at end) */
+            if (UNLIKELY(!envelope_is_active(&voice->envelope))) {
+                voice->active = false;
+                i = num_frames;
+                break;
+            }
+        }
+    }
+    
+    voice->playback_position = position;
+    voice->playback_speed = speed;
+    voice->expression.lowpass_state = lowpass;
 }
 
 bool voice_is_active(const voice_t *voice) {
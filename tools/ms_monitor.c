@@ -0,0 +1,146 @@
+/**
+ * @file ms_monitor.c
+ * @brief Watch the live statistics of a running sampler from outside
+ *
+ * Attaches to the shared memory object a sampler publishes with
+ * ms_sampler_publish_stats() and prints one line per interval: DSP load
+ * over the interval and its peak, xruns, voices, event queue depth,
+ * steals, stream underruns and sample memory. Reading never disturbs the
+ * audio thread, so short intervals are fine. On exit (count reached or
+ * Ctrl-C) it prints the load histogram.
+ *
+ * Usage: ms_monitor [-i interval_ms] [-n count] [-H] name
+ *   -H  print the histogram after every line instead of only at exit
+ */
+
+#define _GNU_SOURCE
+#include "midi_sampler.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void print_histogram(const ms_monitor_snapshot_t *snap) {
+    uint64_t total = 0;
+    for (int i = 0; i < MS_MONITOR_LOAD_BINS; i++) {
+        total += snap->load_histogram[i];
+    }
+    if (total == 0) return;
+
+    printf("DSP load histogram (%llu blocks):\n", (unsigned long long)total);
+    for (int i = 0; i < MS_MONITOR_LOAD_BINS; i++) {
+        const uint64_t n = snap->load_histogram[i];
+        if (n == 0) continue;
+
+        char label[16];
+        if (i == MS_MONITOR_LOAD_BINS - 1) {
+            snprintf(label, sizeof(label), "%4d%%+", i * 10);
+        } else {
+            snprintf(label, sizeof(label), "%3d-%3d%%", i * 10, i * 10 + 10);
+        }
+        const int bar = (int)(n * 50 / total);
+        printf("  %-9s %12llu %6.2f%% %.*s\n", label, (unsigned long long)n,
+               100.0 * n / total, bar, "##################################################");
+    }
+}
+
+/* Mean load between two snapshots */
+static double interval_load(const ms_monitor_snapshot_t *prev, const ms_monitor_snapshot_t *cur) {
+    const uint64_t period = cur->period_ns - prev->period_ns;
+    return period ? 100.0 * (cur->busy_ns - prev->busy_ns) / period : 0.0;
+}
+
+int main(int argc, char **argv) {
+    unsigned interval_ms = 1000;
+    long count = -1;
+    int histogram_every_line = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:n:H")) != -1) {
+        switch (opt) {
+            case 'i': interval_ms = (unsigned)atoi(optarg); break;
+            case 'n': count = atol(optarg); break;
+            case 'H': histogram_every_line = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-i interval_ms] [-n count] [-H] name\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || interval_ms == 0) {
+        fprintf(stderr, "Usage: %s [-i interval_ms] [-n count] [-H] name\n", argv[0]);
+        return 1;
+    }
+
+    const char *name = argv[optind];
+    ms_monitor_t *monitor;
+    ms_error_t err = ms_monitor_open(name, &monitor);
+    if (err != MS_SUCCESS) {
+        fprintf(stderr, "%s: cannot attach to %s (error %d)\n", argv[0], name, err);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    ms_monitor_snapshot_t prev, cur;
+    if (ms_monitor_read(monitor, &prev) != MS_SUCCESS) {
+        fprintf(stderr, "%s: %s is stale (publisher stopped mid-update)\n", argv[0], name);
+        ms_monitor_close(monitor);
+        return 1;
+    }
+    printf("Attached to %s (pid %d, %u Hz, %u voices)\n", name, prev.pid, prev.sample_rate,
+           prev.max_polyphony);
+    printf("%8s %7s %7s %6s %9s %7s %7s %9s %10s\n", "blocks", "load%", "peak%", "xruns",
+           "voices", "queue", "steals", "underrun", "memory MB");
+
+    const struct timespec period = {
+        .tv_sec = interval_ms / 1000,
+        .tv_nsec = (long)(interval_ms % 1000) * 1000000L
+    };
+
+    while (!stop && count != 0) {
+        nanosleep(&period, NULL);
+        if (ms_monitor_read(monitor, &cur) != MS_SUCCESS) {
+            printf("%8s (stale segment: publisher stopped mid-update)\n", "-");
+            fflush(stdout);
+            if (count > 0) count--;
+            continue;
+        }
+
+        if (cur.updates == prev.updates) {
+            printf("%8s (no blocks rendered)\n", "-");
+        } else {
+            char voices[16];
+            snprintf(voices, sizeof(voices), "%u/%u", cur.active_voices, cur.max_polyphony);
+            printf("%8llu %7.1f %7.1f %6u %9s %7u %7llu %9llu %10.1f\n",
+                   (unsigned long long)(cur.updates - prev.updates),
+                   interval_load(&prev, &cur), cur.dsp_peak_load * 100.0, cur.xruns, voices,
+                   cur.event_queue_depth,
+                   (unsigned long long)(cur.voices_stolen - prev.voices_stolen),
+                   (unsigned long long)(cur.stream_underruns - prev.stream_underruns),
+                   (cur.preload_bytes + cur.resident_bytes) / (1024.0 * 1024.0));
+        }
+        if (histogram_every_line) {
+            print_histogram(&cur);
+        }
+        fflush(stdout);
+
+        prev = cur;
+        if (count > 0) count--;
+    }
+
+    if (!histogram_every_line) {
+        print_histogram(&prev);
+    }
+    ms_monitor_close(monitor);
+    return 0;
+}
@@ -0,0 +1,412 @@
+/**
+ * @file rt_check.c
+ * @brief LD_PRELOAD shim that catches non-real-time calls on the audio thread
+ *
+ * A library built with ENABLE_RT_CHECKS marks the thread inside
+ * ms_process() through the ms_rt_check_enter()/ms_rt_check_leave() hooks
+ * defined here. While a thread is marked, the allocator, pthread mutex
+ * and condition variable operations and the usual blocking or
+ * page-faulting system call wrappers report themselves on stderr with a
+ * backtrace. Calls from other threads pass straight through.
+ *
+ * Usage: LD_PRELOAD=./libms_rtcheck.so program
+ *   MS_RT_CHECK=abort   abort() at the first violation (for a debugger or core)
+ *   MS_RT_CHECK_LIMIT=n print a backtrace for the first n violations (default 20)
+ *
+ * Programs can ask for the count with ms_rt_check_violations() (declare it
+ * weak to run without the shim) and a summary is printed at exit.
+ *
+ * Only calls that cross a shared library boundary can be seen: calls
+ * glibc makes internally, and inline system calls, are not.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RT_CHECK_BACKTRACE_DEPTH 32
+#define RT_CHECK_DEFAULT_LIMIT 20
+
+/* glibc's allocator entry points; no dlsym() (which allocates) needed */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread unsigned audio_depth;   /* ms_process() nesting on this thread */
+static __thread bool reporting;         /* Inside violation(); do not recurse */
+
+static atomic_uint_fast64_t violations;
+static bool abort_on_violation;
+static uint64_t backtrace_limit = RT_CHECK_DEFAULT_LIMIT;
+
+/* ============================================================================
+ * Hooks called by the library
+ * ========================================================================== */
+
+void ms_rt_check_enter(void) {
+    audio_depth++;
+}
+
+void ms_rt_check_leave(void) {
+    audio_depth--;
+}
+
+uint64_t ms_rt_check_violations(void) {
+    return atomic_load(&violations);
+}
+
+/* ============================================================================
+ * Real functions
+ * ========================================================================== */
+
+static ssize_t (*real_write)(int, const void *, size_t);
+static int (*real_mutex_lock)(pthread_mutex_t *);
+static int (*real_mutex_trylock)(pthread_mutex_t *);
+static int (*real_mutex_unlock)(pthread_mutex_t *);
+static int (*real_cond_wait)(pthread_cond_t *, pthread_mutex_t *);
+static int (*real_cond_timedwait)(pthread_cond_t *, pthread_mutex_t *, const struct timespec *);
+static int (*real_cond_signal)(pthread_cond_t *);
+static int (*real_cond_broadcast)(pthread_cond_t *);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_pread)(int, void *, size_t, off_t);
+static ssize_t (*real_pwrite)(int, const void *, size_t, off_t);
+static int (*real_open)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static int (*real_close)(int);
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+static int (*real_munmap)(void *, size_t);
+static int (*real_mlock)(const void *, size_t);
+static int (*real_nanosleep)(const struct timespec *, struct timespec *);
+static int (*real_clock_nanosleep)(clockid_t, int, const struct timespec *, struct timespec *);
+static int (*real_usleep)(useconds_t);
+static int (*real_sched_yield)(void);
+static int (*real_poll)(struct pollfd *, nfds_t, int);
+static long (*real_syscall)(long, ...);
+
+/* POSIX-sanctioned way to store a dlsym() result in a function pointer */
+#define RESOLVE(var, name) (*(void **)(&var) = dlsym(RTLD_NEXT, name))
+
+static bool resolved;
+
+static void resolve_all(void) {
+    RESOLVE(real_write, "write");
+    RESOLVE(real_mutex_lock, "pthread_mutex_lock");
+    RESOLVE(real_mutex_trylock, "pthread_mutex_trylock");
+    RESOLVE(real_mutex_unlock, "pthread_mutex_unlock");
+    RESOLVE(real_cond_wait, "pthread_cond_wait");
+    RESOLVE(real_cond_timedwait, "pthread_cond_timedwait");
+    RESOLVE(real_cond_signal, "pthread_cond_signal");
+    RESOLVE(real_cond_broadcast, "pthread_cond_broadcast");
+    RESOLVE(real_read, "read");
+    RESOLVE(real_pread, "pread");
+    RESOLVE(real_pwrite, "pwrite");
+    RESOLVE(real_open, "open");
+    RESOLVE(real_openat, "openat");
+    RESOLVE(real_close, "close");
+    RESOLVE(real_mmap, "mmap");
+    RESOLVE(real_munmap, "munmap");
+    RESOLVE(real_mlock, "mlock");
+    RESOLVE(real_nanosleep, "nanosleep");
+    RESOLVE(real_clock_nanosleep, "clock_nanosleep");
+    RESOLVE(real_usleep, "usleep");
+    RESOLVE(real_sched_yield, "sched_yield");
+    RESOLVE(real_poll, "poll");
+    RESOLVE(real_syscall, "syscall");
+    resolved = true;
+}
+
+/* Another library's constructor may get here before ours */
+static inline void resolve(void) {
+    if (__builtin_expect(!resolved, 0)) resolve_all();
+}
+
+/* ============================================================================
+ * Reporting
+ * ========================================================================== */
+
+static void report(const char *what) {
+    resolve();
+    const uint64_t n = atomic_fetch_add(&violations, 1) + 1;
+    if (n > backtrace_limit && !abort_on_violation) return;
+
+    char line[160];
+    const int len = snprintf(line, sizeof(line), "rt_check: %s() on the audio thread (#%llu)\n",
+                             what, (unsigned long long)n);
+    real_write(STDERR_FILENO, line, (size_t)len);
+
+    void *frames[RT_CHECK_BACKTRACE_DEPTH];
+    const int depth = backtrace(frames, RT_CHECK_BACKTRACE_DEPTH);
+    backtrace_symbols_fd(frames + 1, depth - 1, STDERR_FILENO);  /* Skip report() */
+
+    if (n == backtrace_limit && !abort_on_violation) {
+        static const char more[] = "rt_check: further violations are only counted\n";
+        real_write(STDERR_FILENO, more, sizeof(more) - 1);
+    }
+    if (abort_on_violation) {
+        abort();
+    }
+}
+
+static inline void violation(const char *what) {
+    if (__builtin_expect(audio_depth == 0 || reporting, 1)) return;
+
+    reporting = true;
+    report(what);
+    reporting = false;
+}
+
+/* ============================================================================
+ * Setup
+ * ========================================================================== */
+
+__attribute__((constructor))
+static void rt_check_init(void) {
+    resolve();
+
+    const char *mode = getenv("MS_RT_CHECK");
+    abort_on_violation = mode && strcmp(mode, "abort") == 0;
+    const char *limit = getenv("MS_RT_CHECK_LIMIT");
+    if (limit) {
+        backtrace_limit = strtoull(limit, NULL, 10);
+    }
+
+    /* backtrace() loads libgcc on first use; do that here, not on the audio thread */
+    void *frame;
+    backtrace(&frame, 1);
+}
+
+__attribute__((destructor))
+static void rt_check_fini(void) {
+    resolve();
+    const uint64_t n = atomic_load(&violations);
+    char line[96];
+    const int len = snprintf(line, sizeof(line), "rt_check: %llu violation%s on the audio thread\n",
+                             (unsigned long long)n, n == 1 ? "" : "s");
+    real_write(STDERR_FILENO, line, (size_t)len);
+}
+
+/* ============================================================================
+ * Allocator
+ * ========================================================================== */
+
+void *malloc(size_t size) {
+    violation("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    violation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    violation("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    if (ptr) violation("free");
+    __libc_free(ptr);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    violation("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    violation("posix_memalign");
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+    void *p = __libc_memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+/* ============================================================================
+ * Locks
+ * ========================================================================== */
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+    violation("pthread_mutex_lock");
+    resolve();
+    return real_mutex_lock(mutex);
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *mutex) {
+    violation("pthread_mutex_trylock");
+    resolve();
+    return real_mutex_trylock(mutex);
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex) {
+    violation("pthread_mutex_unlock");
+    resolve();
+    return real_mutex_unlock(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+    violation("pthread_cond_wait");
+    resolve();
+    return real_cond_wait(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                           const struct timespec *abstime) {
+    violation("pthread_cond_timedwait");
+    resolve();
+    return real_cond_timedwait(cond, mutex, abstime);
+}
+
+int pthread_cond_signal(pthread_cond_t *cond) {
+    violation("pthread_cond_signal");
+    resolve();
+    return real_cond_signal(cond);
+}
+
+int pthread_cond_broadcast(pthread_cond_t *cond) {
+    violation("pthread_cond_broadcast");
+    resolve();
+    return real_cond_broadcast(cond);
+}
+
+/* ============================================================================
+ * System calls
+ * ========================================================================== */
+
+ssize_t read(int fd, void *buf, size_t count) {
+    violation("read");
+    resolve();
+    return real_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    violation("write");
+    resolve();
+    return real_write(fd, buf, count);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    violation("pread");
+    resolve();
+    return real_pread(fd, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    violation("pwrite");
+    resolve();
+    return real_pwrite(fd, buf, count, offset);
+}
+
+int open(const char *path, int flags, ...) {
+    violation("open");
+    resolve();
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+    return real_open(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    violation("openat");
+    resolve();
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+    return real_openat(dirfd, path, flags, mode);
+}
+
+int close(int fd) {
+    violation("close");
+    resolve();
+    return real_close(fd);
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    violation("mmap");
+    resolve();
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void *addr, size_t length) {
+    violation("munmap");
+    resolve();
+    return real_munmap(addr, length);
+}
+
+int mlock(const void *addr, size_t length) {
+    violation("mlock");
+    resolve();
+    return real_mlock(addr, length);
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem) {
+    violation("nanosleep");
+    resolve();
+    return real_nanosleep(req, rem);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec *req,
+                    struct timespec *rem) {
+    violation("clock_nanosleep");
+    resolve();
+    return real_clock_nanosleep(clock, flags, req, rem);
+}
+
+int usleep(useconds_t usec) {
+    violation("usleep");
+    resolve();
+    return real_usleep(usec);
+}
+
+int sched_yield(void) {
+    violation("sched_yield");
+    resolve();
+    return real_sched_yield();
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    violation("poll");
+    resolve();
+    return real_poll(fds, nfds, timeout);
+}
+
+long syscall(long number, ...) {
+    violation("syscall");
+    resolve();
+    va_list args;
+    va_start(args, number);
+    const long a1 = va_arg(args, long), a2 = va_arg(args, long), a3 = va_arg(args, long);
+    const long a4 = va_arg(args, long), a5 = va_arg(args, long), a6 = va_arg(args, long);
+    va_end(args);
+    return real_syscall(number, a1, a2, a3, a4, a5, a6);
+}
@@ -0,0 +1,510 @@
+/**
+ * @file rt_check_driver.c
+ * @brief Exercise the public API while rendering, for the rt_check shim
+ *
+ * An audio thread calls ms_process() at real-time pace while this thread
+ * walks through every public function: loading (files, memory, parallel,
+ * streamed, cached, shared pools), playing and voice commands, budgets,
+ * voice modes, tuning, the note cache, the governor, statistics and the
+ * live statistics segment, MIDI playback, sequences, live MIDI input and
+ * the self-hosted render thread. Run it under the shim and every
+ * allocation, lock or system call the engine makes on the audio thread
+ * is reported with a backtrace, attributed to the step that caused it:
+ *
+ *   LD_PRELOAD=./libms_rtcheck.so ./rt_check_driver
+ *
+ * Exits with status 1 if any step caused a violation. Needs a library
+ * configured with -DENABLE_RT_CHECKS=ON; the files it plays are written
+ * to a temporary directory.
+ */
+
+#define _GNU_SOURCE
+#include "midi_sampler.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SAMPLE_RATE 48000
+#define BLOCK_FRAMES 128
+#define CHANNELS 2
+
+/* Provided by the preloaded shim */
+uint64_t ms_rt_check_violations(void) __attribute__((weak));
+
+static ms_sampler_t *sampler;
+static atomic_bool audio_running;
+static atomic_uint_fast64_t blocks_rendered;
+static char temp_dir[] = "/tmp/ms_rtcheck_XXXXXX";
+static int failed_steps = 0;
+
+/* ============================================================================
+ * Audio thread
+ * ========================================================================== */
+
+static void *audio_thread_main(void *arg) {
+    (void)arg;
+    static float buffer[BLOCK_FRAMES * CHANNELS];
+    const long period_ns = (long)BLOCK_FRAMES * 1000000000L / SAMPLE_RATE;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (atomic_load(&audio_running)) {
+        ms_process(sampler, buffer, BLOCK_FRAMES);
+        atomic_fetch_add(&blocks_rendered, 1);
+
+        next.tv_nsec += period_ns;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+static pthread_t audio_thread;
+
+static void audio_start(void) {
+    atomic_store(&audio_running, true);
+    pthread_create(&audio_thread, NULL, audio_thread_main, NULL);
+}
+
+static void audio_stop(void) {
+    atomic_store(&audio_running, false);
+    pthread_join(audio_thread, NULL);
+}
+
+/* Let the audio thread render a few blocks so queued work reaches it */
+static void wait_blocks(uint64_t count) {
+    const uint64_t target = atomic_load(&blocks_rendered) + count;
+    while (atomic_load(&blocks_rendered) < target) {
+        usleep(500);
+    }
+}
+
+/* ============================================================================
+ * Steps
+ * ========================================================================== */
+
+static uint64_t violations(void) {
+    return ms_rt_check_violations ? ms_rt_check_violations() : 0;
+}
+
+static uint64_t step_start;
+
+static void step_begin(const char *name) {
+    printf("%-28s ", name);
+    fflush(stdout);
+    step_start = violations();
+}
+
+static void step_end(void) {
+    wait_blocks(8);
+    const uint64_t n = violations() - step_start;
+    if (n) {
+        printf("%llu violation%s\n", (unsigned long long)n, n == 1 ? "" : "s");
+        failed_steps++;
+    } else {
+        printf("ok\n");
+    }
+}
+
+static void check(ms_error_t err, const char *what) {
+    if (err != MS_SUCCESS) {
+        printf("[%s: %s] ", what, ms_error_string(err));
+    }
+}
+
+/* ============================================================================
+ * Test files
+ * ========================================================================== */
+
+static void put_le(FILE *f, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) fputc((value >> (8 * i)) & 0xFF, f);
+}
+
+static void temp_path(char *out, size_t size, const char *name) {
+    snprintf(out, size, "%s/%s", temp_dir, name);
+}
+
+static void write_wav(const char *name, uint32_t frames, double hz) {
+    char path[256];
+    temp_path(path, sizeof(path), name);
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+
+    fwrite("RIFF", 1, 4, f); put_le(f, 36 + frames * 2, 4);
+    fwrite("WAVEfmt ", 1, 8, f); put_le(f, 16, 4);
+    put_le(f, 1, 2); put_le(f, 1, 2); put_le(f, SAMPLE_RATE, 4);
+    put_le(f, SAMPLE_RATE * 2, 4); put_le(f, 2, 2); put_le(f, 16, 2);
+    fwrite("data", 1, 4, f); put_le(f, frames * 2, 4);
+    for (uint32_t i = 0; i < frames; i++) {
+        put_le(f, (uint16_t)(int16_t)(12000.0 * sin(2.0 * M_PI * hz * i / SAMPLE_RATE)), 2);
+    }
+    fclose(f);
+}
+
+static void write_midi(const char *name) {
+    static const uint8_t track[] = {
+        0x00, 0x90, 60, 100,  0x30, 0x80, 60, 0,
+        0x00, 0x91, 64, 100,  0x30, 0x81, 64, 0,
+        0x00, 0xE0, 0x00, 0x50,
+        0x00, 0xFF, 0x2F, 0x00
+    };
+    char path[256];
+    temp_path(path, sizeof(path), name);
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+
+    fwrite("MThd", 1, 4, f);
+    static const uint8_t header[] = { 0, 0, 0, 6, 0, 0, 0, 1, 0, 96 };
+    fwrite(header, 1, sizeof(header), f);
+    fwrite("MTrk", 1, 4, f);
+    const uint8_t length[] = { 0, 0, 0, sizeof(track) };
+    fwrite(length, 1, 4, f);
+    fwrite(track, 1, sizeof(track), f);
+    fclose(f);
+}
+
+static void write_scala(const char *name) {
+    char path[256];
+    temp_path(path, sizeof(path), name);
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+
+    fputs("! test.scl\nPentatonic\n5\n!\n9/8\n5/4\n3/2\n5/3\n2/1\n", f);
+    fclose(f);
+}
+
+static void remove_temp_files(void) {
+    static const char *names[] = {
+        "a.wav", "b.wav", "c.wav", "long.wav", "song.mid", "pent.scl"
+    };
+    char path[256];
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        temp_path(path, sizeof(path), names[i]);
+        unlink(path);
+    }
+
+    char command[300];
+    snprintf(command, sizeof(command), "rm -rf %s", temp_dir);
+    if (system(command) != 0) {
+        fprintf(stderr, "could not remove %s\n", temp_dir);
+    }
+}
+
+/* ============================================================================
+ * Main
+ * ========================================================================== */
+
+int main(void) {
+    if (!mkdtemp(temp_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    write_wav("a.wav", SAMPLE_RATE / 2, 261.6);
+    write_wav("b.wav", SAMPLE_RATE / 2, 329.6);
+    write_wav("c.wav", SAMPLE_RATE / 2, 392.0);
+    write_wav("long.wav", SAMPLE_RATE * 2, 220.0);
+    write_midi("song.mid");
+    write_scala("pent.scl");
+
+    char path_a[256], path_b[256], path_c[256], path_long[256], path_mid[256], path_scl[256];
+    char path_cache[256];
+    temp_path(path_a, sizeof(path_a), "a.wav");
+    temp_path(path_b, sizeof(path_b), "b.wav");
+    temp_path(path_c, sizeof(path_c), "c.wav");
+    temp_path(path_long, sizeof(path_long), "long.wav");
+    temp_path(path_mid, sizeof(path_mid), "song.mid");
+    temp_path(path_scl, sizeof(path_scl), "pent.scl");
+    temp_path(path_cache, sizeof(path_cache), "cache");
+
+    if (!ms_rt_check_violations) {
+        printf("rt_check shim not loaded: steps run, but nothing is checked\n"
+               "  (LD_PRELOAD=./libms_rtcheck.so %s)\n", "rt_check_driver");
+    }
+    printf("%s\n", ms_version());
+
+    /* Things that must be set before audio starts */
+    ms_audio_config_t config = {
+        .sample_rate = SAMPLE_RATE,
+        .channels = CHANNELS,
+        .max_polyphony = 32,
+        .buffer_size = BLOCK_FRAMES
+    };
+    ms_voice_pool_t *pool;
+    check(ms_sampler_create(&config, &sampler), "create");
+    check(ms_voice_pool_create(64, &pool), "voice pool");
+    check(ms_sampler_set_voice_pool(sampler, pool), "set voice pool");
+    check(ms_sampler_enable_streaming(sampler, NULL), "streaming");
+
+    ms_instrument_t *piano, *pad;
+    check(ms_instrument_create(sampler, "piano", &piano), "instrument");
+    check(ms_instrument_create(sampler, "pad", &pad), "instrument");
+    ms_sample_metadata_t meta = { .root_note = 60, .velocity_low = 0, .velocity_high = 127 };
+    check(ms_instrument_load_sample(piano, path_a, &meta), "load");
+
+    audio_start();
+
+    step_begin("note on/off");
+    uint32_t voice_id = 0;
+    check(ms_note_on(piano, 60, 100, &voice_id), "note on");
+    check(ms_note_on(piano, 67, 80, NULL), "note on");
+    wait_blocks(4);
+    check(ms_pitch_bend(piano, 12000), "bend");
+    check(ms_note_off(piano, 67), "note off");
+    step_end();
+
+    step_begin("voice commands");
+    check(ms_voice_set_pitch(sampler, voice_id, 0.5f), "pitch");
+    check(ms_voice_set_gain(sampler, voice_id, 0.7f), "gain");
+    check(ms_voice_set_pan(sampler, voice_id, -0.3f), "pan");
+    wait_blocks(4);
+    check(ms_voice_release(sampler, voice_id), "release");
+    ms_note_on(piano, 62, 90, &voice_id);
+    wait_blocks(4);
+    check(ms_voice_kill(sampler, voice_id), "kill");
+    step_end();
+
+    step_begin("voice events");
+    ms_voice_event_t events[64];
+    ms_poll_voice_events(sampler, events, 64);
+    step_end();
+
+    step_begin("all notes off");
+    for (uint8_t n = 48; n < 72; n++) ms_note_on(piano, n, 100, NULL);
+    wait_blocks(4);
+    ms_all_notes_off(sampler);
+    step_end();
+
+    step_begin("envelope");
+    ms_envelope_t env = { .attack_time = 0.005f, .decay_time = 0.1f,
+                          .sustain_level = 0.7f, .release_time = 0.05f };
+    check(ms_instrument_set_envelope(piano, &env), "envelope");
+    ms_note_on(piano, 60, 100, NULL);
+    step_end();
+
+    step_begin("voice budget and steals");
+    ms_voice_budget_t budget = { .max_voices = 4, .reserved_voices = 2, .priority = 1 };
+    check(ms_instrument_set_voice_budget(piano, &budget), "budget");
+    for (uint8_t n = 40; n < 52; n++) ms_note_on(piano, n, 100, NULL);
+    wait_blocks(4);
+    ms_all_notes_off(sampler);
+    step_end();
+
+    step_begin("mono/legato");
+    check(ms_instrument_set_voice_mode(piano, MS_VOICE_MODE_LEGATO, 50.0f), "legato");
+    ms_note_on(piano, 60, 100, NULL);
+    wait_blocks(2);
+    ms_note_on(piano, 64, 100, NULL);
+    wait_blocks(2);
+    ms_note_off(piano, 64);
+    ms_note_off(piano, 60);
+    check(ms_instrument_set_voice_mode(piano, MS_VOICE_MODE_MONO, 0.0f), "mono");
+    ms_note_on(piano, 62, 100, NULL);
+    wait_blocks(2);
+    check(ms_instrument_set_voice_mode(piano, MS_VOICE_MODE_POLY, 0.0f), "poly");
+    ms_all_notes_off(sampler);
+    step_end();
+
+    step_begin("tuning");
+    ms_tuning_t tuning;
+    ms_tuning_equal(&tuning, 432.0);
+    check(ms_instrument_set_tuning(piano, &tuning, 0.0), "equal");
+    ms_note_on(piano, 60, 100, NULL);
+    check(ms_tuning_load_scala(&tuning, path_scl, NULL), "scala");
+    check(ms_instrument_set_tuning(piano, &tuning, 10.0), "scala tuning");
+    wait_blocks(2);
+    check(ms_instrument_set_tuning(piano, NULL, 0.0), "reset tuning");
+    ms_all_notes_off(sampler);
+    step_end();
+
+    step_begin("load from memory");
+    static float memory_sample[SAMPLE_RATE / 4];
+    for (size_t i = 0; i < SAMPLE_RATE / 4; i++) {
+        memory_sample[i] = 0.3f * sinf(2.0f * (float)M_PI * 440.0f * i / SAMPLE_RATE);
+    }
+    ms_sample_metadata_t pad_meta = { .root_note = 69, .velocity_low = 0, .velocity_high = 127,
+                                      .loop_enabled = true, .loop_start = 0,
+                                      .loop_end = SAMPLE_RATE / 4 };
+    check(ms_instrument_load_sample_memory(pad, memory_sample, SAMPLE_RATE / 4, 1, &pad_meta),
+          "load memory");
+    ms_note_on(pad, 69, 100, NULL);
+    step_end();
+
+    step_begin("preprocess + parallel load");
+    ms_preprocess_config_t pre = { 0 };
+    pre.remove_dc = true;
+    pre.normalize = true;
+    pre.normalize_db = -1.0f;
+    check(ms_sampler_set_preprocess(sampler, &pre), "preprocess");
+    const char *paths[] = { path_b, path_c };
+    ms_sample_metadata_t metas[2] = {
+        { .root_note = 64, .velocity_low = 0, .velocity_high = 127 },
+        { .root_note = 67, .velocity_low = 0, .velocity_high = 127 }
+    };
+    check(ms_instrument_load_samples(piano, paths, metas, 2), "load samples");
+    ms_note_on(piano, 64, 100, NULL);
+    ms_preprocess_stats_t pre_stats;
+    check(ms_sampler_get_preprocess_stats(sampler, &pre_stats), "preprocess stats");
+    step_end();
+
+    step_begin("sample cache");
+    ms_sample_cache_config_t cache = { .directory = path_cache, .max_bytes = 0 };
+    check(ms_sampler_set_sample_cache(sampler, &cache), "sample cache");
+    check(ms_instrument_load_sample(pad, path_c, &metas[1]), "cached load");
+    check(ms_instrument_load_sample(pad, path_c, &metas[1]), "cached load");
+    ms_note_on(pad, 67, 100, NULL);
+    step_end();
+
+    step_begin("memory budget");
+    ms_memory_budget_t mem = { .max_bytes = 64 * 1024, .head_ms = 50 };
+    check(ms_sampler_set_memory_budget(sampler, &mem), "memory budget");
+    ms_instrument_t *budgeted;
+    check(ms_instrument_create(sampler, "budgeted", &budgeted), "instrument");
+    ms_sample_metadata_t long_meta = { .root_note = 57, .velocity_low = 0, .velocity_high = 127 };
+    check(ms_instrument_load_sample(budgeted, path_long, &long_meta), "budgeted load");
+    wait_blocks(40);
+    ms_note_on(budgeted, 57, 100, NULL);
+    wait_blocks(40);
+    step_end();
+
+    step_begin("streamed zone");
+    ms_instrument_t *streamed;
+    check(ms_instrument_create(sampler, "streamed", &streamed), "instrument");
+    check(ms_instrument_load_sample_streamed(streamed, path_long, &long_meta), "streamed load");
+    ms_note_on(streamed, 57, 100, NULL);
+    wait_blocks(40);
+    step_end();
+
+    step_begin("note cache");
+    check(ms_instrument_build_note_cache(piano, NULL, NULL), "build note cache");
+    ms_note_on(piano, 60, 100, NULL);
+    wait_blocks(4);
+    ms_instrument_clear_note_cache(piano);
+    step_end();
+
+    step_begin("shared pool");
+    int pool_fd = -1;
+    ms_instrument_t *exported[] = { piano };
+    ms_instrument_t *attached;
+    check(ms_shared_pool_create(exported, 1, &pool_fd), "pool create");
+    check(ms_instrument_create(sampler, "attached", &attached), "instrument");
+    check(ms_instrument_attach_shared(attached, pool_fd, 0), "attach");
+    close(pool_fd);
+    ms_note_on(attached, 60, 100, NULL);
+    step_end();
+
+    step_begin("governor");
+    ms_governor_config_t gov = { .high_load = 0.5f, .low_load = 0.3f, .hold_ms = 100.0f,
+                                 .quiet_db = -50.0f, .retire_db = -70.0f,
+                                 .polyphony_cap = 8 };
+    check(ms_sampler_set_governor(sampler, &gov, true), "governor on");
+    for (uint8_t n = 50; n < 70; n++) ms_note_on(piano, n, 100, NULL);
+    wait_blocks(20);
+    check(ms_sampler_set_governor(sampler, NULL, false), "governor off");
+    ms_all_notes_off(sampler);
+    step_end();
+
+    step_begin("statistics");
+    ms_stats_t stats;
+    uint64_t frames;
+    uint32_t xruns;
+    ms_get_stats(sampler, &frames, &xruns);
+    check(ms_sampler_get_stats(sampler, &stats), "stats");
+    step_end();
+
+    step_begin("live statistics segment");
+    char shm_name[64];
+    snprintf(shm_name, sizeof(shm_name), "/ms_rtcheck_%d", (int)getpid());
+    check(ms_sampler_publish_stats(sampler, shm_name), "publish");
+    ms_note_on(piano, 60, 100, NULL);
+    wait_blocks(8);
+    ms_monitor_t *monitor;
+    if (ms_monitor_open(shm_name, &monitor) == MS_SUCCESS) {
+        ms_monitor_snapshot_t snapshot;
+        check(ms_monitor_read(monitor, &snapshot), "monitor read");
+        ms_monitor_close(monitor);
+    }
+    check(ms_sampler_publish_stats(sampler, NULL), "unpublish");
+    step_end();
+
+    step_begin("midi file playback");
+    check(ms_load_midi_file(sampler, piano, path_mid), "midi file");
+    check(ms_start_playback(sampler), "start playback");
+    wait_blocks(20);
+    (void)ms_is_playing(sampler);
+    ms_stop_playback(sampler);
+    step_end();
+
+    step_begin("sequences");
+    ms_sequence_t *sequence;
+    if (ms_sequence_load(sampler, path_mid, &sequence) == MS_SUCCESS) {
+        uint32_t counts[128];
+        check(ms_sequence_set_instrument(sequence, 0, piano), "route");
+        check(ms_sequence_set_instrument(sequence, 1, pad), "route");
+        check(ms_sequence_start(sequence, 0), "sequence start");
+        wait_blocks(20);
+        (void)ms_sequence_is_playing(sequence);
+        (void)ms_sequence_length(sequence);
+        check(ms_sequence_note_counts(sequence, piano, counts), "note counts");
+        ms_sequence_stop(sequence);
+        wait_blocks(4);
+        ms_sequence_destroy(sequence);
+    } else {
+        printf("[sequence load failed] ");
+    }
+    step_end();
+
+    step_begin("live midi input");
+    ms_midi_input_t input;
+    ms_midi_input_init(&input, sampler);
+    check(ms_midi_input_set_instrument(&input, 0, piano), "route");
+    static const uint8_t bytes[] = { 0x90, 60, 100, 64, 90, 0xE0, 0, 0x48, 0xB0, 64, 127,
+                                     0x80, 60, 0, 0x90, 64, 0 };
+    ms_midi_input_feed(&input, bytes, sizeof(bytes), 0);
+    wait_blocks(4);
+    check(ms_midi_input_set_mpe(&input, 15, 48.0f), "mpe");
+    static const uint8_t mpe[] = { 0x91, 60, 100, 0xE1, 0, 0x50, 0xD1, 80, 0x81, 60, 0 };
+    ms_midi_input_feed(&input, mpe, sizeof(mpe), 0);
+    step_end();
+
+    step_begin("instrument teardown");
+    ms_all_notes_off(sampler);
+    wait_blocks(60);   /* Past the release */
+    ms_instrument_destroy(attached);
+    ms_instrument_destroy(streamed);
+    ms_instrument_destroy(budgeted);
+    step_end();
+
+    audio_stop();
+
+    /* The engine's own render thread is an audio thread too */
+    step_begin("render thread");
+    check(ms_sampler_start_render(sampler, NULL), "start render");
+    ms_note_on(piano, 60, 100, NULL);
+    static float out[BLOCK_FRAMES * CHANNELS];
+    for (int i = 0; i < 100; i++) {
+        if (ms_render_available(sampler) >= BLOCK_FRAMES) {
+            ms_render_read(sampler, out, BLOCK_FRAMES);
+        }
+        usleep(2000);
+    }
+    ms_sampler_stop_render(sampler);
+    printf("%s\n", violations() - step_start ? "violations" : "ok");
+    if (violations() - step_start) failed_steps++;
+
+    ms_instrument_destroy(pad);
+    ms_instrument_destroy(piano);
+    ms_sampler_destroy(sampler);
+    ms_voice_pool_destroy(pool);
+    remove_temp_files();
+
+    printf("\n%d step%s with violations\n", failed_steps, failed_steps == 1 ? "" : "s");
+    return failed_steps ? 1 : 0;
+}